@@ -8,6 +8,8 @@
 //    05/27/2013  v1.0  Mark Hastings   Initial working version
 //    05/28/2013  v1.1  Mark Hastings   Added complete state
 //    10/01/2014  v1.3  Mark Hastings   Seperated the two interrupts
+//                                      Added hardware dimming register
+//                                      Added hardware latch gap timer
 //
 // ========================================
 `include "cypress.v"
@@ -37,6 +39,7 @@ module B_WS2811_v1_3 (
 	reg [2:0] bitCount;  // Bit counter
     reg  pwmCntl;        // Enable PWM
     reg  xferCmpt;       // Transfer Complete
+    reg [7:0] latchCount; // Bit periods spent low in STATE_DONE
 	
 	wire shiftOut;       // Data out from data path   
 	wire fifoEmpty;      // FIFO empty signal
@@ -54,6 +57,10 @@ module B_WS2811_v1_3 (
     wire fifo_irq_en;
     wire xfrCmpt_irq_en;
     wire next_row;
+    wire [2:0] dimShift;   // Number of MSBs forced to zero (brightness >> n)
+    wire dimBit;           // Current bit is one of the forced zeros
+    wire [7:0] latchBits;  // Latch gap length in bit periods, 0 = none
+    wire latchDone;        // Latch gap has elapsed
     assign  npwmTC = pwmTC;
     assign  zeroBit = !zeroCmp;  //
     assign  oneBit  = !oneCmp;  //
@@ -77,6 +84,8 @@ module B_WS2811_v1_3 (
     parameter STATE_DONE  = 2'b11;  // FIFO empty
 
 	wire [7:0]  control;             // Control Register 
+	wire [7:0]  dimControl;          // Dim Control Register
+	wire [7:0]  latchControl;        // Latch Gap Control Register
 	wire [7:0]  status;              // Status reg bus
 	
 	/* Instantiate the control register */
@@ -85,6 +94,18 @@ module B_WS2811_v1_3 (
     	/*  output	[07:00]	         */  .control(control)
 	);
 	
+	/* Instantiate the dim control register */
+	cy_psoc3_control #(.cy_force_order(1))
+	dimCtrl(
+    	/*  output	[07:00]	         */  .control(dimControl)
+	);
+	
+	/* Instantiate the latch gap control register */
+	cy_psoc3_control #(.cy_force_order(1))
+	latchCtrl(
+    	/*  output	[07:00]	         */  .control(latchControl)
+	);
+	
 	cy_psoc3_status #(.cy_force_order(`TRUE), .cy_md_select(8'b00000000)) StatusReg (
 	/* input [07:00] */ .status(status), // Status Bits
 	/* input */ .reset(reset),           // Reset from interconnect
@@ -98,6 +119,21 @@ module B_WS2811_v1_3 (
     assign fifo_irq_en    = control[3];   // Enable Fifo interrupt
     assign xfrCmpt_irq_en = control[4];   // Enable xfrcmpt interrupt
     assign next_row       = control[5];   // Next row of LEDs
+    assign dimShift       = dimControl[2:0]; // Hardware dim, right shift 0-7
+
+    // Dimming shifts each byte right as it leaves the FIFO: the first
+    //  dimShift bit times send a zero and leave the shifter alone, then the
+    //  top 8-dimShift bits go out. Bit timing is the same at every level.
+    assign dimBit = (bitCount < dimShift);
+
+    // The line is held low in STATE_DONE for latchBits bit periods, counted
+    //  on the free-running pwm8 terminal count, before the transfer is
+    //  reported complete. That low time is the WS281x reset/latch gap. If
+    //  the FIFO has been refilled by then, the next row starts without
+    //  waiting for next_row. With latchBits 0 the component is as it was
+    //  before the timer: complete at once, and only next_row leaves DONE.
+    assign latchBits = latchControl;
+    assign latchDone = (latchCount >= latchBits);
  
     // Status bit assignment
     assign status[0]   = fifoEmpty;    // Status of fifoEmpty
@@ -119,9 +155,19 @@ module B_WS2811_v1_3 (
             dataOut  <= 1'b0;
             pwmCntl  <= PWM_RESET;
             xferCmpt <= 1'b0;
+            latchCount <= 8'h00;
 		end
 		else
 		begin
+            if(state != STATE_DONE)
+            begin
+                latchCount <= 8'h00;
+            end
+            else if(pwmTC & !latchDone)
+            begin
+                latchCount <= latchCount + 8'h01;
+            end
+
 			case (state)
 				
 			STATE_IDLE:    // Wait for data to be ready
@@ -135,7 +181,7 @@ module B_WS2811_v1_3 (
 				if(enable & !fifoEmpty)
 				begin
 					state   <= STATE_START;
-                    pwmCntl <= PWM_RUN;
+                    pwmCntl <= PWM_RESET;  // START loads the bit period, even straight from DONE
 				end
 				else
 				begin
@@ -157,7 +203,7 @@ module B_WS2811_v1_3 (
 			STATE_DATA:     // Shift out the bits
 			begin
                 xferCmpt <= 1'b0;
-                dataOut  <= shiftOut ? oneBit : zeroBit; 
+                dataOut  <= (shiftOut & !dimBit) ? oneBit : zeroBit; 
                 pwmCntl  <= PWM_RUN;
                 
                 if(pwmTC)  // At TC we have end of bit
@@ -178,7 +224,7 @@ module B_WS2811_v1_3 (
 					else  // Not end of byte, shift another bit
 					begin
 					    state  <= STATE_DATA;	
-                        dpAddr <= DP_SHIFT; 
+                        dpAddr <= dimBit ? DP_IDLE : DP_SHIFT; // Hold during dim zeros
 					end
                 end
                 else  // No terminal count, keep driving 1 or 0
@@ -188,14 +234,19 @@ module B_WS2811_v1_3 (
                 end
 			end	
             
-            STATE_DONE:     // Data complete
+            STATE_DONE:     // Data complete, hold low for the latch gap
 			begin
-                xferCmpt <= 1'b1;
+                xferCmpt <= latchDone;
                 dataOut  <= 1'b0; 
-                if(next_row)
+                pwmCntl  <= PWM_RUN;
+                if(next_row & latchDone)
                 begin
                     state <= STATE_IDLE;
                 end
+                else if((latchBits != 8'h00) & latchDone & enable & !fifoEmpty)  // Refilled, chain the next row
+                begin
+                    state <= STATE_START;
+                end
                 else
                 begin
                     state <= STATE_DONE;
@@ -19,21 +19,34 @@
 #include "cyfitter.h"
 #include "`$INSTANCE_NAME`.h"
 #include "`$INSTANCE_NAME`_fonts.h"
+#include "cyapicallbacks.h"
 
 uint8  `$INSTANCE_NAME`_initvar = 0;
 
-#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
-uint32  `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_ARRAY_ROWS][`$INSTANCE_NAME`_ARRAY_COLS];
+`$INSTANCE_NAME`_PIXEL  `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_ARRAY_ROWS][`$INSTANCE_NAME`_ARRAY_COLS];
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+uint32  `$INSTANCE_NAME`_palette[`$INSTANCE_NAME`_PALETTE_SIZE];  /* RAM copy of CLUT, then user colors */
+#endif
+
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+static uint32  `$INSTANCE_NAME`_rowDrive[`$INSTANCE_NAME`_ARRAY_ROWS];  /* Color byte sum of each row */
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+/* Pixels holding each palette entry, per row, so a palette write knows how */
+/* much drive it moves; and each entry's drive, so a pixel write needn't   */
+/* work it out.                                                            */
+static uint16  `$INSTANCE_NAME`_paletteUse[`$INSTANCE_NAME`_ARRAY_ROWS][`$INSTANCE_NAME`_PALETTE_SIZE];
+static uint16  `$INSTANCE_NAME`_paletteDrive[`$INSTANCE_NAME`_PALETTE_SIZE];
+#define `$INSTANCE_NAME`_PixelDrive(pixel)  `$INSTANCE_NAME`_paletteDrive[(pixel)]
 #else
-uint8   `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_ARRAY_ROWS][`$INSTANCE_NAME`_ARRAY_COLS];
+#define `$INSTANCE_NAME`_PixelDrive(pixel)  `$INSTANCE_NAME`_ColorDrive(pixel)
+#endif
+static void `$INSTANCE_NAME`_RecountDrive(void);
 #endif
 
 uint32  `$INSTANCE_NAME`_ledIndex = 0;  
 uint32  `$INSTANCE_NAME`_row = 0;
 uint32  `$INSTANCE_NAME`_refreshComplete;
-
-uint32  `$INSTANCE_NAME`_DimMask;
-uint32  `$INSTANCE_NAME`_DimShift;
+uint32  `$INSTANCE_NAME`_underrunCount = 0;
 
 
 #if(`$INSTANCE_NAME`_CHIP == `$INSTANCE_NAME`_CHIP_WS2812)
@@ -213,6 +226,17 @@ void `$INSTANCE_NAME`_Start()
     `$INSTANCE_NAME`_Compare0 = `$INSTANCE_NAME`_DATA_ZERO;
     `$INSTANCE_NAME`_Compare1 = `$INSTANCE_NAME`_DATA_ONE;
     
+    /* The B_WS2811 holds the line low for the reset time before it reports */
+    /* a row complete, so firmware never has to delay for the latch.        */
+    `$INSTANCE_NAME`_LATCH_CONTROL = `$INSTANCE_NAME`_LATCH_BITS;
+    
+    #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+        `$INSTANCE_NAME`_ResetPalette();
+    #endif
+    #if(`$INSTANCE_NAME`_TRACK_DRIVE)
+        `$INSTANCE_NAME`_RecountDrive();
+    #endif
+
     `$INSTANCE_NAME`_CONTROL = `$INSTANCE_NAME`_ENABLE;
     `$INSTANCE_NAME`_MemClear(`$INSTANCE_NAME`_OFF);
     `$INSTANCE_NAME`_CONTROL = `$INSTANCE_NAME`_DISABLE;
@@ -241,6 +265,7 @@ void `$INSTANCE_NAME`_Start()
            `$INSTANCE_NAME`_CONTROL = `$INSTANCE_NAME`_ENABLE;    
        }
     }
+    `$INSTANCE_NAME`_underrunCount = 0;
     `$INSTANCE_NAME`_refreshComplete = 1;
 }
 
@@ -271,10 +296,8 @@ void `$INSTANCE_NAME`_Trigger(uint32 rst)
     #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
        color = `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][0];
     #else  /* Else use lookup table */
-       color = `$INSTANCE_NAME`_CLUT[ (`$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][0]) ];
+       color = `$INSTANCE_NAME`_palette[ (`$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][0]) ];
     #endif
-    
-     color = (color >> `$INSTANCE_NAME`_DimShift) & `$INSTANCE_NAME`_DimMask;
      
     `$INSTANCE_NAME`_DATA = (uint8)(color & 0x000000FF);  // Write Red
     color = color >> 8;
@@ -316,6 +339,28 @@ uint32 `$INSTANCE_NAME`_Ready(void)
 }
 
 
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_Underruns
+********************************************************************************
+* Summary:
+*  Number of rows cut short because the FIFO emptied before the row was
+*  finished.  Each one is a gap long enough to latch the string early.
+*  Host/hdl/ws2811_timing_tb.v finds how late the FIFO interrupt can be
+*  answered before this counts: about one byte time, 10 us.
+*
+* Parameters:  
+*  none  
+*
+* Return: 
+*  Underrun count since Start.
+*
+*******************************************************************************/
+uint32 `$INSTANCE_NAME`_Underruns(void)
+{
+    return(`$INSTANCE_NAME`_underrunCount);
+}
+
+
 /*******************************************************************************
 * Function Name: `$INSTANCE_NAME`_Stop
 ********************************************************************************
@@ -367,6 +412,99 @@ uint32 `$INSTANCE_NAME`_ColorInc(uint32 incValue)
 
     return(color);
 }
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_SetPalette
+********************************************************************************
+* Summary:
+*  Change the color of one palette entry.  Every pixel that holds this index
+*  picks up the new color on the next refresh, without touching LED memory.
+*
+* Parameters:  
+*  index:  Palette entry to change, 0 to PALETTE_SIZE-1.
+*  color:  New color for the entry.
+*
+* Return: 
+*  void
+*
+*******************************************************************************/
+void `$INSTANCE_NAME`_SetPalette(uint32 index, uint32 color)
+{
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+    uint32 row;
+    uint32 change;
+#endif
+
+    if(index < `$INSTANCE_NAME`_PALETTE_SIZE)
+    {
+    #if(`$INSTANCE_NAME`_TRACK_DRIVE)
+        change = `$INSTANCE_NAME`_ColorDrive(color) - `$INSTANCE_NAME`_paletteDrive[index];
+        for(row = 0; row < `$INSTANCE_NAME`_ARRAY_ROWS; row++)
+        {
+            `$INSTANCE_NAME`_rowDrive[row] += `$INSTANCE_NAME`_paletteUse[row][index] * change;
+        }
+        `$INSTANCE_NAME`_paletteDrive[index] = (uint16)`$INSTANCE_NAME`_ColorDrive(color);
+    #endif
+        `$INSTANCE_NAME`_palette[index] = color;
+    }
+}
+
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_GetPalette
+********************************************************************************
+* Summary:
+*  Read back the color of one palette entry.
+*
+* Parameters:  
+*  index:  Palette entry to read, 0 to PALETTE_SIZE-1.
+*
+* Return: 
+*  Color of the entry, black if the index is out of range.
+*
+*******************************************************************************/
+uint32 `$INSTANCE_NAME`_GetPalette(uint32 index)
+{
+    uint32 color = 0;
+
+    if(index < `$INSTANCE_NAME`_PALETTE_SIZE)
+    {
+        color = `$INSTANCE_NAME`_palette[index];
+    }
+    return(color);
+}
+
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_ResetPalette
+********************************************************************************
+* Summary:
+*  Reload the RAM palette from the constant color lookup table, and set the
+*  user colors past its end to black.
+*
+* Parameters:  
+*  void
+*
+* Return: 
+*  void
+*
+*******************************************************************************/
+void `$INSTANCE_NAME`_ResetPalette(void)
+{
+    uint32 index;
+
+    for(index = 0; index < `$INSTANCE_NAME`_CLUT_SIZE; index++)
+    {
+        `$INSTANCE_NAME`_palette[index] = `$INSTANCE_NAME`_CLUT[index];
+    }
+    for(; index < `$INSTANCE_NAME`_PALETTE_SIZE; index++)
+    {
+        `$INSTANCE_NAME`_palette[index] = 0;
+    }
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+    `$INSTANCE_NAME`_RecountDrive();
+#endif
+}
+#endif
+
 /*****************************************************************************
 * Function Name: `$INSTANCE_NAME`_FISR
 ******************************************************************************
@@ -386,20 +524,20 @@ uint32 `$INSTANCE_NAME`_ColorInc(uint32 incValue)
 *****************************************************************************/
 CY_ISR( `$INSTANCE_NAME`_FISR)
 {
-    extern uint32  `$INSTANCE_NAME`_DimMask;
-    extern uint32  `$INSTANCE_NAME`_DimShift;
     uint32 static color;
 
+    #ifdef `$INSTANCE_NAME`_FISR_ENTRY_CALLBACK
+        `$INSTANCE_NAME`_FISR_EntryCallback();
+    #endif /* `$INSTANCE_NAME`_FISR_ENTRY_CALLBACK */
+
     if(`$INSTANCE_NAME`_ledIndex < `$INSTANCE_NAME`_ARRAY_COLS)
     {
         #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
             color = `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][`$INSTANCE_NAME`_ledIndex++];
         #else  /* Else use lookup table */
-            color = `$INSTANCE_NAME`_CLUT[ (`$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][`$INSTANCE_NAME`_ledIndex++]) ];
+            color = `$INSTANCE_NAME`_palette[ (`$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][`$INSTANCE_NAME`_ledIndex++]) ];
         #endif
 
-        color = (color >> `$INSTANCE_NAME`_DimShift) & `$INSTANCE_NAME`_DimMask;  
-
         `$INSTANCE_NAME`_DATA = (uint8)(color & 0x000000FF);  // Write Green
         color = color >> 8;
         `$INSTANCE_NAME`_DATA = (uint8)(color & 0x000000FF);  // Write Red
@@ -411,6 +549,9 @@ CY_ISR( `$INSTANCE_NAME`_FISR)
          `$INSTANCE_NAME`_CONTROL = `$INSTANCE_NAME`_ENABLE | `$INSTANCE_NAME`_XFRCMPT_IRQ_EN; 
     }
 
+    #ifdef `$INSTANCE_NAME`_FISR_EXIT_CALLBACK
+        `$INSTANCE_NAME`_FISR_ExitCallback();
+    #endif /* `$INSTANCE_NAME`_FISR_EXIT_CALLBACK */
 }
 
 /*****************************************************************************
@@ -432,11 +573,20 @@ CY_ISR( `$INSTANCE_NAME`_FISR)
 *****************************************************************************/
 CY_ISR( `$INSTANCE_NAME`_CISR)
 {
-    extern uint32  `$INSTANCE_NAME`_DimMask;
-    extern uint32  `$INSTANCE_NAME`_DimShift;
     uint32 static color;
     extern uint32 `$INSTANCE_NAME`_refreshComplete;
 
+    #ifdef `$INSTANCE_NAME`_CISR_ENTRY_CALLBACK
+        `$INSTANCE_NAME`_CISR_EntryCallback();
+    #endif /* `$INSTANCE_NAME`_CISR_ENTRY_CALLBACK */
+
+    /* Transfer complete before the last LED of the row was queued means the */
+    /* FIFO ran dry mid-row and the string latched early.                    */
+    if(`$INSTANCE_NAME`_ledIndex < `$INSTANCE_NAME`_ARRAY_COLS)
+    {
+        `$INSTANCE_NAME`_underrunCount++;
+    }
+
 	`$INSTANCE_NAME`_CONTROL = `$INSTANCE_NAME`_ENABLE |`$INSTANCE_NAME`_NEXT_ROW;
     `$INSTANCE_NAME`_row++;
     if( `$INSTANCE_NAME`_row < `$INSTANCE_NAME`_ARRAY_ROWS)  /* More Rows to do  */
@@ -446,10 +596,8 @@ CY_ISR( `$INSTANCE_NAME`_CISR)
 		#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
              color = `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][0];
         #else  /* Else use lookup table */
-             color = `$INSTANCE_NAME`_CLUT[ (`$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][0]) ];
+             color = `$INSTANCE_NAME`_palette[ (`$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_row][0]) ];
         #endif
-
-        color = (color >> `$INSTANCE_NAME`_DimShift) & `$INSTANCE_NAME`_DimMask;
  
         `$INSTANCE_NAME`_DATA = (uint8)(color & 0x000000FF);  /* Write Red   */
         color = color >> 8;
@@ -465,7 +613,10 @@ CY_ISR( `$INSTANCE_NAME`_CISR)
     {
         `$INSTANCE_NAME`_refreshComplete = 1u;
     }
-  
+
+    #ifdef `$INSTANCE_NAME`_CISR_EXIT_CALLBACK
+        `$INSTANCE_NAME`_CISR_ExitCallback();
+    #endif /* `$INSTANCE_NAME`_CISR_EXIT_CALLBACK */
 }
 
 
@@ -503,19 +654,171 @@ void `$INSTANCE_NAME`_DisplayClear(uint32 color)
 *******************************************************************************/
 void `$INSTANCE_NAME`_MemClear(uint32 color)
 {
-    uint32  row, col;
-    
-    for(row=0; row < `$INSTANCE_NAME`_ARRAY_ROWS; row++)
+    `$INSTANCE_NAME`_FillRect(`$INSTANCE_NAME`_MIN_X, `$INSTANCE_NAME`_MIN_Y, 
+                              `$INSTANCE_NAME`_MAX_X, `$INSTANCE_NAME`_MAX_Y, color);
+}
+
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_FillRow
+********************************************************************************
+* Summary:
+*   Fill a horizontal run of pixels with one color.  The run is clipped to the
+*   display once, then written with straight stores.
+*
+* Parameters:  
+*  x0, x1:  First and last column of the run, in either order.
+*  y:       Row to fill.
+*  color:   Color of the run.
+*
+* Return: 
+*  void
+*
+*******************************************************************************/
+void `$INSTANCE_NAME`_FillRow(int32 x0, int32 x1, int32 y, uint32 color)
+{
+    `$INSTANCE_NAME`_PIXEL * dest;
+    uint32 count;
+    int32 temp;
+
+    if((y < `$INSTANCE_NAME`_MIN_Y) || (y > `$INSTANCE_NAME`_MAX_Y)) return;
+
+    if(x0 > x1)
+    {
+        temp = x0;
+        x0 = x1;
+        x1 = temp;
+    }
+    if(x0 < `$INSTANCE_NAME`_MIN_X) x0 = `$INSTANCE_NAME`_MIN_X;
+    if(x1 > `$INSTANCE_NAME`_MAX_X) x1 = `$INSTANCE_NAME`_MAX_X;
+    if(x0 > x1) return;  /* Wholly off the display */
+
+    count = (uint32)(x1 - x0 + 1);
+    dest  = &`$INSTANCE_NAME`_ledArray[y][x0];
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+    if(count == `$INSTANCE_NAME`_ARRAY_COLS)
     {
-        for(col=0; col < `$INSTANCE_NAME`_ARRAY_COLS; col++)
+        /* The whole row: what it held before no longer counts, so the   */
+        /* bookkeeping is set outright, not taken down a pixel at a time. */
+    #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+        uint32 entry;
+        for(entry = 0; entry < `$INSTANCE_NAME`_PALETTE_SIZE; entry++)
         {
-            `$INSTANCE_NAME`_ledArray[row][col] = color;
-            #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
-                `$INSTANCE_NAME`_ledArray[row][col] = color;
-            #else  /* Else use lookup table */
-                 `$INSTANCE_NAME`_ledArray[row][col] = (uint8)color;
-            #endif
+            `$INSTANCE_NAME`_paletteUse[y][entry] = 0;
         }
+        `$INSTANCE_NAME`_paletteUse[y][(`$INSTANCE_NAME`_PIXEL)color] = count;
+    #endif
+        `$INSTANCE_NAME`_rowDrive[y] = count * `$INSTANCE_NAME`_PixelDrive((`$INSTANCE_NAME`_PIXEL)color);
+        while(count-- > 0)
+        {
+            *dest++ = (`$INSTANCE_NAME`_PIXEL)color;
+        }
+    }
+    else
+    {
+        uint32 removed = 0;
+        uint32 left;
+        for(left = count; left > 0; left--)
+        {
+            removed += `$INSTANCE_NAME`_PixelDrive(*dest);
+        #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+            `$INSTANCE_NAME`_paletteUse[y][*dest]--;
+        #endif
+            *dest++ = (`$INSTANCE_NAME`_PIXEL)color;
+        }
+    #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+        `$INSTANCE_NAME`_paletteUse[y][(`$INSTANCE_NAME`_PIXEL)color] += count;
+    #endif
+        `$INSTANCE_NAME`_rowDrive[y] += (count * `$INSTANCE_NAME`_PixelDrive((`$INSTANCE_NAME`_PIXEL)color)) - removed;
+    }
+#else
+    while(count-- > 0)
+    {
+        *dest++ = (`$INSTANCE_NAME`_PIXEL)color;
+    }
+#endif
+}
+
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_CopySpan
+********************************************************************************
+* Summary:
+*   Copy a run of colors into one row of LED memory.  The run is clipped to
+*   the display once, then written with straight stores.
+*
+* Parameters:  
+*  x, y:    Location of the first pixel of the run.
+*  colors:  Source colors, one per pixel.
+*  length:  Number of pixels in the run.
+*
+* Return: 
+*  void
+*
+*******************************************************************************/
+void `$INSTANCE_NAME`_CopySpan(int32 x, int32 y, const uint32 * colors, int32 length)
+{
+#if(!`$INSTANCE_NAME`_TRACK_DRIVE)
+    `$INSTANCE_NAME`_PIXEL * dest;
+#endif
+
+    if((y < `$INSTANCE_NAME`_MIN_Y) || (y > `$INSTANCE_NAME`_MAX_Y)) return;
+
+    if(x < `$INSTANCE_NAME`_MIN_X)
+    {
+        colors += (`$INSTANCE_NAME`_MIN_X - x);
+        length -= (`$INSTANCE_NAME`_MIN_X - x);
+        x = `$INSTANCE_NAME`_MIN_X;
+    }
+    if((x + length) > `$INSTANCE_NAME`_ARRAY_COLS)
+    {
+        length = `$INSTANCE_NAME`_ARRAY_COLS - x;
+    }
+    if(length <= 0) return;  /* Wholly off the display */
+
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+    while(length-- > 0)
+    {
+        `$INSTANCE_NAME`_PixelTracked(x++, y, *colors++);
+    }
+#else
+    dest = &`$INSTANCE_NAME`_ledArray[y][x];
+    while(length-- > 0)
+    {
+        *dest++ = (`$INSTANCE_NAME`_PIXEL)(*colors++);
+    }
+#endif
+}
+
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_FillRect
+********************************************************************************
+* Summary:
+*   Fill a rectangle with one color, one row span at a time.
+*
+* Parameters:  
+*  x0, y0:  One corner of the rectangle.
+*  x1, y1:  The opposite corner.
+*  color:   Color of the rectangle.
+*
+* Return: 
+*  void
+*
+*******************************************************************************/
+void `$INSTANCE_NAME`_FillRect(int32 x0, int32 y0, int32 x1, int32 y1, uint32 color)
+{
+    int32 temp;
+
+    if(y0 > y1)
+    {
+        temp = y0;
+        y0 = y1;
+        y1 = temp;
+    }
+    if(y0 < `$INSTANCE_NAME`_MIN_Y) y0 = `$INSTANCE_NAME`_MIN_Y;
+    if(y1 > `$INSTANCE_NAME`_MAX_Y) y1 = `$INSTANCE_NAME`_MAX_Y;
+
+    for( ; y0 <= y1; y0++)
+    {
+        `$INSTANCE_NAME`_FillRow(x0, x1, y0, color);
     }
 }
 
@@ -565,15 +868,124 @@ void `$INSTANCE_NAME`_Pixel(int32 x, int32 y, uint32 color)
 
 	if((x >= `$INSTANCE_NAME`_MIN_X) && (y >= `$INSTANCE_NAME`_MIN_Y) && (x <= `$INSTANCE_NAME`_MAX_X) && (y <= `$INSTANCE_NAME`_MAX_Y))
     {
+       `$INSTANCE_NAME`_PixelUnchecked(x, y, color);
+    }
+  
+}
+
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_PixelTracked
+********************************************************************************
+*
+* Summary:
+*  Write one pixel with no bounds check, moving the row's drive by the
+*  difference between the old color and the new.
+*
+* Parameters:  
+*  x,y:    Location of the pixel, already clipped
+*  color:  Color of the pixel
+*
+* Return: 
+*  None 
+*******************************************************************************/
+void `$INSTANCE_NAME`_PixelTracked(int32 x, int32 y, uint32 color)
+{
+    `$INSTANCE_NAME`_PIXEL old = `$INSTANCE_NAME`_ledArray[y][x];
+    `$INSTANCE_NAME`_PIXEL pixel = (`$INSTANCE_NAME`_PIXEL)color;
+
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+    `$INSTANCE_NAME`_paletteUse[y][old]--;
+    `$INSTANCE_NAME`_paletteUse[y][pixel]++;
+#endif
+    `$INSTANCE_NAME`_rowDrive[y] += `$INSTANCE_NAME`_PixelDrive(pixel) - `$INSTANCE_NAME`_PixelDrive(old);
+    `$INSTANCE_NAME`_ledArray[y][x] = pixel;
+}
+
+#endif
+
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_RowDrive
+********************************************************************************
+*
+* Summary:
+*  Sum of the color bytes of every pixel in one row of LED memory, as kept
+*  up to date by the pixel and palette writes.  Each byte is its LED color's
+*  share of full current, in 255ths.  With TRACK_DRIVE off, the row is added
+*  up afresh on every call.
+*
+* Parameters:  
+*  row:  Row of LED memory
+*
+* Return: 
+*  Drive of the row, 0 if the row is out of range
+*******************************************************************************/
+uint32 `$INSTANCE_NAME`_RowDrive(uint32 row)
+{
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+    return((row < `$INSTANCE_NAME`_ARRAY_ROWS) ? `$INSTANCE_NAME`_rowDrive[row] : 0);
+#else
+    uint32 drive = 0;
+    uint32 col;
 
+    if(row >= `$INSTANCE_NAME`_ARRAY_ROWS) return(0);
+    for(col = 0; col < `$INSTANCE_NAME`_ARRAY_COLS; col++)
+    {
     #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
-       `$INSTANCE_NAME`_ledArray[y][x] = color;
-    #else  /* Else use lookup table */
-       `$INSTANCE_NAME`_ledArray[y][x] = (uint8)color;
+        drive += `$INSTANCE_NAME`_ColorDrive(`$INSTANCE_NAME`_ledArray[row][col]);
+    #else
+        drive += `$INSTANCE_NAME`_ColorDrive(`$INSTANCE_NAME`_palette[`$INSTANCE_NAME`_ledArray[row][col]]);
     #endif
     }
-  
+    return(drive);
+#endif
+}
+
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_RecountDrive
+********************************************************************************
+*
+* Summary:
+*  Work the drive of every row out from scratch, for when the palette has
+*  been reloaded wholesale.
+*
+* Parameters:  
+*  None
+*
+* Return: 
+*  None 
+*******************************************************************************/
+static void `$INSTANCE_NAME`_RecountDrive(void)
+{
+    uint32 row;
+    uint32 col;
+
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+    for(col = 0; col < `$INSTANCE_NAME`_PALETTE_SIZE; col++)
+    {
+        `$INSTANCE_NAME`_paletteDrive[col] = (uint16)`$INSTANCE_NAME`_ColorDrive(`$INSTANCE_NAME`_palette[col]);
+    }
+#endif
+    for(row = 0; row < `$INSTANCE_NAME`_ARRAY_ROWS; row++)
+    {
+        `$INSTANCE_NAME`_rowDrive[row] = 0;
+    #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+        for(col = 0; col < `$INSTANCE_NAME`_PALETTE_SIZE; col++)
+        {
+            `$INSTANCE_NAME`_paletteUse[row][col] = 0;
+        }
+    #endif
+        for(col = 0; col < `$INSTANCE_NAME`_ARRAY_COLS; col++)
+        {
+            `$INSTANCE_NAME`_rowDrive[row] += `$INSTANCE_NAME`_PixelDrive(`$INSTANCE_NAME`_ledArray[row][col]);
+        #if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+            `$INSTANCE_NAME`_paletteUse[row][`$INSTANCE_NAME`_ledArray[row][col]]++;
+        #endif
+        }
+    }
 }
+#endif
 
 /*******************************************************************************
 * Function Name: `$INSTANCE_NAME`_GetPixel
@@ -679,6 +1091,13 @@ void `$INSTANCE_NAME`_DrawLine(int32 x0, int32 y0, int32 x1, int32 y1, uint32 co
 	int32 dx = x1 - x0; /* Difference between x0 and x1 */
 	int32 stepx, stepy;
 
+	/* Horizontal and vertical lines are spans, no need to step them */
+	if ((dy == 0) || (dx == 0))
+	{
+		`$INSTANCE_NAME`_FillRect(x0, y0, x1, y1, color);
+		return;
+	}
+
 	if (dy < 0)
 	{
 		dy = -dy;
@@ -754,41 +1173,18 @@ void `$INSTANCE_NAME`_DrawLine(int32 x0, int32 y0, int32 x1, int32 y1, uint32 co
 *******************************************************************************/
 void `$INSTANCE_NAME`_DrawRect(int32 x0, int32 y0, int32 x1, int32 y1, int32 fill, uint32 color)
 {	
-     int xDiff;
 	/* Check if the rectangle is to be filled    */
 	if (fill != 0)
 	{	
-        /* Find the difference between the x vars */
-		if(x0 > x1)
-		{
-			xDiff = x0 - x1; 
-		}
-		else
-		{
-			xDiff = x1 - x0;
-		}
-	
-	    /* Fill it with lines  */
-		while(xDiff >= 0)
-		{
-			`$INSTANCE_NAME`_DrawLine(x0, y0, x0, y1, color);
-		
-			if(x0 > x1)
-				x0--;
-			else
-				x0++;
-		
-			xDiff--;
-		}
-
+		`$INSTANCE_NAME`_FillRect(x0, y0, x1, y1, color);
 	}
 	else 
 	{
 		/* Draw the four sides of the rectangle */
-		`$INSTANCE_NAME`_DrawLine(x0, y0, x1, y0, color);
-		`$INSTANCE_NAME`_DrawLine(x0, y1, x1, y1, color);
-		`$INSTANCE_NAME`_DrawLine(x0, y0, x0, y1, color);
-		`$INSTANCE_NAME`_DrawLine(x1, y0, x1, y1, color);
+		`$INSTANCE_NAME`_FillRow(x0, x1, y0, color);
+		`$INSTANCE_NAME`_FillRow(x0, x1, y1, color);
+		`$INSTANCE_NAME`_FillRect(x0, y0, x0, y1, color);
+		`$INSTANCE_NAME`_FillRect(x1, y0, x1, y1, color);
 	}
 }
 
@@ -797,10 +1193,12 @@ void `$INSTANCE_NAME`_DrawRect(int32 x0, int32 y0, int32 x1, int32 y1, int32 fil
 ********************************************************************************
 *
 * Summary:
-*  Dim all output by a specific level (0,1,2,3,4)  
+*  Dim all output by a specific level (0 to 7).  Each level halves the
+*  brightness.  The shift is done by the B_WS2811 datapath as each byte
+*  leaves the FIFO, so dimming costs no CPU time in the ISRs.
 *
 * Parameters:  
-*  dimLevel:  Dim level 1 to 4, 0 => No dimming.
+*  dimLevel:  Dim level 1 to 7, 0 => No dimming.
 *
 * Return: 
 *  None 
@@ -808,53 +1206,35 @@ void `$INSTANCE_NAME`_DrawRect(int32 x0, int32 y0, int32 x1, int32 y1, int32 fil
 *******************************************************************************/
 void `$INSTANCE_NAME`_Dim(uint32 dimLevel) 
 {
-extern uint32  `$INSTANCE_NAME`_DimMask;
-extern uint32  `$INSTANCE_NAME`_DimShift;
-
-    switch(dimLevel)
+    if(dimLevel > `$INSTANCE_NAME`_DimLevel_7)
     {
-       case 1:  // 1/2 bright
-           `$INSTANCE_NAME`_DimMask = 0x007F7F7F;
-           `$INSTANCE_NAME`_DimShift = 1;
-           break;
-           
-       case 2:
-           `$INSTANCE_NAME`_DimMask = 0x003F3F3F;
-           `$INSTANCE_NAME`_DimShift = 2;
-           break;
-           
-       case 3:
-           `$INSTANCE_NAME`_DimMask = 0x001F1F1F;
-           `$INSTANCE_NAME`_DimShift = 3;
-           break;
-           
-       case 4:
-           `$INSTANCE_NAME`_DimMask = 0x000F0F0F;
-           `$INSTANCE_NAME`_DimShift = 4;
-           break;
-           
-       default:
-           `$INSTANCE_NAME`_DimMask = 0x00FFFFFF;
-           `$INSTANCE_NAME`_DimShift = 0;
-           break;
-        
+        dimLevel = `$INSTANCE_NAME`_DimLevel_7;
     }
+    `$INSTANCE_NAME`_DIM_CONTROL = (uint8)dimLevel;
 }
 
 void `$INSTANCE_NAME`_bplot( int32 x, int32 y, uint8 * bitMap, int32 update)
 {
     int32 dx, dy;
-    int32 aindex = 0;
-    int32 maxX, maxY;
+    int32 width, height;
+    int32 firstX, lastX;
+    uint8 * src;
+
+    width  = (int32)bitMap[0];
+    height = (int32)bitMap[1];
+    src    = &bitMap[2];
 
-    maxX = x + (int32)bitMap[aindex++];
-    maxY = y  + (int32)bitMap[aindex++];
+    /* Clip the columns once, every row of the bitmap shares them */
+    firstX = (x < `$INSTANCE_NAME`_MIN_X) ? (`$INSTANCE_NAME`_MIN_X - x) : 0;
+    lastX  = ((x + width) > `$INSTANCE_NAME`_ARRAY_COLS) ? (`$INSTANCE_NAME`_ARRAY_COLS - x) : width;
 
-	for(dy = y; dy < maxY; dy++)
+	for(dy = 0; dy < height; dy++, src += width)
     {
-		for(dx = x; dx < maxX; dx++)
+        if(((y + dy) < `$INSTANCE_NAME`_MIN_Y) || ((y + dy) > `$INSTANCE_NAME`_MAX_Y)) continue;
+
+		for(dx = firstX; dx < lastX; dx++)
         {
-            `$INSTANCE_NAME`_Pixel(dx, dy, bitMap[aindex++]);
+            `$INSTANCE_NAME`_PixelUnchecked(x + dx, y + dy, src[dx]);
         }
     }
 	if(update) `$INSTANCE_NAME`_Trigger(1);
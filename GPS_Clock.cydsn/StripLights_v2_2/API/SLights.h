@@ -22,11 +22,15 @@ void   `$INSTANCE_NAME`_DisplayClear(uint32 color);
 void   `$INSTANCE_NAME`_MemClear(uint32 color);
 void   `$INSTANCE_NAME`_Trigger(uint32 rst);
 uint32 `$INSTANCE_NAME`_Ready(void);
+uint32 `$INSTANCE_NAME`_Underruns(void);
 
 void   `$INSTANCE_NAME`_DrawRect(int32 x0, int32 y0, int32 x1, int32 y1, int32 fill, uint32 color);
 void   `$INSTANCE_NAME`_DrawLine(int32 x0, int32 y0, int32 x1, int32 y1, uint32 color);
 void   `$INSTANCE_NAME`_DrawCircle (int32 x0, int32 y0, int32 radius, uint32 color);
 void   `$INSTANCE_NAME`_Pixel(int32 x, int32 y, uint32 color);
+void   `$INSTANCE_NAME`_FillRow(int32 x0, int32 x1, int32 y, uint32 color);
+void   `$INSTANCE_NAME`_CopySpan(int32 x, int32 y, const uint32 * colors, int32 length);
+void   `$INSTANCE_NAME`_FillRect(int32 x0, int32 y0, int32 x1, int32 y1, uint32 color);
 uint32 `$INSTANCE_NAME`_GetPixel(int32 x, int32 y);
 uint32 `$INSTANCE_NAME`_ColorInc(uint32 incValue);
 void   `$INSTANCE_NAME`_Dim(uint32 dimLevel); 
@@ -36,6 +40,9 @@ void   `$INSTANCE_NAME`_Dim(uint32 dimLevel);
 #define `$INSTANCE_NAME`_DimLevel_2   2
 #define `$INSTANCE_NAME`_DimLevel_3   3
 #define `$INSTANCE_NAME`_DimLevel_4   4
+#define `$INSTANCE_NAME`_DimLevel_5   5
+#define `$INSTANCE_NAME`_DimLevel_6   6
+#define `$INSTANCE_NAME`_DimLevel_7   7
 
 
 
@@ -54,6 +61,8 @@ CY_ISR_PROTO(`$INSTANCE_NAME`_FISR);
 
 #define `$INSTANCE_NAME`_CONTROL      (*(reg8 *) `$INSTANCE_NAME`_B_WS2811_ctrl__CONTROL_REG)
 #define `$INSTANCE_NAME`_STATUS       (*(reg8 *) `$INSTANCE_NAME`_B_WS2811_StatusReg__STATUS_REG)
+#define `$INSTANCE_NAME`_DIM_CONTROL  (*(reg8 *) `$INSTANCE_NAME`_B_WS2811_dimCtrl__CONTROL_REG)
+#define `$INSTANCE_NAME`_LATCH_CONTROL (*(reg8 *) `$INSTANCE_NAME`_B_WS2811_latchCtrl__CONTROL_REG)
 
 #define `$INSTANCE_NAME`_Period       (*(reg8 *) `$INSTANCE_NAME`_B_WS2811_pwm8_u0__F0_REG)
 #define `$INSTANCE_NAME`_Period_PTR   ((reg8 *)  `$INSTANCE_NAME`_B_WS2811_pwm8_u0__F0_REG)
@@ -116,9 +125,11 @@ CY_ISR_PROTO(`$INSTANCE_NAME`_FISR);
 #if (`$INSTANCE_NAME`_SPEED_800KHZ)
     #define `$INSTANCE_NAME`_BYTE_TIME_US 10u
     #define `$INSTANCE_NAME`_WORD_TIME_US 30u
+    #define `$INSTANCE_NAME`_BIT_TIME_NS  1250u
 #else
     #define `$INSTANCE_NAME`_BYTE_TIME_US 20u
     #define `$INSTANCE_NAME`_WORD_TIME_US 60u
+    #define `$INSTANCE_NAME`_BIT_TIME_NS  2500u
 #endif
 
 #define `$INSTANCE_NAME`_COLUMNS     `$LEDs_per_Strip`
@@ -190,8 +201,58 @@ CY_ISR_PROTO(`$INSTANCE_NAME`_FISR);
 
 #define `$INSTANCE_NAME`_CLUT_SIZE  (96 + `$INSTANCE_NAME`_CWHEEL_SIZE)
 
+/* LUT mode palette: the CLUT, then entries of the application's own past its end */
+#define `$INSTANCE_NAME`_USER_COLORS   16
+#define `$INSTANCE_NAME`_PALETTE_SIZE  (`$INSTANCE_NAME`_CLUT_SIZE + `$INSTANCE_NAME`_USER_COLORS)
+
 #define `$INSTANCE_NAME`_RESET_DELAY_US  55
 
+/* Latch gap timed by the hardware, in bit periods, rounded up */
+#define `$INSTANCE_NAME`_LATCH_BITS  (((`$INSTANCE_NAME`_RESET_DELAY_US * 1000u) + `$INSTANCE_NAME`_BIT_TIME_NS - 1u) / `$INSTANCE_NAME`_BIT_TIME_NS)
+
+/* LED memory, one element per pixel: a color in RGB mode, a CLUT index in LUT mode */
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_RGB)
+    #define `$INSTANCE_NAME`_PIXEL  uint32
+#else
+    #define `$INSTANCE_NAME`_PIXEL  uint8
+#endif
+extern `$INSTANCE_NAME`_PIXEL `$INSTANCE_NAME`_ledArray[`$INSTANCE_NAME`_ARRAY_ROWS][`$INSTANCE_NAME`_ARRAY_COLS];
+
+/* Running drive: the sum of the color bytes of every pixel in a row of LED */
+/* memory (after the palette, in LUT mode, and before any dim shift), kept  */
+/* up to date as pixels and palette entries are written, so the current a   */
+/* row will draw is known without scanning it. Writes straight to ledArray  */
+/* go round it. Set to 0 to leave it out, and RowDrive() then scans the    */
+/* row each time instead.                                                   */
+#ifndef `$INSTANCE_NAME`_TRACK_DRIVE
+    #define `$INSTANCE_NAME`_TRACK_DRIVE  1
+#endif
+#define `$INSTANCE_NAME`_ColorDrive(color) \
+    (((color) & 0xFFu) + (((color) >> 8) & 0xFFu) + (((color) >> 16) & 0xFFu))
+uint32 `$INSTANCE_NAME`_RowDrive(uint32 row);
+
+/* Pixel write with no bounds check, for callers that have already clipped */
+#if(`$INSTANCE_NAME`_TRACK_DRIVE)
+    void   `$INSTANCE_NAME`_PixelTracked(int32 x, int32 y, uint32 color);
+    #define `$INSTANCE_NAME`_PixelUnchecked(x, y, color) \
+        `$INSTANCE_NAME`_PixelTracked((x), (y), (color))
+#else
+    #define `$INSTANCE_NAME`_PixelUnchecked(x, y, color) \
+        (`$INSTANCE_NAME`_ledArray[(y)][(x)] = (`$INSTANCE_NAME`_PIXEL)(color))
+#endif
+
+extern const uint32 `$INSTANCE_NAME`_CLUT[];
+
+/* In LUT mode the ISRs read colors from a RAM copy of the CLUT, so a global */
+/* color change is a palette write instead of a rewrite of LED memory.       */
+#if(`$INSTANCE_NAME`_MEMORY_TYPE == `$INSTANCE_NAME`_MEMORY_LUT)
+extern uint32 `$INSTANCE_NAME`_palette[];
+
+void   `$INSTANCE_NAME`_SetPalette(uint32 index, uint32 color);
+uint32 `$INSTANCE_NAME`_GetPalette(uint32 index);
+void   `$INSTANCE_NAME`_ResetPalette(void);
+#endif
+
 #endif  /* CY_SLIGHTS_`$INSTANCE_NAME`_H */
 
 //[] END OF FILE
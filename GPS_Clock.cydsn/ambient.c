@@ -0,0 +1,117 @@
+#include "ambient.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  Ambient light to display brightness. There's nothing here but arithmetic,
+*   so the same code runs on the host against recorded light levels (see
+*   Host/sim).
+*
+*  Each sample goes into an exponential average, kept in 24.8 fixed point so
+*   the dark end, only a few counts wide, still averages smoothly. The
+*   average maps to a brightness on a log scale: log2 in 4 fractional bits,
+*   which is plenty when the whole range is a few hundred levels. Then:
+*
+*  - Hysteresis: the level being aimed for only moves once the mapped level
+*     is AMBIENT_HYSTERESIS away from it (or has hit either end), so light
+*     wavering about one point doesn't keep nudging the display.
+*  - Slew: the output walks to the aimed-for level AMBIENT_SLEW at a time,
+*     so a light switched on fades the display up over a few seconds rather
+*     than jumping.
+*
+*  ambientSample() says whether the output changed, which is the only time
+*   the display needs sending again.
+******************************************************************************/
+
+static int32_t filtered;  // ADC counts, 24.8
+static bool primed;
+static uint8_t target;
+static uint8_t level;
+
+// log2(x) in 4 fractional bits; 0 for 0.
+static uint16_t log2Q4(uint32_t x)
+{
+  uint8_t msb = 0;
+
+  if (x == 0)
+  {
+    return 0;
+  }
+  while ((msb < 31) && (x >> (msb + 1)))
+  {
+    msb++;
+  }
+  // The four bits after the top one are near enough the fraction.
+  uint32_t fraction = (msb >= 4) ? (x >> (msb - 4)) : (x << (4 - msb));
+  return (uint16_t)((msb << 4) | (fraction & 0x0F));
+}
+
+// The brightness for an averaged light level (counts, 24.8).
+static uint8_t brightnessFor(int32_t light)
+{
+  static const uint16_t span = AMBIENT_MAX_BRIGHTNESS - AMBIENT_MIN_BRIGHTNESS;
+
+  if (light <= ((int32_t)AMBIENT_DARK_COUNTS << 8))
+  {
+    return AMBIENT_MIN_BRIGHTNESS;
+  }
+  if (light >= ((int32_t)AMBIENT_BRIGHT_COUNTS << 8))
+  {
+    return AMBIENT_MAX_BRIGHTNESS;
+  }
+  uint16_t dark = log2Q4((uint32_t)AMBIENT_DARK_COUNTS << 8);
+  uint16_t bright = log2Q4((uint32_t)AMBIENT_BRIGHT_COUNTS << 8);
+  uint16_t here = log2Q4((uint32_t)light);
+  return (uint8_t)(AMBIENT_MIN_BRIGHTNESS +
+    ((uint32_t)span * (here - dark)) / (bright - dark));
+}
+
+// Start out at the given brightness; the first sample then sets the light
+//  level outright, and the brightness goes straight to match it.
+void ambientStart(uint8_t startLevel)
+{
+  level = startLevel;
+  target = startLevel;
+  primed = false;
+}
+
+// Takes one ADC reading. True if the brightness has changed.
+bool ambientSample(uint16_t counts)
+{
+  uint8_t last = level;
+  int32_t sample = (int32_t)counts << 8;
+
+  if (!primed)
+  {
+    filtered = sample;
+    target = brightnessFor(filtered);
+    level = target;
+    primed = true;
+    return level != last;
+  }
+  filtered += (sample - filtered) >> AMBIENT_FILTER_SHIFT;
+
+  uint8_t mapped = brightnessFor(filtered);
+  int16_t moved = (int16_t)mapped - target;
+  if ((moved >= AMBIENT_HYSTERESIS) || (moved <= -AMBIENT_HYSTERESIS) ||
+    ((mapped != target) && ((mapped == AMBIENT_MIN_BRIGHTNESS) ||
+    (mapped == AMBIENT_MAX_BRIGHTNESS))))
+  {
+    target = mapped;
+  }
+
+  if (level < target)
+  {
+    level = (target - level > AMBIENT_SLEW) ? level + AMBIENT_SLEW : target;
+  }
+  else if (level > target)
+  {
+    level = (level - target > AMBIENT_SLEW) ? level - AMBIENT_SLEW : target;
+  }
+  return level != last;
+}
+
+uint8_t ambientLevel(void)
+{
+  return level;
+}
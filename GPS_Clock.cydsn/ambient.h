@@ -0,0 +1,35 @@
+#ifndef __ambient_h__
+#define __ambient_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Set to 1 when the design has the light sensor: a phototransistor into an
+//  ADC_SAR named LightSensor, free running, 12 bits, single ended. At 0 the
+//  brightness stays where it was saved. The host build sets it itself.
+#ifndef AMBIENT_SENSOR
+  #define AMBIENT_SENSOR  0
+#endif
+
+// The ADC counts below which the room is dark, and above which it's as
+//  bright as it needs to be, and the display brightness at each end. In
+//  between the brightness follows the log of the light, which is roughly
+//  how the eye sees it.
+#define AMBIENT_DARK_COUNTS     8
+#define AMBIENT_BRIGHT_COUNTS   2048
+#define AMBIENT_MIN_BRIGHTNESS  60
+#define AMBIENT_MAX_BRIGHTNESS  255
+
+// Samples come one per ClockTick. The filter is an exponential average with
+//  a weight of 1/2^AMBIENT_FILTER_SHIFT on each new sample; the brightness
+//  only sets off after a new level once the light has moved it by at least
+//  AMBIENT_HYSTERESIS, and gets there at no more than AMBIENT_SLEW a frame.
+#define AMBIENT_FILTER_SHIFT    3
+#define AMBIENT_HYSTERESIS      8
+#define AMBIENT_SLEW            4
+
+void ambientStart(uint8_t level);
+bool ambientSample(uint16_t counts);
+uint8_t ambientLevel(void);
+
+#endif
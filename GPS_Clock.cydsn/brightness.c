@@ -0,0 +1,161 @@
+#include "brightness.h"
+#include "project.h"
+#include <stdint.h>
+
+/******************************************************************************
+*  Brightness, gamma and white balance, done in a lookup per color channel.
+*
+*  Color values in the display code (and the CLUT) are perceptual: 128 is
+*   meant to look half as bright as 255. LEDs are linear in their drive, so
+*   each value goes through a gamma curve to find the light it should give,
+*   gets scaled by the brightness (itself on the same curve) and by that
+*   channel's trim, and comes out as the byte the LED is sent. One 256-entry
+*   table per channel holds the whole lot, rebuilt whenever the brightness
+*   or trim changes.
+*
+*  The tables keep 8 bits of fraction below the byte. Down at night levels a
+*   whole byte step is a big jump in light, and brightnessDither() lets the
+*   display code round some LEDs up and some down to land in between.
+*
+*  brightnessApply() is for when a color is chosen: a palette entry being
+*   set, or a pixel being drawn in RGB display memory. The StripLights
+*   interrupts still just copy bytes out, so none of this costs them a
+*   cycle. The old hardware dim shift is left at 0, but for a string the
+*   power budget can't otherwise fit (see power.c). brightnessSet() builds
+*   the tables, so call it once at startup before anything else here.
+******************************************************************************/
+
+// (i / 255) ^ 2.2, scaled to 0-65535.
+static const uint16_t gamma16[256] =
+{
+      0,     0,     2,     4,     7,    11,    17,    24,
+     32,    42,    53,    65,    79,    94,   111,   129,
+    148,   169,   192,   216,   242,   270,   299,   330,
+    362,   396,   432,   469,   508,   549,   591,   635,
+    681,   729,   779,   830,   883,   938,   995,  1053,
+   1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+   1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,
+   2334,  2427,  2521,  2618,  2717,  2817,  2920,  3024,
+   3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,
+   4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,
+   5115,  5257,  5401,  5547,  5695,  5845,  5998,  6152,
+   6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+   7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,
+   9111,  9305,  9501,  9699,  9900, 10102, 10307, 10515,
+  10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254,
+  12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140,
+  14386, 14635, 14885, 15138, 15394, 15652, 15912, 16174,
+  16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+  18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694,
+  20996, 21301, 21609, 21919, 22231, 22546, 22863, 23182,
+  23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826,
+  26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627,
+  28988, 29351, 29717, 30086, 30457, 30830, 31206, 31585,
+  31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+  35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981,
+  38402, 38825, 39252, 39680, 40112, 40546, 40982, 41421,
+  41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025,
+  45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793,
+  49275, 49761, 50249, 50739, 51232, 51728, 52226, 52727,
+  53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+  57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097,
+  61642, 62190, 62741, 63295, 63851, 64410, 64971, 65535
+};
+
+enum { RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL, NUM_CHANNELS };
+
+// Which channel each byte of a StripLights color carries, low byte first.
+#if (StripLights_CHIP == StripLights_CHIP_WS2812)
+static const uint8_t byteChannel[NUM_CHANNELS] =
+  { GREEN_CHANNEL, RED_CHANNEL, BLUE_CHANNEL };
+#else
+static const uint8_t byteChannel[NUM_CHANNELS] =
+  { RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL };
+#endif
+
+// Levels that give the same white as the old StripLights_Dim() shifts.
+static const uint8_t dimEquivalent[8] = { 255, 186, 135, 98, 70, 50, 34, 20 };
+
+// The tables, by byte position in the color, so brightnessApply() needn't
+//  care which chip it's talking to. 8.8 fixed point, rounded down.
+static uint16_t channelLut[NUM_CHANNELS][256];
+
+static uint8_t level = BRIGHTNESS_DEFAULT;
+static uint16_t limit = BRIGHTNESS_UNLIMITED;
+static uint8_t trim[NUM_CHANNELS] =
+  { BRIGHTNESS_TRIM_RED, BRIGHTNESS_TRIM_GREEN, BRIGHTNESS_TRIM_BLUE };
+
+// The light each input value gives is gamma16[value] * scale, where scale
+//  folds in the brightness, the trim and the limit; the product tops out at
+//  65535^2, which maps back to 255.00.
+static void rebuild(void)
+{
+  uint8_t position;
+  uint16_t value;
+
+  for (position = 0; position < NUM_CHANNELS; position++)
+  {
+    uint32_t scale = ((uint32_t)gamma16[level] *
+      trim[byteChannel[position]] + 127) / 255;
+    scale = (scale * limit + 32767) / 65535;
+    for (value = 0; value < 256; value++)
+    {
+      uint64_t light = (uint64_t)gamma16[value] * scale * 255;
+      channelLut[position][value] = (uint16_t)(light >> 24);
+    }
+  }
+}
+
+void brightnessSet(uint8_t newLevel)
+{
+  level = newLevel;
+  rebuild();
+}
+
+void brightnessTrim(uint8_t red, uint8_t green, uint8_t blue)
+{
+  trim[RED_CHANNEL] = red;
+  trim[GREEN_CHANNEL] = green;
+  trim[BLUE_CHANNEL] = blue;
+  rebuild();
+}
+
+void brightnessSetLimit(uint16_t newLimit)
+{
+  limit = newLimit;
+  rebuild();
+}
+
+uint16_t brightnessLimit(void)
+{
+  return limit;
+}
+
+uint8_t brightnessLevel(void)
+{
+  return level;
+}
+
+// For settings saved as a StripLights_Dim() level.
+uint8_t brightnessFromDim(uint8_t dimLevel)
+{
+  return dimEquivalent[(dimLevel > 7) ? 7 : dimLevel];
+}
+
+// A StripLights color, as it should go out to the LEDs. Each channel has
+//  threshold/256 added before the fraction is dropped: 128 rounds to the
+//  nearest byte, and a set of thresholds spread evenly over 0-255 averages
+//  out to the exact value.
+uint32_t brightnessDither(uint32_t color, uint8_t threshold)
+{
+  return (uint32_t)((channelLut[0][color & 0xFF] + threshold) >> 8) |
+    ((uint32_t)((channelLut[1][(color >> 8) & 0xFF] + threshold) >> 8) << 8) |
+    ((uint32_t)((channelLut[2][(color >> 16) & 0xFF] + threshold) >> 8) << 16);
+}
+
+// A StripLights color, as it should go out to the LEDs, each channel
+//  rounded to the nearest byte.
+uint32_t brightnessApply(uint32_t color)
+{
+  return brightnessDither(color, 128);
+}
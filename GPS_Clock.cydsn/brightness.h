@@ -0,0 +1,33 @@
+#ifndef __brightness_h__
+#define __brightness_h__
+
+#include <stdint.h>
+
+// Display brightness, 0-255, on a perceptual scale: each step looks about as
+//  big as the last, from the bottom to the top. The default matches the old
+//  fixed StripLights_Dim(1), which halved every byte.
+#define BRIGHTNESS_MAX      255
+#define BRIGHTNESS_DEFAULT  186
+
+// White balance: each channel's share of full drive, 255 = all of it. LED
+//  batches differ, and a string that reads a little blue at 255/255/255 can
+//  be pulled back here.
+#define BRIGHTNESS_TRIM_RED    255
+#define BRIGHTNESS_TRIM_GREEN  255
+#define BRIGHTNESS_TRIM_BLUE   255
+
+// A ceiling on the light, as a share of whatever the level gives, in
+//  65535ths; the power limiter (power.c) pulls it down when the LEDs would
+//  draw more than the supply has.
+#define BRIGHTNESS_UNLIMITED   65535
+
+void brightnessSet(uint8_t level);
+void brightnessTrim(uint8_t red, uint8_t green, uint8_t blue);
+void brightnessSetLimit(uint16_t limit);
+uint16_t brightnessLimit(void);
+uint8_t brightnessLevel(void);
+uint8_t brightnessFromDim(uint8_t dimLevel);
+uint32_t brightnessApply(uint32_t color);
+uint32_t brightnessDither(uint32_t color, uint8_t threshold);
+
+#endif
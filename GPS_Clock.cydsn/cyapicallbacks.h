@@ -0,0 +1,20 @@
+#ifndef CYAPICALLBACKS_H
+#define CYAPICALLBACKS_H
+
+// Hooks the components call out to, if they're defined here. Only the
+//  profiler uses them for now.
+
+#include "profile.h"
+
+#if PROFILING
+  #define StripLights_FISR_ENTRY_CALLBACK
+  #define StripLights_FISR_EntryCallback()  PROFILE_START(PROF_STRIP_FISR)
+  #define StripLights_FISR_EXIT_CALLBACK
+  #define StripLights_FISR_ExitCallback()   PROFILE_STOP(PROF_STRIP_FISR)
+  #define StripLights_CISR_ENTRY_CALLBACK
+  #define StripLights_CISR_EntryCallback()  PROFILE_START(PROF_STRIP_CISR)
+  #define StripLights_CISR_EXIT_CALLBACK
+  #define StripLights_CISR_ExitCallback()   PROFILE_STOP(PROF_STRIP_CISR)
+#endif
+
+#endif
@@ -209,6 +209,7 @@ void utcOffsetDateTime(date_time* currDateTime)
   // If we just rolled back past midnight, we want to reduce the date by one.
   if (adjusted_date.hrs < 0)
   {
+    adjusted_date.hrs += 24;
     if (--adjusted_date.day == 0)
     {
       if (--adjusted_date.month == 0)
@@ -229,6 +230,7 @@ void utcOffsetDateTime(date_time* currDateTime)
   // If we just rolled ahead past midnight, we want to increase the date by one.
   else if (adjusted_date.hrs > 23)
   {
+    adjusted_date.hrs -= 24;
     if (++adjusted_date.day > daysThisMonth(adjusted_date.month))
     {
       if (++adjusted_date.month == 13)
@@ -275,3 +277,64 @@ int8_t daysThisMonth(int8_t month)
   return 30;
 }
 
+// daysThisMonth() doesn't know the year, so it can't know about Feb 29th.
+static int8_t daysInMonth(int8_t month, int8_t year)
+{
+  if ((month == 2) && isLeapYear(2000 + year))
+  {
+    return 29;
+  }
+  return daysThisMonth(month);
+}
+
+// Seconds since midnight at the start of 1 January 2000, in whatever zone the
+//  date_time is in. The two-digit year runs out in 2100, and so does this.
+uint32_t dateTimeToEpoch(const date_time* currDateTime)
+{
+  uint32_t days = 0;
+  int8_t i;
+
+  for (i = 0; i < currDateTime->year; i++)
+  {
+    days += isLeapYear(2000 + i) ? 366 : 365;
+  }
+  for (i = 1; i < currDateTime->month; i++)
+  {
+    days += daysInMonth(i, currDateTime->year);
+  }
+  days += currDateTime->day - 1;
+
+  return (((days * 24) + currDateTime->hrs) * 3600) +
+    (((currDateTime->tmin * 10) + currDateTime->min) * 60) +
+    (currDateTime->tsecs * 10) + currDateTime->secs;
+}
+
+// The reverse of dateTimeToEpoch().
+void epochToDateTime(uint32_t epoch, date_time* currDateTime)
+{
+  uint32_t days = epoch / 86400;
+  uint32_t secs = epoch % 86400;
+
+  currDateTime->hrs = secs / 3600;
+  secs %= 3600;
+  currDateTime->tmin = (secs / 60) / 10;
+  currDateTime->min = (secs / 60) % 10;
+  secs %= 60;
+  currDateTime->tsecs = secs / 10;
+  currDateTime->secs = secs % 10;
+
+  currDateTime->year = 0;
+  while (days >= (isLeapYear(2000 + currDateTime->year) ? 366u : 365u))
+  {
+    days -= isLeapYear(2000 + currDateTime->year) ? 366 : 365;
+    currDateTime->year++;
+  }
+  currDateTime->month = 1;
+  while (days >= (uint32_t)daysInMonth(currDateTime->month, 
+    currDateTime->year))
+  {
+    days -= daysInMonth(currDateTime->month, currDateTime->year);
+    currDateTime->month++;
+  }
+  currDateTime->day = days + 1;
+}
@@ -31,6 +31,8 @@ void utcOffsetDateTime(date_time* currDateTime);
 bool isLeapYear(int16_t year);
 int8_t calculateDayOfWeek(const date_time* localDateTime);
 int8_t daysThisMonth(int8_t month);
+uint32_t dateTimeToEpoch(const date_time* currDateTime);
+void epochToDateTime(uint32_t epoch, date_time* currDateTime);
 
 #endif
 
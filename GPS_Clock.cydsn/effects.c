@@ -0,0 +1,251 @@
+#include "effects.h"
+#include "brightness.h"
+#include "project.h"
+#include "trig.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  Colors for the lit segments that change from LED to LED and from frame to
+*   frame, all in integer arithmetic. Each LED has a place on the display,
+*   worked out from its segment and how far along it is; an effect turns
+*   that into a position from 0 to 255 along its own axis (across the whole
+*   display, or down a digit) and the position into a color. Anything that
+*   only changes from frame to frame, the time-driven sines and the end
+*   colors, is done once in effectsFrame(), so a LED is a few multiplies
+*   and, for the rainbow, one trip through effectsHsv().
+*
+*  The colors are perceptual, like the CLUT's: the display code puts them
+*   through the brightness tables on the way out, dithered like any other.
+*   In LUT display memory there aren't the palette entries for that; the
+*   effect has EFFECT_COLORS entries, one for each band of its axis, and
+*   a LED's pixel just points at its band. The effect then moves by
+*   rewriting those entries each frame, without touching the LED memory.
+*
+*  The display code only asks about LEDs in lit segments, so an unlit one
+*   costs the effect nothing.
+******************************************************************************/
+
+// Where each segment's first LED sits in its digit, and the step to the next
+//  one, in half LED pitches from the top left corner. Segments go D, C, B,
+//  A, F, G, E along the string (see ws281x_7seg.c); this takes them to run
+//  round the digit that way, with G left to right and E down. A segment
+//  wired the other way round only flips that segment's part of a gradient.
+typedef struct
+{
+  uint8_t x;
+  uint8_t y;
+  int8_t stepX;
+  int8_t stepY;
+} segmentPlace;
+
+static const segmentPlace places[SEGMENTS_PER_DIGIT] =
+{
+  {  2, 52,  2,  0 },   // D, along the bottom
+  { 26, 50,  0, -2 },   // C, up the lower right
+  { 26, 24,  0, -2 },   // B, up the upper right
+  { 24,  0, -2,  0 },   // A, back along the top
+  {  0,  2,  0,  2 },   // F, down the upper left
+  {  2, 26,  2,  0 },   // G, across the middle
+  {  0, 28,  0,  2 },   // E, down the lower left
+};
+
+#define DIGIT_WIDTH    26
+#define DIGIT_HEIGHT   52
+#define DIGIT_PITCH    32   // A digit and the gap to the next
+#define DISPLAY_WIDTH  (((NUM_DIGITS - 1) * DIGIT_PITCH) + DIGIT_WIDTH)
+
+// Half pitches to 0-255 positions, as 8.8 fixed point multipliers.
+#define ACROSS_SCALE  ((255L << 8) / DISPLAY_WIDTH)
+#define DOWN_SCALE    ((255L << 8) / DIGIT_HEIGHT)
+
+#if ((StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) && \
+  (EFFECT_COLORS < 1))
+  #define EFFECTS_FIT  false  // The dither shades have all the user colors
+#else
+  #define EFFECTS_FIT  true
+#endif
+
+static uint8_t effect = EFFECT_SOLID;
+
+// What effectsFrame() worked out for the frame.
+static uint32_t frameMs;
+static uint16_t rainbowHue;
+static int16_t gradientSway;
+static uint32_t gradientTop;
+static uint32_t gradientBottom;
+static uint32_t breathColor;
+
+// a * b / 255, near enough, and exact when either is 0 or 255.
+static uint8_t scale8(uint8_t a, uint8_t b)
+{
+  return (uint8_t)(((uint16_t)a * (b + 1)) >> 8);
+}
+
+static uint32_t makeColor(uint8_t red, uint8_t green, uint8_t blue)
+{
+#if (StripLights_CHIP == StripLights_CHIP_WS2812)
+  return (uint32_t)green | ((uint32_t)red << 8) | ((uint32_t)blue << 16);
+#else
+  return (uint32_t)red | ((uint32_t)green << 8) | ((uint32_t)blue << 16);
+#endif
+}
+
+// A StripLights color from hue (a binary angle, 0 red), saturation and
+//  value. The hue circle is six sectors; in each, one channel sits at the
+//  value, one at the floor the saturation leaves, and the third ramps
+//  between them.
+uint32_t effectsHsv(uint16_t hue, uint8_t saturation, uint8_t value)
+{
+  uint32_t sixths = (uint32_t)hue * 6;
+  uint8_t along = (uint8_t)(sixths >> 8);
+  uint8_t low = value - scale8(value, saturation);
+  uint8_t ramp = scale8(value - low, along);
+
+  switch (sixths >> 16)
+  {
+    case 0:  return makeColor(value, low + ramp, low);
+    case 1:  return makeColor(value - ramp, value, low);
+    case 2:  return makeColor(low, value, low + ramp);
+    case 3:  return makeColor(low, value - ramp, value);
+    case 4:  return makeColor(low + ramp, low, value);
+    default: return makeColor(value, low, value - ramp);
+  }
+}
+
+// Each byte of a color a share of the way to another's, 0-255.
+static uint32_t mix(uint32_t from, uint32_t to, uint8_t amount)
+{
+  uint32_t color = 0;
+  uint8_t shift;
+
+  for (shift = 0; shift < 24; shift += 8)
+  {
+    int16_t start = (from >> shift) & 0xFF;
+    int16_t end = (to >> shift) & 0xFF;
+    color |= (uint32_t)(start + (((end - start) * amount) / 255)) << shift;
+  }
+  return color;
+}
+
+// The color at a position along the effect's axis, this frame.
+static uint32_t colorAt(uint8_t position)
+{
+  int16_t blend;
+
+  switch (effect)
+  {
+    case EFFECT_RAINBOW:
+      return effectsHsv(rainbowHue + (position * (TRIG_TURN / 256)), 255, 255);
+    case EFFECT_GRADIENT:
+      blend = position + gradientSway;
+      blend = (blend < 0) ? 0 : ((blend > 255) ? 255 : blend);
+      return mix(gradientTop, gradientBottom, (uint8_t)blend);
+    default:
+      return breathColor;
+  }
+}
+
+// Where a LED is along the effect's axis: across the whole display, left to
+//  right, for the rainbow, and top to bottom of its digit otherwise. Digit
+//  0 is on the right.
+static uint8_t positionOf(uint8_t digit, uint8_t segment, uint8_t led)
+{
+  const segmentPlace* place = &places[segment];
+
+  if (effect == EFFECT_RAINBOW)
+  {
+    uint16_t x = ((NUM_DIGITS - 1 - digit) * DIGIT_PITCH) + place->x +
+      (place->stepX * led);
+    return (uint8_t)((x * ACROSS_SCALE) >> 8);
+  }
+  return (uint8_t)(((place->y + (place->stepY * led)) * DOWN_SCALE) >> 8);
+}
+
+// Picks the effect. EFFECT_SOLID is always there; the others aren't in LUT
+//  display memory when the dither shades leave no palette entries over.
+bool effectsSelect(uint8_t newEffect)
+{
+  if ((newEffect >= EFFECT_COUNT) ||
+    ((newEffect != EFFECT_SOLID) && !EFFECTS_FIT))
+  {
+    return false;
+  }
+  effect = newEffect;
+  effectsFrame(frameMs);
+  return true;
+}
+
+uint8_t effectsCurrent(void)
+{
+  return effect;
+}
+
+// Moves the effect on to ms since startup; the periods are in effects.h.
+void effectsFrame(uint32_t ms)
+{
+  uint16_t angle;
+
+  frameMs = ms;
+  switch (effect)
+  {
+    case EFFECT_RAINBOW:
+      // Scrolls right to left.
+      rainbowHue = (uint16_t)(((ms % EFFECT_RAINBOW_MS) * TRIG_TURN) /
+        EFFECT_RAINBOW_MS);
+      break;
+    case EFFECT_GRADIENT:
+      // The halfway point rides up and down a quarter of the digit.
+      angle = (uint16_t)(((ms % EFFECT_GRADIENT_MS) * TRIG_TURN) /
+        EFFECT_GRADIENT_MS);
+      gradientSway = trigSin(angle) / 512;
+      gradientTop = effectsHsv(EFFECT_GRADIENT_TOP, 255, 255);
+      gradientBottom = effectsHsv(EFFECT_GRADIENT_BOTTOM, 255, 255);
+      break;
+    case EFFECT_BREATHING:
+      angle = (uint16_t)(((ms % EFFECT_BREATH_MS) * TRIG_TURN) /
+        EFFECT_BREATH_MS);
+      breathColor = effectsHsv(EFFECT_BREATH_HUE, EFFECT_BREATH_SATURATION,
+        (uint8_t)(EFFECT_BREATH_LOW + (((255 - EFFECT_BREATH_LOW) *
+        (trigSin(angle) + TRIG_ONE)) / (2 * TRIG_ONE))));
+      break;
+    default:
+      break;
+  }
+  effectsRefresh();
+}
+
+// In LUT display memory, puts this frame's colors, at the current
+//  brightness, into the effect's palette entries: the color at the middle
+//  of each band. Called from setDigitColor(), so it's redone along with the
+//  digits' whenever the brightness or the power limit moves.
+void effectsRefresh(void)
+{
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  uint8_t band;
+
+  if (effect == EFFECT_SOLID)
+  {
+    return;
+  }
+  for (band = 0; band < EFFECT_COLORS; band++)
+  {
+    StripLights_SetPalette(EFFECT_PALETTE_INDEX + band,
+      brightnessApply(colorAt(((2 * band + 1) * 128) / EFFECT_COLORS)));
+  }
+#endif
+}
+
+// What a lit LED should hold this frame: its color in RGB display memory
+//  (perceptual, for the display code to put through the brightness), or
+//  in LUT display memory the palette entry for its band.
+uint32_t effectsPixel(uint8_t digit, uint8_t segment, uint8_t led)
+{
+  uint8_t position = positionOf(digit, segment, led);
+
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  return EFFECT_PALETTE_INDEX + ((position * EFFECT_COLORS) >> 8);
+#else
+  return colorAt(position);
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef __effects_h__
+#define __effects_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "project.h"
+#include "ws281x_7seg.h"
+
+// What the lit segments are drawn with. EFFECT_SOLID is each digit in its
+//  one color, as ever; the others color every lit LED by where it is on the
+//  display, and move, so the digits go out again as soon as the last frame
+//  is done.
+#define EFFECT_SOLID      0
+#define EFFECT_RAINBOW    1 // The hue wheel across the display, scrolling
+#define EFFECT_GRADIENT   2 // Top to bottom of each digit, swaying
+#define EFFECT_BREATHING  3 // All one color, fading up and down
+#define EFFECT_COUNT      4
+
+#ifndef DISPLAY_EFFECT
+  #define DISPLAY_EFFECT  EFFECT_SOLID
+#endif
+
+// How long each moving effect takes to go round once, in ms.
+#define EFFECT_RAINBOW_MS   10000
+#define EFFECT_GRADIENT_MS  6000
+#define EFFECT_BREATH_MS    4000
+
+// Hues are binary angles, as in trig.h: 0 red, TRIG_TURN / 3 green,
+//  2 * TRIG_TURN / 3 blue.
+#define EFFECT_GRADIENT_TOP     43690   // Blue
+#define EFFECT_GRADIENT_BOTTOM  54613   // Magenta
+#define EFFECT_BREATH_HUE       0
+#define EFFECT_BREATH_SATURATION  0     // White
+#define EFFECT_BREATH_LOW       64      // The bottom of the breath, 0-255
+
+// CPU cycles a frame's six digits may spend on the effect. A string is
+//  drawn while the LEDs wait for it, so each digit gets 1 ms at the 24MHz
+//  bus clock, well under the 2.6 ms its string then takes to send. Past its
+//  share, a digit's remaining lit segments each get one color, worked out
+//  at their middle LED, in a span fill; displayEffectOverruns() counts the
+//  digits that ran over.
+#ifndef EFFECT_BUDGET_CYCLES
+  #define EFFECT_BUDGET_CYCLES  144000
+#endif
+
+// In LUT display memory each LED can only hold a palette index, so the
+//  moving effects get the user colors the dither shades leave free, and
+//  each LED points at the one for its band of the display. Animating them
+//  is then only these palette writes a frame.
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  #define EFFECT_PALETTE_INDEX  (StripLights_CLUT_SIZE + 2 * DITHER_SHADES)
+  #define EFFECT_COLORS         (StripLights_USER_COLORS - 2 * DITHER_SHADES)
+#endif
+
+uint32_t effectsHsv(uint16_t hue, uint8_t saturation, uint8_t value);
+bool effectsSelect(uint8_t effect);
+uint8_t effectsCurrent(void);
+void effectsFrame(uint32_t ms);
+void effectsRefresh(void);
+uint32_t effectsPixel(uint8_t digit, uint8_t segment, uint8_t led);
+
+#endif
@@ -0,0 +1,79 @@
+#include "fmt.h"
+#include <stdint.h>
+
+/******************************************************************************
+*  sprintf() drags in newlib's whole formatted-output engine, and even a "%u"
+*   goes through a format parser and a 64-bit-capable conversion loop on every
+*   call. All the clock ever needs is unsigned decimal and hex, so this is
+*   just that.
+******************************************************************************/
+
+char* fmtDec(char* out, uint32_t value, uint8_t width, char pad)
+{
+  char digits[10];
+  uint8_t count = 0;
+
+  // Build the digits backwards, least significant first.
+  do
+  {
+    digits[count++] = '0' + (value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (width > count)
+  {
+    *out++ = pad;
+    width--;
+  }
+  while (count > 0)
+  {
+    *out++ = digits[--count];
+  }
+  *out = '\0';
+  return out;
+}
+
+char* fmtInt(char* out, int32_t value, uint8_t width, char pad)
+{
+  if (value < 0)
+  {
+    *out++ = '-';
+    if (width > 0)
+    {
+      width--;
+    }
+    // Negate as unsigned so INT32_MIN comes out right.
+    return fmtDec(out, 0u - (uint32_t)value, width, pad);
+  }
+  return fmtDec(out, (uint32_t)value, width, pad);
+}
+
+char* fmtHex(char* out, uint32_t value, uint8_t digits)
+{
+  static const char hexDigits[16] = "0123456789ABCDEF";
+  int8_t shift;
+
+  for (shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+  {
+    *out++ = hexDigits[(value >> shift) & 0x0F];
+  }
+  *out = '\0';
+  return out;
+}
+
+char* fmtChar(char* out, char c)
+{
+  *out++ = c;
+  *out = '\0';
+  return out;
+}
+
+char* fmtStr(char* out, const char* s)
+{
+  while (*s != '\0')
+  {
+    *out++ = *s++;
+  }
+  *out = '\0';
+  return out;
+}
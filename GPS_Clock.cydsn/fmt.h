@@ -0,0 +1,32 @@
+#ifndef __fmt_h__
+#define __fmt_h__
+
+#include <stdint.h>
+
+// Tiny number formatting, in place of sprintf(). Each call writes into the
+//  caller's buffer, NUL-terminates it, and returns a pointer to that NUL, so
+//  calls chain:
+//
+//    char line[16];
+//    char* p = fmtDec(line, hrs, 2, '0');
+//    p = fmtChar(p, ':');
+//    p = fmtDec(p, mins, 2, '0');
+//
+//  Nothing is allocated and there is no state kept between calls, so they are
+//  safe to use from an ISR.
+//  Sizing the buffer is the caller's job; the worst case for each is below.
+
+// Decimal, right-justified in at least width characters, padded on the left
+//  with pad (normally '0' or ' '). At most 10 digits for a uint32_t.
+char* fmtDec(char* out, uint32_t value, uint8_t width, char pad);
+
+// Signed decimal; a '-' comes before any padding. At most 11 characters.
+char* fmtInt(char* out, int32_t value, uint8_t width, char pad);
+
+// Exactly digits hex digits (1-8), upper case, zero-padded.
+char* fmtHex(char* out, uint32_t value, uint8_t digits);
+
+char* fmtChar(char* out, char c);
+char* fmtStr(char* out, const char* s);
+
+#endif
@@ -0,0 +1,236 @@
+#include "framestream.h"
+#include "project.h"
+#include "scheduler.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************
+*  The display as the LEDs have it, streamed to the host. Rather than queue
+*   every change in a ring, which a slow host would overflow at a moving
+*   effect's 60 frames a second, this keeps a copy of what each string last
+*   went out with and one bit per segment that has changed since the host
+*   was sent it. framestreamCapture() updates both as each string goes out,
+*   and framestreamRead() sends the changed segments as they stand when
+*   there's room in a packet. A host that keeps up sees every string that
+*   goes out; one that doesn't sees the latest of each, with the latch count
+*   to say how many went by, and the display never waits on it.
+*
+*  Both ends are in the main loop, from the display and USB tasks, so the
+*   copy and the bits need no locking. The capture is only done while a
+*   host is watching, and from just after a string is triggered, so it runs
+*   while the string is on the wire and costs the display no time.
+******************************************************************************/
+
+#define STRINGS       (COLON_STRING + 1)
+#define ALL_SEGMENTS  ((1 << SEGMENTS_PER_DIGIT) - 1)
+
+static bool streaming;
+
+// What each string last went out with, as StripLights colors, and when.
+static uint32_t shown[STRINGS][LEDS_PER_DIGIT];
+static uint32_t latchedAt[STRINGS];
+static uint16_t latches[STRINGS];
+
+// Segments changed since the host was sent them; strings to send whole.
+static uint8_t dirty[STRINGS];
+static uint8_t fresh;
+
+static uint8_t seq;
+static uint8_t nextString;
+
+// A record made but not yet sent, for want of room in the last packet.
+static uint8_t record[FRAMESTREAM_RECORD_MAX];
+static uint8_t recordLength;
+
+// From the host: sends every string once they've each gone out again, then
+//  changes. The caller queues them all for the display.
+void framestreamStart(void)
+{
+  streaming = true;
+  fresh = (1 << STRINGS) - 1;
+  memset(dirty, 0, sizeof(dirty));
+  recordLength = 0;
+}
+
+// From the host, or when it goes away.
+void framestreamStop(void)
+{
+  streaming = false;
+  memset(dirty, 0, sizeof(dirty));
+  recordLength = 0;
+}
+
+// The color in a StripLights pixel, whichever kind of display memory.
+static uint32_t pixelColor(uint8_t led)
+{
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  return StripLights_palette[StripLights_ledArray[0][led]];
+#else
+  return StripLights_ledArray[0][led];
+#endif
+}
+
+// Call straight after triggering a string: until it's sent, neither the LED
+//  memory nor the palette changes.
+void framestreamCapture(uint8_t stringIndex)
+{
+  uint32_t* copy = shown[stringIndex];
+  uint8_t segment;
+  uint8_t led;
+
+  latches[stringIndex]++;
+  latchedAt[stringIndex] = schedulerUptime();
+  if (!streaming)
+  {
+    return;
+  }
+  if (fresh & (1 << stringIndex))
+  {
+    fresh &= ~(1 << stringIndex);
+    dirty[stringIndex] = ALL_SEGMENTS;
+  }
+  for (segment = 0; segment < SEGMENTS_PER_DIGIT; segment++)
+  {
+    for (led = 0; led < LEDS_PER_SEGMENT; led++)
+    {
+      uint32_t color = pixelColor(segment * LEDS_PER_SEGMENT + led);
+      if (*copy != color)
+      {
+        *copy = color;
+        dirty[stringIndex] |= 1 << segment;
+      }
+      copy++;
+    }
+  }
+}
+
+// A StripLights color as red, green, blue.
+static uint8_t* putColor(uint8_t* out, uint32_t color)
+{
+#if (StripLights_CHIP == StripLights_CHIP_WS2812)
+  out[0] = (uint8_t)(color >> 8);
+  out[1] = (uint8_t)color;
+#else
+  out[0] = (uint8_t)color;
+  out[1] = (uint8_t)(color >> 8);
+#endif
+  out[2] = (uint8_t)(color >> 16);
+  return out + 3;
+}
+
+// Makes a record of the next string round with changes: as many of its
+//  changed segments as fit, fills first, so a string of full segments takes
+//  one record each. False if nothing has changed.
+static bool makeRecord(void)
+{
+  framestreamHeader header;
+  uint8_t* out = &record[FRAMESTREAM_HEADER_SIZE];
+  uint8_t stringIndex = nextString;
+  uint8_t segment;
+  uint8_t step;
+  uint8_t i;
+
+  for (step = 0; step < STRINGS; step++)
+  {
+    stringIndex = (nextString + step) % STRINGS;
+    if (dirty[stringIndex])
+    {
+      break;
+    }
+  }
+  if (step == STRINGS)
+  {
+    return false;
+  }
+  // Round robin, so a busy string can't keep the others waiting.
+  nextString = (stringIndex + 1) % STRINGS;
+
+  for (step = 0; step < 2; step++)
+  {
+    for (segment = 0; segment < SEGMENTS_PER_DIGIT; segment++)
+    {
+      const uint32_t* colors = &shown[stringIndex][segment * LEDS_PER_SEGMENT];
+      bool fill = true;
+      uint8_t size;
+
+      if (!(dirty[stringIndex] & (1 << segment)))
+      {
+        continue;
+      }
+      for (i = 1; (i < LEDS_PER_SEGMENT) && fill; i++)
+      {
+        fill = (colors[i] == colors[0]);
+      }
+      if (fill != (step == 0))
+      {
+        continue;
+      }
+      size = fill ? FRAMESTREAM_FILL_SIZE : FRAMESTREAM_FULL_SIZE;
+      if ((out - record) + size + 1 > FRAMESTREAM_RECORD_MAX)
+      {
+        continue;
+      }
+      *out++ = segment | (fill ? FRAMESTREAM_FILL : 0);
+      for (i = 0; i < (fill ? 1 : LEDS_PER_SEGMENT); i++)
+      {
+        out = putColor(out, colors[i]);
+      }
+      dirty[stringIndex] &= ~(1 << segment);
+    }
+  }
+
+  header.sync = FRAMESTREAM_SYNC;
+  header.seq = seq++;
+  header.string = stringIndex;
+  header.length = (uint8_t)((out - record) - FRAMESTREAM_HEADER_SIZE);
+  header.uptime = latchedAt[stringIndex];
+  header.latches = latches[stringIndex];
+  header.pending = dirty[stringIndex];
+  header.reserved = 0;
+  memcpy(record, &header, FRAMESTREAM_HEADER_SIZE);
+  *out = 0;
+  for (i = 0; i < (out - record); i++)
+  {
+    *out ^= record[i];
+  }
+  recordLength = (uint8_t)((out - record) + 1);
+  return true;
+}
+
+bool framestreamPending(void)
+{
+  uint8_t i;
+
+  if (!streaming)
+  {
+    return false;
+  }
+  if (recordLength > 0)
+  {
+    return true;
+  }
+  for (i = 0; i < STRINGS; i++)
+  {
+    if (dirty[i])
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Copies out as many whole records as fit, for the USB task.
+uint16_t framestreamRead(uint8_t* buffer, uint16_t length)
+{
+  uint16_t copied = 0;
+
+  while (streaming && ((recordLength > 0) || makeRecord()) &&
+    (copied + recordLength <= length))
+  {
+    memcpy(buffer + copied, record, recordLength);
+    copied += recordLength;
+    recordLength = 0;
+  }
+  return copied;
+}
@@ -0,0 +1,53 @@
+#ifndef __framestream_h__
+#define __framestream_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scheduler.h"
+#include "ws281x_7seg.h"
+
+// What the LEDs are showing, for a PC on the USB link to watch or record.
+//  The host sends FRAMESTREAM_START_CMD; from then on, each time a string
+//  goes out, the segments on it that changed go to the host in records
+//  like this: the header, length bytes of segments, and a checksum.
+//  Host/frame_view.c is the other end, and includes this header, so keep
+//  the two in step.
+//
+// Each segment is one byte, its index (0 to SEGMENTS_PER_DIGIT - 1, in
+//  string order, so D first) with FRAMESTREAM_FILL set if its LEDs are all
+//  one color, followed by that color, or by each of its LEDs' colors if
+//  not. Colors are red, green, blue, as the LEDs get them. The colon
+//  string is cut into segments the same way; only its first COLON_LEDS are
+//  ever lit.
+typedef struct
+{
+  uint8_t  sync;          // Always FRAMESTREAM_SYNC
+  uint8_t  seq;           // Counts up per record; a gap means missed changes
+  uint8_t  string;        // 0-5 the digits, seconds first; COLON_STRING
+  uint8_t  length;        // Bytes of segments after this header
+  uint32_t uptime;        // When the string last went out, SCHED_TIMER_HZ
+  uint16_t latches;       // Times it has gone out since reset, low 16 bits
+  uint8_t  pending;       // Changed segments still to come, one bit each
+  uint8_t  reserved;
+} framestreamHeader;
+
+#define FRAMESTREAM_SYNC         0xC3
+#define FRAMESTREAM_HEADER_SIZE  12
+#define FRAMESTREAM_FILL         0x80
+#define FRAMESTREAM_START_CMD    'F'  // Start, or start again from scratch
+#define FRAMESTREAM_STOP_CMD     'f'
+
+// A record always fits a USB packet, so one never has to be split, and
+//  two streams' bytes never interleave in one. That's room for a segment
+//  in full and three fills, or twelve fills.
+#define FRAMESTREAM_RECORD_MAX   64
+#define FRAMESTREAM_FILL_SIZE    4
+#define FRAMESTREAM_FULL_SIZE    (1 + (3 * LEDS_PER_SEGMENT))
+
+void framestreamStart(void);
+void framestreamStop(void);
+void framestreamCapture(uint8_t stringIndex);
+bool framestreamPending(void);
+uint16_t framestreamRead(uint8_t* buffer, uint16_t length);
+
+#endif
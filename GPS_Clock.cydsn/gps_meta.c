@@ -1,20 +1,131 @@
 #include "gps_meta.h"
 #include "project.h"
 #include "date_time.h"
+#include "fmt.h"
+#include "profile.h"
 #include <stdint.h>
+#include <stdbool.h>
 
-void parseNMEAData(char* dataBuffer, date_time* utcDateTime)
+// The RMC fields we use, counting the "$GPRMC" as field 0.
+#define RMC_TIME        1
+#define RMC_STATUS      2
+#define RMC_LATITUDE    3
+#define RMC_NORTH_SOUTH 4
+#define RMC_LONGITUDE   5
+#define RMC_EAST_WEST   6
+#define RMC_DATE        9
+#define RMC_FIELDS      10
+
+// Splits off the next comma-separated field, in place: the comma becomes a
+//  NUL, and *cursor moves on past it. Unlike strtok(), an empty field comes
+//  back as an empty string rather than being skipped, so every field stays
+//  in its place when the GPS leaves some out, as it does without a fix.
+static char* nextField(char** cursor)
+{
+  char* field = *cursor;
+  char* comma = strchr(field, ',');
+
+  if (comma != NULL)
+  {
+    *comma = '\0';
+    *cursor = comma + 1;
+  }
+  else
+  {
+    *cursor = field + strlen(field);
+  }
+  return field;
+}
+
+static bool isDigit(char c)
+{
+  return (c >= '0') && (c <= '9');
+}
+
+// A position field, degrees then minutes ("ddmm.mmmm", with three degree
+//  digits for longitude), and its hemisphere, to millionths of a degree,
+//  south and west negative. False if either is empty or garbled.
+static bool parseCoordinate(const char* field, const char* hemisphere,
+  uint8_t degreeDigits, int32_t* microdegrees)
+{
+  int32_t degrees = 0;
+  int32_t minutes = 0;  // 100000ths of a minute
+  int32_t place = 100000;
+  uint8_t i;
+
+  for (i = 0; i < degreeDigits + 2; i++)
+  {
+    if (!isDigit(field[i]))
+    {
+      return false;
+    }
+  }
+  for (i = 0; i < degreeDigits; i++)
+  {
+    degrees = (degrees * 10) + (*field++ - '0');
+  }
+  minutes = (((field[0] - '0') * 10) + (field[1] - '0')) * place;
+  field += 2;
+  if (*field == '.')
+  {
+    field++;
+    while (isDigit(*field) && (place > 1))
+    {
+      place /= 10;
+      minutes += (*field++ - '0') * place;
+    }
+  }
+  // A millionth of a degree is six 100000ths of a minute.
+  *microdegrees = (degrees * 1000000) + ((minutes + 3) / 6);
+
+  switch (hemisphere[0])
+  {
+    case 'N':
+    case 'E':
+      return true;
+    case 'S':
+    case 'W':
+      *microdegrees = -*microdegrees;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns the RMC status field ('A' for a valid fix, 'V' for none), or 0 if
+//  the sentence wasn't an RMC sentence at all. The position comes back
+//  valid only if the sentence had one.
+char parseNMEAData(char* dataBuffer, date_time* utcDateTime,
+  gpsPosition* position)
 {
   uint8_t i = 0;
+  char status = 0;
   const char RMCKey[7] = "$GPRMC";
-  const char NMEAToken[2] = ",";
+  char* fields[RMC_FIELDS];
+  char* cursor = dataBuffer;
   char* currData;
-  currData =strtok(dataBuffer, NMEAToken);
-  if (strcmp(currData, RMCKey) != 0)
+
+  for (i = 0; i < RMC_FIELDS; i++)
   {
-    return;
+    fields[i] = nextField(&cursor);
   }
-  currData = strtok(NULL, NMEAToken);
+  if (strcmp(fields[0], RMCKey) != 0)
+  {
+    return 0;
+  }
+  status = fields[RMC_STATUS][0];
+  position->valid =
+    parseCoordinate(fields[RMC_LATITUDE], fields[RMC_NORTH_SOUTH], 2,
+      &position->latitude) &&
+    parseCoordinate(fields[RMC_LONGITUDE], fields[RMC_EAST_WEST], 3,
+      &position->longitude);
+
+  // Without a fix the time and date can be empty; there's nothing to read.
+  if ((strlen(fields[RMC_TIME]) < 6) || (strlen(fields[RMC_DATE]) < 6))
+  {
+    return status;
+  }
+  currData = fields[RMC_TIME];
   // currData now contains the UTC time string. hhmmss.xxx if you really want
   // to go out to millisecond precision. You'll see the char - '0' thing here
   // a lot; that's a quick, cheesy way to convert an ASCII digit to its
@@ -25,10 +136,7 @@ void parseNMEAData(char* dataBuffer, date_time* utcDateTime)
   utcDateTime->tsecs = currData[4] - '0';
   utcDateTime->secs = currData[5] - '0';
   
-  for (i = 0; i <8; i++)
-  {
-    currData = strtok(NULL, NMEAToken);
-  }
+  currData = fields[RMC_DATE];
   // Now, currData contains the UTC date string. ddmmyy - guess *somebody*
   // didn't learn from the whole "Y2K" thing. We don't need to do the tens
   // separation here because we don't care about retaining the characters.
@@ -37,7 +145,9 @@ void parseNMEAData(char* dataBuffer, date_time* utcDateTime)
   utcDateTime->month = ((currData[2]-'0') * 10) + (currData[3]-'0'); 
   utcDateTime->year = ((currData[4]-'0') * 10) + (currData[5]-'0'); 
   // Adjust the time for UTC offset.
+  PROFILE_START(PROF_UTC_OFFSET);
   utcOffsetDateTime(utcDateTime);
+  PROFILE_STOP(PROF_UTC_OFFSET);
 
   /* // This section can be used to check the time adjusting code. By placing
      //  it here, and changing the UART pin from P2.2 to P2.0, you can issue
@@ -54,18 +164,23 @@ void parseNMEAData(char* dataBuffer, date_time* utcDateTime)
       displayHours = 0;
     }
   }
-  sprintf(strtemp, "Time: %u:%u%u:%u%u\nDate: %u-%u-%u\n", \
-      displayHours,  \
-      utcDateTime->tmin, \
-      utcDateTime->min, \
-      utcDateTime->tsecs, \
-      utcDateTime->secs, \
-      utcDateTime->day, \
-      utcDateTime->month, \
-      utcDateTime->year );
+  char* p = fmtStr(strtemp, "Time: ");
+  p = fmtDec(p, displayHours, 1, '0');
+  p = fmtChar(p, ':');
+  p = fmtDec(p, (utcDateTime->tmin * 10) + utcDateTime->min, 2, '0');
+  p = fmtChar(p, ':');
+  p = fmtDec(p, (utcDateTime->tsecs * 10) + utcDateTime->secs, 2, '0');
+  p = fmtStr(p, "\nDate: ");
+  p = fmtDec(p, utcDateTime->day, 1, '0');
+  p = fmtChar(p, '-');
+  p = fmtDec(p, utcDateTime->month, 1, '0');
+  p = fmtChar(p, '-');
+  p = fmtDec(p, utcDateTime->year, 1, '0');
+  fmtChar(p, '\n');
   USBUART_PutString(strtemp);
   }
   */
+  return status;
 }
 
 // This stuff is for calculating a checksum if you want to send a configuration
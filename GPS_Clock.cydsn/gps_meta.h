@@ -2,9 +2,25 @@
 #define __gps_meta_h__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "date_time.h"
 
-void parseNMEAData(char* dataBuffer, date_time* utcDateTime);
+// NMEA 0183 caps a sentence at 82 characters, "$" to "\r\n" inclusive. The
+//  receive buffer holds one of those plus the terminating NUL.
+#define NMEA_MAX_SENTENCE 82
+#define NMEA_BUFFER_SIZE  (NMEA_MAX_SENTENCE + 1)
+
+// Where the GPS says it is, in millionths of a degree, north and east
+//  positive. Only valid when the sentence had both fields.
+typedef struct
+{
+  int32_t latitude;
+  int32_t longitude;
+  bool valid;
+} gpsPosition;
+
+char parseNMEAData(char* dataBuffer, date_time* utcDateTime,
+  gpsPosition* position);
   
 // Everything below this point relates to creating a message to send back to
 //  the GPS, to reconfigure it. I'm leaving it in, just in case it proves to
@@ -1,36 +1,109 @@
 #include <project.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <string.h>
+#include "ambient.h"
+#include "brightness.h"
 #include "date_time.h"
+#include "effects.h"
+#include "framestream.h"
 #include "gps_meta.h"
+#include "persist.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "solar.h"
+#include "telemetry.h"
+#include "ticklock.h"
+#include "timebase.h"
+#include "timeserve.h"
+#include "timesync.h"
+#include "usb_cdc.h"
 #include "ws281x_7seg.h"
 
 // Various support functions.
-bool enableUSBCDC();
 CY_ISR_PROTO(ClockTickISR);
 
+// The jobs the main loop hands to the scheduler, and the one that decides
+//  which of them have anything to do.
+static void pollEvents(void);
+static void gpsTask(void);
+static void timeTask(void);
+static void colonTask(void);
+static void displayTask(void);
+static void usbTask(void);
+static void followSchedule(bool dst);
+
 // Current value of each digit/colons.
 volatile bool colon;
-volatile bool colonUpdated;
 
+// 1 shows 0-23 hours; 0 shows 1-12.
 #define TWENTY_FOUR_HOUR_TIME 1
 
-int main()
-{
-  // This array store the colors for each pixel of each digit. For now, they all
-  //  get the same value, but in the future it may be possible to calculate
-  //  values for effects like "wipe" or "rainbow".
-  uint32_t LEDValues[6][84];
+// In RGB display memory each pixel holds its own color. In LUT display memory
+//  each pixel holds a palette index, and the color lives in the palette.
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  #define DIGIT_COLOR     DIGIT_PALETTE_INDEX
+#else
+  #define DIGIT_COLOR     StripLights_WHITE
+#endif
+
+// Everything the main loop works with lives here rather than on main()'s
+//  stack, which is only 2K (see Host/ram_budget.py), and is sized from the
+//  display geometry in ws281x_7seg.h and the NMEA limits in gps_meta.h.
+
+// The color of each digit. Each digit is drawn in one color, so that's all we
+//  need to keep; the moving effects (effects.c) color the lit LEDs
+//  themselves.
+static uint32_t digitColors[NUM_DIGITS];
+
+// Simple: is the segment in the array on or off?
+static bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT];
+
+#if (TIMESYNC_MODE != TIMESYNC_SLAVE)
+// Data received via UART from the GPS.
+static char inboundData[NMEA_BUFFER_SIZE];
+static uint8_t inboundDataIndex = 0;
+#endif
+
+static date_time currDateTime;
 
-  // Simple: is the segment in the array on or off?
-  bool segmentValues[6][7];
+#if (TIMESYNC_MODE != TIMESYNC_SLAVE)
+// Where the clock is, for the sunrise and sunset times; the GPS fills this
+//  in once it has a fix.
+static gpsPosition position = { SOLAR_LATITUDE, SOLAR_LONGITUDE, false };
+#endif
+
+// True once there's a time worth counting on from, either from the GPS or
+//  saved from last time. Until then we leave 88:88:88 up.
+static bool haveTime;
+
+// 0-255, see brightness.h. Saved with the time. With the light sensor fitted
+//  this is only where the display starts; ambient.c takes it from there.
+static uint8_t brightness = BRIGHTNESS_DEFAULT;
 
-  // Data received via UART from the GPS.
-  char inboundData[128];
-  uint8_t inboundDataIndex = 0;
+// The latest figures for telemetry, filled in by whichever task knows them.
+static telemetryRecord sample;
 
-  date_time currDateTime;
+#if PROFILING
+// Next profile table entry to send the host; PROF_COUNT when not sending.
+static uint8_t profileDumpIndex = PROF_COUNT;
+  #define profileDumpPending() (profileDumpIndex < PROF_COUNT)
+#else
+  #define profileDumpPending() false
+#endif
+
+static schedTask tasks[] =
+{
+  { EVENT_UART_RX,      gpsTask,     0 },
+  { EVENT_TIME_CHANGED, timeTask,    0 },
+  { EVENT_TICK,         colonTask,   0 },
+  { EVENT_DISPLAY,      displayTask, 0 },
+  { EVENT_USB,          usbTask,     0 },
+};
+#define NUM_TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+int main()
+{
+  persistRecord saved;
 
   // Starting at 88:88:88 gives a quick visual check on whether the code is
   //  running or not.
@@ -43,44 +116,73 @@ int main()
   currDateTime.tmin = 8;
   currDateTime.hrs = 8;
   
-  char strtemp[64];
+  // First, so the boot timings in the telemetry count from as near to reset
+  //  as we can get.
+  schedulerStart();
+  profileStart();
+
+  // If we've run before, start from the last time we saved rather than from
+  //  88:88:88. There's no RTC running while we're off, so this is only an
+  //  estimate; the colons stay lit (not blinking) until the GPS confirms it.
+  persistStart();
+  if (persistLoad(&saved))
+  {
+    uint32_t epoch = saved.epoch + ((int32_t)(TIMEZONE - saved.zone) * 3600);
+    epochToDateTime(epoch, &currDateTime);
+    timebaseSet(epoch, saved.tickRate);
+    // Records from before brightness.c only have the old dim level.
+    brightness = saved.brightness ? saved.brightness :
+      brightnessFromDim(saved.dim);
+    haveTime = true;
+  }
 
 	// Enable global interrupts, required for StripLights
   CyGlobalIntEnable;
-  bool USBCDCOkay = enableUSBCDC(); // IFF USB is present, we'll echo some data
-                                    //  out to it; otherwise, ignore.
   
-  // Turn on the various peripherals.
+  // Turn on the various peripherals. USB enumerates in the background, IFF
+  //  a host is present; we'll stream telemetry out to it once it's there.
+  usbStart();
   UART_Start();
   StripLights_Start(); 
   ClockTick_Start();
+  ticklockStart();
   ClockTickInt_StartEx(ClockTickISR);
 	
-	// Set dim level 0 = full power, 4 = lowest power
-  StripLights_Dim(1);     
+  // Brightness is done in the colors themselves now (see brightness.c); the
+  //  hardware dim shift stays at the 0 StripLights_Start() leaves it at, but
+  //  for a string the power budget can't otherwise fit.
+  brightnessSet(brightness);
+
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  // The digits share a few palette entries, one per dither shade; recoloring
+  //  the clock later on is just another setDigitColor() call. The colons'
+  //  entries get set each time they're drawn.
+  setDigitColor(StripLights_CLUT[StripLights_WHITE]);
+#endif
+  effectsSelect(DISPLAY_EFFECT);
+
+#if AMBIENT_SENSOR
+  ambientStart(brightness);
+  LightSensor_Start();
+  LightSensor_StartConvert();
+#endif
   
   // Clear the memory in the StripLights object. This is *not* the same as the
   //  memory we declared above!
 	StripLights_MemClear(StripLights_BLACK);
   
-  // Write out the values to the lights. This will blank the display.
-  uint8_t digitIndex;
-  for (digitIndex = 0; digitIndex < 6; digitIndex++)
-  {
-    StripChannelSelect_Write(digitIndex); // Point the mux at the string.
-    StripLights_Trigger(1);               // Push the data to the string.
-    CyDelay(10);                          // Delay a skoosh.
-  }
+  // Every string goes out in the first frame, so none is left showing what
+  //  it powered up with. The display task sends them a string at a time as
+  //  the scheduler runs, the same as any other frame.
+  queueDisplay(DIGIT_STRINGS | COLON_STRINGS);
    
-  // This bit actually DOES initialize the memory we created. That memory will
-  //  be copied over into the memory for the striplight object, and then the
-  //  striplight component will read from that memory while writing to the
-  //  lights. This "double buffer" means we don't have to worry (as much)
-  //  about resource contention on that memory.
-  uint16_t initIndex;
-  for (initIndex = 0; initIndex<504; initIndex++)
+  // Every digit starts out the same color. The display code turns these and
+  //  segmentValues into pixels, a string at a time, in the StripLights
+  //  object's memory.
+  uint8_t digitIndex;
+  for (digitIndex = 0; digitIndex < NUM_DIGITS; digitIndex++)
   {
-    *(LEDValues[0]+initIndex) = StripLights_WHITE;
+    digitColors[digitIndex] = DIGIT_COLOR;
   }
   
   // It's good practice to start with the buffer cleared; we don't *know* what
@@ -88,156 +190,413 @@ int main()
   //  it, so zap it.
   UART_ClearRxBuffer();
 
-  // Loop forever.
+  // Put the 88:88:88 up straight away rather than waiting on the GPS.
+  postEvent(EVENT_TIME_CHANGED);
+
+  // Loop forever. Everything from here on happens in the tasks above, and the
+  //  CPU sleeps whenever none of them has anything to do.
 	for(;;)
 	{
-    // Pulls in the data from the GPS.
-    while (UART_GetRxBufferSize() > 0)
+    runScheduler(tasks, NUM_TASKS, pollEvents);
+	}
+}
+
+// Called by the scheduler, with interrupts off, before it decides whether to
+//  sleep. These are the events whose interrupts belong to components.
+static void pollEvents(void)
+{
+  if (UART_GetRxBufferSize() > 0)
+  {
+    postEvent(EVENT_UART_RX);
+  }
+  if (displayTransferDone())
+  {
+    postEvent(EVENT_DISPLAY);
+  }
+  usbPoll();
+  if ((telemetryPending() || profileDumpPending() || timeservePending() ||
+    framestreamPending()) && usbReady())
+  {
+    postEvent(EVENT_USB);
+  }
+  if (usbDataWaiting())
+  {
+    postEvent(EVENT_USB);
+  }
+}
+
+// A good time has come in, from the GPS or from a master clock. uptime is
+//  when it was true.
+static void timeArrived(const date_time* newDateTime, uint32_t uptime)
+{
+  if (sample.firstTimeMs == 0)
+  {
+    sample.firstTimeMs = schedulerUptime() / (SCHED_TIMER_HZ / 1000);
+  }
+  if (memcmp(newDateTime, &currDateTime, sizeof(date_time)) != 0)
+  {
+    currDateTime = *newDateTime;
+    postEvent(EVENT_TIME_CHANGED);
+  }
+
+  // Keep the local timebase on track, and every so often save where we are
+  //  for next power-up.
+  persistRecord record;
+  record.epoch = dateTimeToEpoch(&currDateTime);
+  record.tickRate = timebaseRate();
+  record.zone = TIMEZONE;
+  record.brightness = brightness;
+  timebaseSyncAt(record.epoch, uptime);
+  persistUpdate(&record);
+  haveTime = true;
+
+#if (TIMESYNC_MODE == TIMESYNC_MASTER)
+  // Pass it straight on to the slaves, as close to the top of the second as
+  //  we can manage.
+  timesyncFrame frame;
+  uint8_t buffer[TIMESYNC_FRAME_SIZE];
+  PROFILE_START(PROF_DST_CHECK);
+  bool dst = dstCheck((const date_time*)&currDateTime);
+  PROFILE_STOP(PROF_DST_CHECK);
+  frame.epoch = record.epoch;
+  // Locked, the ticks know where the top of the second is; until then, all
+  //  there is to go by is when the sentence came in.
+  frame.phaseMs = ticklockLocked() ? ticklockPhaseMs() : timebasePhaseMs();
+  frame.zone = TIMEZONE;
+  frame.flags = TIMESYNC_VALID | (dst ? TIMESYNC_DST : 0);
+  UART_PutArray(buffer, timesyncEncode(&frame, buffer));
+#endif
+}
+
+#if (TIMESYNC_MODE == TIMESYNC_SLAVE)
+// A slave's UART carries time frames from the master, not NMEA.
+static void gpsTask(void)
+{
+  timesyncFrame frame;
+
+  while (UART_GetRxBufferSize() > 0)
+  {
+    if (!timesyncReceive(UART_ReadRxData(), &frame) ||
+      !(frame.flags & TIMESYNC_VALID))
     {
-      inboundData[inboundDataIndex] = UART_ReadRxData();
-      // if we've found the end-of-NMEA-string character, parse the data
-      if (inboundData[inboundDataIndex++] == 0x0A)  // NMEA terminator
-      {
-        inboundDataIndex = 0;
-        parseNMEAData(inboundData, &currDateTime);
-      }
+      continue;
     }
+    // Where the frame's first byte started, for the ticks to lock to.
+    uint32_t stamp = ticklockStamp(UART_GetRxBufferSize() +
+      TIMESYNC_FRAME_SIZE);
+    // The frame went out phaseMs after the master's second started, and
+    //  took TIMESYNC_FRAME_MS to get here.
+    uint32_t uptime = schedulerUptime() -
+      timebaseMsToTicks(frame.phaseMs + TIMESYNC_FRAME_MS);
+    uint32_t epoch = frame.epoch +
+      ((int32_t)(TIMEZONE - frame.zone) * 3600);
+    date_time newDateTime;
+    epochToDateTime(epoch, &newDateTime);
+    sample.fix = 'A';
+    ticklockFrame(epoch, stamp, frame.phaseMs);
+    timeArrived(&newDateTime, uptime);
+  }
+}
+#else
+// Pulls in the data from the GPS. Only a change in the time means any work
+//  for the display.
+static void gpsTask(void)
+{
+  // When the sentence being read in started, for ClockTick to lock to.
+  static uint32_t sentenceStamp;
+
+  uint16_t waiting = UART_GetRxBufferSize();
+  if (waiting > sample.uartHighWater)
+  {
+    sample.uartHighWater = (waiting > 0xFF) ? 0xFF : waiting;
+  }
 
-    // The colonUpdated flag gets cleared in an ISR; if it's clear, we should
-    //  flip the state of the colons so they blink.
-    if (!colonUpdated)
+  while (UART_GetRxBufferSize() > 0)
+  {
+    inboundData[inboundDataIndex] = UART_ReadRxData();
+    if (inboundDataIndex == 0)
     {
-      // Channel 6 is the two colon strings, in parallel. They are each tied
-      //  to a separate pin, however, so the pin drivers don't get overloaded.
-      StripChannelSelect_Write(6);
-      uint8_t i = 0;
-      if (colon) // colon is true when the colon should be ON
+      sentenceStamp = ticklockStamp(UART_GetRxBufferSize());
+    }
+    // A sentence too long to be NMEA is line noise, or we joined partway
+    //  through; throw it away and wait for the next one.
+    if ((inboundData[inboundDataIndex] != 0x0A) &&
+      (inboundDataIndex >= NMEA_BUFFER_SIZE - 2))
+    {
+      inboundDataIndex = 0;
+      continue;
+    }
+    // if we've found the end-of-NMEA-string character, parse the data
+    if (inboundData[inboundDataIndex++] == 0x0A)  // NMEA terminator
+    {
+      date_time newDateTime = currDateTime;
+      gpsPosition newPosition;
+      inboundData[inboundDataIndex] = '\0';
+      if (inboundDataIndex > sample.lineHighWater)
       {
-        for (i = 0; i<8; i++)
-        {
-            StripLights_Pixel(i, 0, StripLights_WHITE);
-        }
+        sample.lineHighWater = inboundDataIndex;
       }
-      else // colon is false when the colon should be OFF
+      inboundDataIndex = 0;
+
+      uint32_t parseStart = cycleCount();
+      PROFILE_START(PROF_NMEA_PARSE);
+      char status = parseNMEAData(inboundData, &newDateTime, &newPosition);
+      PROFILE_STOP(PROF_NMEA_PARSE);
+      sample.parseCycles = cycleCount() - parseStart;
+      if (status != 0)
       {
-        for (i = 0; i<8; i++)
-        {
-            StripLights_Pixel(i, 0, StripLights_BLACK);
-        }
+        sample.fix = status;
       }
-      // Triggering here writes the data out the proper pins.
-      StripLights_Trigger(1); 
-      CyDelay(10); // This delay seems needed...something in the component.
-      colonUpdated = true; // We don't want to do this every loop.
-    }
-      
-    // Write out the current values to the digits.
-    //  Note that we do this every time through the loop; that's easier than
-    //  checking to see if the time changed and I'm lazy. All this first part
-    //  does is set or clear the booleans in the segmentValues array, based
-    //  on the current value for each digit.
-    
-    // Calculate current local display time, including DST.
-    
-    int8_t displayHours = currDateTime.hrs;
-    if (dstCheck((const date_time*)&currDateTime))
-    {
-      if(++displayHours > 23)
+      // Without a fix the time fields are empty, or at best the GPS's own
+      //  guess; our own is as good, so only a valid fix sets the time.
+      if (status == 'A')
       {
-        displayHours = 0;
+        if (newPosition.valid)
+        {
+          position = newPosition;
+        }
+        ticklockReference(dateTimeToEpoch(&newDateTime), sentenceStamp);
+        timeArrived(&newDateTime, schedulerUptime());
       }
     }
+  }
+}
+#endif
 
-#if TWENTY_FOUR_HOUR_TIME    
-    if (displayHours < 10)
-    {
-      writeDigit(segmentValues[5], 0);
-      writeDigit(segmentValues[4], displayHours);
-    }
-    else
-    {
-      writeDigit(segmentValues[5], 1);
-      writeDigit(segmentValues[4], displayHours - 10);
-    }
-#else
-    if (displayHours > 12)
-    {
-      displayHours -= 12;
-    }
-    else if (displayHours == 0)
-    {
-      displayHours = 12;
-    }
-    if (displayHours < 10)
-    {
-      writeDigit(segmentValues[5], 0);
-      writeDigit(segmentValues[4], displayHours);
-    }
-    else
-    {
-      writeDigit(segmentValues[5], 1);
-      writeDigit(segmentValues[4], displayHours - 10);
-    }
+// Works out which segments of each digit should be lit for the current time,
+//  then queues the digits that have changed to go out.
+static void timeTask(void)
+{
+  PROFILE_START(PROF_DST_CHECK);
+  bool dst = dstCheck((const date_time*)&currDateTime);
+  PROFILE_STOP(PROF_DST_CHECK);
+  writeTime(segmentValues, &currDateTime, dst, TWENTY_FOUR_HOUR_TIME);
+  followSchedule(dst);
+
+  queueChangedDigits(segmentValues);
+  postEvent(EVENT_DISPLAY);
+
+  sample.hrs = currDateTime.hrs;
+  sample.min = (currDateTime.tmin * 10) + currDateTime.min;
+  sample.sec = (currDateTime.tsecs * 10) + currDateTime.secs;
+  sample.day = currDateTime.day;
+  sample.month = currDateTime.month;
+  sample.year = currDateTime.year;
+  telemetrySample(&sample);
+}
+
+#if (AMBIENT_SENSOR || SOLAR_SCHEDULE)
+// Puts a new brightness into the colors, and sends the whole display again
+//  so it shows. Only ever called when the level has actually changed.
+static void showBrightness(uint8_t level)
+{
+  brightnessSet(level);
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  setDigitColor(StripLights_CLUT[StripLights_WHITE]);
+#endif
+  queueDisplay(DIGIT_STRINGS | COLON_STRINGS);
+  postEvent(EVENT_DISPLAY);
+}
 #endif
 
+// Once there's a time to go by, blanks the display in the blanking window,
+//  and otherwise sets the brightness by where the sun is, unless the light
+//  sensor is seeing to that. See solar.h.
+static void followSchedule(bool dst)
+{
+  uint8_t minute = (currDateTime.tmin * 10) + currDateTime.min;
 
-    writeDigit(segmentValues[3], currDateTime.tmin);
-    writeDigit(segmentValues[2], currDateTime.min);
-    writeDigit(segmentValues[1], currDateTime.tsecs);
-    writeDigit(segmentValues[0], currDateTime.secs);
-    
-    // Optional debugging statement...
-    if (USBCDCOkay)
-    {
-      if (USBUART_CDCIsReady())
-      {
-      sprintf(strtemp, "Time: %u:%u%u:%u%u\nDate: %u-%u-%u\n", \
-          displayHours,  \
-          currDateTime.tmin, \
-          currDateTime.min, \
-          currDateTime.tsecs, \
-          currDateTime.secs, \
-          currDateTime.day, \
-          currDateTime.month, \
-          currDateTime.year );
-      USBUART_PutString(strtemp);
-      }
-    }
-    updateDisplay((bool**) LEDValues, (uint32_t**) segmentValues);
-	}
+  if (!haveTime)
+  {
+    return;
+  }
+  blankDisplay(solarBlanked((((currDateTime.hrs + (dst ? 1 : 0)) % 24) * 60) +
+    minute));
+
+#if (SOLAR_SCHEDULE && !AMBIENT_SENSOR)
+#if (TIMESYNC_MODE == TIMESYNC_SLAVE)
+  // A slave has no GPS to say where it is, so it keeps to the configured spot.
+  const solarTimes* today = solarToday(&currDateTime, SOLAR_LATITUDE,
+    SOLAR_LONGITUDE);
+#else
+  const solarTimes* today = solarToday(&currDateTime, position.latitude,
+    position.longitude);
+#endif
+  uint8_t level = solarBrightness(today, (currDateTime.hrs * 3600L) +
+    (minute * 60) + (currDateTime.tsecs * 10) + currDateTime.secs);
+  if (level != brightness)
+  {
+    brightness = level;
+    showBrightness(level);
+  }
+#endif
 }
 
-CY_ISR(ClockTickISR)
+// The ISR has already flipped the colon state; just get it out to the LEDs.
+//  Once the ticks are locked to the GPS, the tick that starts each second is
+//  also when its digits change (see ticklock.c); if the GPS has gone quiet,
+//  this is where we count the seconds ourselves.
+static void colonTask(void)
 {
-  if (colon)
+  uint32_t epoch = dateTimeToEpoch(&currDateTime);
+
+  if (ticklockLocked())
+  {
+    ticklockSecond(&epoch);
+  }
+  else if (haveTime && !timebaseSynced())
+  {
+    epoch = timebaseNow();
+  }
+  queueDisplay(COLON_STRINGS);
+  if (epoch != dateTimeToEpoch(&currDateTime))
   {
-    colon = false;
+    // The digits go out ahead of the colons, once timeTask has queued them.
+    epochToDateTime(epoch, &currDateTime);
+    postEvent(EVENT_TIME_CHANGED);
   }
   else
   {
-    colon = true;
+    postEvent(EVENT_DISPLAY);
   }
-  colonUpdated = false;
+
+#if AMBIENT_SENSOR
+  // The ADC runs free, so there's always a fresh reading to take.
+  int16_t counts = LightSensor_GetResult16();
+  if (ambientSample((counts > 0) ? (uint16_t)counts : 0))
+  {
+    showBrightness(ambientLevel());
+  }
+#endif
+
+  usbTick();
+  if (usbGetState() != USB_CONFIGURED)
+  {
+    framestreamStop();
+  }
+  sample.busy = cpuBusyPercent();
+  telemetryTick(&sample);
 }
 
-bool enableUSBCDC()
+static void displayTask(void)
 {
-  USBUART_Start(0, USBUART_3V_OPERATION);
-  uint8_t delayCounter = 0;
-  /* It's important that we not loop forever here, or we'll never leave in
-   * cases where the device isn't plugged into a PC. We do, however, want to
-   * provide enough time for the PC to do its thing. */  
-  while(USBUART_GetConfiguration() == 0)
-  {  
-    CyDelay(100);
-    delayCounter++;
-    if (delayCounter > 20)
+  uint32_t renderStart = cycleCount();
+  // Solid colons mean the time on show is our own estimate, not the GPS's.
+  if (serviceDisplay(digitColors, segmentValues, colon || !timebaseSynced()))
+  {
+    sample.renderCycles = cycleCount() - renderStart;
+    return;
+  }
+  // Nothing left queued or in flight: the boot frame, or the last frame of
+  //  a moving effect, is all out.
+  if (sample.firstFrameMs == 0)
+  {
+    sample.firstFrameMs = schedulerUptime() / (SCHED_TIMER_HZ / 1000);
+  }
+  // A moving effect's next frame goes straight out after it, so it runs as
+  //  fast as the strings can be sent: six digits, some 60 frames a second.
+  if (effectsCurrent() != EFFECT_SOLID)
+  {
+    effectsFrame(schedulerUptime() / (SCHED_TIMER_HZ / 1000));
+    if (queueDisplay(DIGIT_STRINGS))
+    {
+      postEvent(EVENT_DISPLAY);
+    }
+  }
+}
+
+// Acts on any bytes the host has sent us: a time query, the display stream
+//  on or off, or the profiler's. Anything else is ignored.
+static void usbCommands(void)
+{
+  uint8_t packet[USB_PACKET_SIZE];
+  uint16_t length = usbRead(packet);
+  uint32_t rxUptime = schedulerUptime();
+  uint16_t i;
+
+  for (i = 0; i < length; i++)
+  {
+    switch (packet[i])
     {
-      return false;
+      // The query's own bytes follow the command, and must all be in this
+      //  packet; they're skipped either way, so none get taken for commands.
+      case TIMESERVE_QUERY_CMD:
+        if (length - i > TIMESERVE_ORIGIN_SIZE)
+        {
+          timeserveQuery(&packet[i + 1], rxUptime, haveTime);
+        }
+        i += TIMESERVE_ORIGIN_SIZE;
+        break;
+      // Every string goes out again, so the host gets the whole display.
+      case FRAMESTREAM_START_CMD:
+        framestreamStart();
+        if (queueDisplay(DIGIT_STRINGS | COLON_STRINGS))
+        {
+          postEvent(EVENT_DISPLAY);
+        }
+        break;
+      case FRAMESTREAM_STOP_CMD:
+        framestreamStop();
+        break;
+#if PROFILING
+      case PROFILE_DUMP_CMD:
+        profileDumpIndex = 0;
+        break;
+      case PROFILE_RESET_CMD:
+        profileReset();
+        break;
+#endif
+      default:
+        break;
     }
   }
-  USBUART_CDC_Init();
-  return true;
+}
+
+// Hands the host one packet's worth of whatever's queued: the answer to a
+//  time query, which goes first so nothing holds it up, then a profile dump,
+//  if one was asked for, or else telemetry, and the display stream in
+//  whatever room is left. Only ever sends once the CDC endpoint is free, so
+//  it never waits.
+static void usbTask(void)
+{
+  uint8_t packet[USB_PACKET_SIZE];
+  uint16_t length = 0;
+
+  PROFILE_START(PROF_USB);
+  usbCommands();
+  if (!usbReady())
+  {
+    PROFILE_STOP(PROF_USB);
+    return;
+  }
+  length = timeserveRead(packet);
+#if PROFILING
+  while ((profileDumpIndex < PROF_COUNT) && 
+    (length + PROFILE_RECORD_SIZE <= USB_PACKET_SIZE))
+  {
+    profileRecord record;
+    profileRead(profileDumpIndex++, &record);
+    memcpy(&packet[length], &record, PROFILE_RECORD_SIZE);
+    length += PROFILE_RECORD_SIZE;
+  }
+#endif
+  if (length == 0)
+  {
+    length = telemetryRead(packet, sizeof(packet));
+  }
+  length += framestreamRead(&packet[length], sizeof(packet) - length);
+  if (length > 0)
+  {
+    USBUART_PutData(packet, length);
+  }
+  PROFILE_STOP(PROF_USB);
+}
+
+// Lit for the first half of each second, once the ticks are locked.
+CY_ISR(ClockTickISR)
+{
+  colon = ticklockTick();
+  postEvent(EVENT_TICK);
 }
 
 
@@ -0,0 +1,115 @@
+#include "persist.h"
+#include "project.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************
+*  The last good time and a few settings live in the PSoC's EEPROM, one
+*   record per 16-byte row. Rather than rewrite the same row every time, saves
+*   walk round PERSIST_SLOTS rows in turn, each stamped with a sequence
+*   number; at boot the newest row with a good CRC is the one we use. A save
+*   that's cut short by a power loss just leaves a bad CRC, and the row before
+*   it still stands.
+*
+*  EEPROM reads are just memory reads. A row write stalls for a few ms while
+*   the SPC does its thing, which is one more reason to do it rarely.
+******************************************************************************/
+
+// The slot the last save went to, and what it held.
+static uint8_t lastSlot;
+static persistRecord lastSaved;
+static bool haveSaved;
+
+static const persistRecord* slotRecord(uint8_t slot)
+{
+  return (const persistRecord*)(CY_EEPROM_BASE + 
+    ((PERSIST_ROW + slot) * CY_EEPROM_SIZEOF_ROW));
+}
+
+// CRC-16/CCITT, bit at a time; there are only 14 bytes to do.
+uint16_t persistCRC(const uint8_t* data, uint8_t length)
+{
+  uint16_t crc = 0xFFFF;
+  uint8_t bit;
+
+  while (length--)
+  {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+static bool recordGood(const persistRecord* record)
+{
+  return record->crc == persistCRC((const uint8_t*)record,
+    PERSIST_RECORD_SIZE - sizeof(record->crc));
+}
+
+void persistStart(void)
+{
+  CyEEPROM_Start();
+}
+
+// Finds the newest good record. False if there isn't one (first power-up, or
+//  every row is bad).
+bool persistLoad(persistRecord* record)
+{
+  uint8_t slot;
+
+  haveSaved = false;
+  for (slot = 0; slot < PERSIST_SLOTS; slot++)
+  {
+    const persistRecord* candidate = slotRecord(slot);
+    if (!recordGood(candidate))
+    {
+      continue;
+    }
+    // Sequence numbers wrap, so compare by difference.
+    if (!haveSaved || ((int16_t)(candidate->seq - lastSaved.seq) > 0))
+    {
+      memcpy(&lastSaved, candidate, sizeof(persistRecord));
+      lastSlot = slot;
+      haveSaved = true;
+    }
+  }
+  if (haveSaved)
+  {
+    memcpy(record, &lastSaved, sizeof(persistRecord));
+  }
+  return haveSaved;
+}
+
+// Offer the current state; it gets written only if enough time has gone by
+//  or something that matters has changed.
+void persistUpdate(persistRecord* record)
+{
+  if (haveSaved &&
+    (record->epoch - lastSaved.epoch < PERSIST_INTERVAL) &&
+    (record->zone == lastSaved.zone) &&
+    (record->brightness == lastSaved.brightness))
+  {
+    return;
+  }
+
+  lastSlot = haveSaved ? ((lastSlot + 1) % PERSIST_SLOTS) : 0;
+  record->seq = haveSaved ? (lastSaved.seq + 1) : 0;
+  record->spare = 0;
+  record->dim = 0;
+  record->crc = persistCRC((const uint8_t*)record,
+    PERSIST_RECORD_SIZE - sizeof(record->crc));
+
+  // The SPC wants the die temperature before any write.
+  if (CySetTemp() == CYRET_SUCCESS)
+  {
+    CyWriteRowData((uint8)CY_EEPROM_BASE_ARRAY, PERSIST_ROW + lastSlot, 
+      (const uint8*)record);
+  }
+  // Even if the write failed, don't retry until the interval's up again.
+  memcpy(&lastSaved, record, sizeof(persistRecord));
+  haveSaved = true;
+}
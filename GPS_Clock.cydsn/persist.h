@@ -0,0 +1,38 @@
+#ifndef __persist_h__
+#define __persist_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// What survives a power cycle: enough to put a sensible time up at boot,
+//  long before the GPS has a fix. Exactly one 16-byte EEPROM row.
+typedef struct
+{
+  uint32_t epoch;     // Last good GPS time, local standard, see date_time.c
+  uint32_t tickRate;  // SysTick counts per 256 s, see timebase.c
+  uint16_t seq;       // Bumped per save; the newest good row wins
+  int8_t   zone;      // TIMEZONE when saved
+  uint8_t  spare;     // Was dstCheck(); DST comes from the date. 0 now
+  uint8_t  dim;       // Old StripLights dim level; 0 from now on
+  uint8_t  brightness; // 1-255, see brightness.h; 0 in older records
+  uint16_t crc;       // CRC-16/CCITT of everything before it
+} persistRecord;
+
+#define PERSIST_RECORD_SIZE 16
+
+// Saves rotate around this many EEPROM rows, starting at row PERSIST_ROW, so
+//  each row sees only a share of the writes.
+#define PERSIST_ROW         0
+#define PERSIST_SLOTS       8
+
+// Minimum seconds of GPS time between saves, unless the zone or brightness
+//  changes. At one save per 15 minutes over 8 rows, each row gets
+//  about 12 writes a day; at the EEPROM's rated 1M cycles that's centuries.
+#define PERSIST_INTERVAL    900
+
+void persistStart(void);
+bool persistLoad(persistRecord* record);
+void persistUpdate(persistRecord* record);
+uint16_t persistCRC(const uint8_t* data, uint8_t length);
+
+#endif
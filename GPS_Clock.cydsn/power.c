@@ -0,0 +1,233 @@
+#include "power.h"
+#include "brightness.h"
+#include "ws281x_7seg.h"
+#include "scheduler.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  The LED power budget. The current the LEDs draw follows from the bytes
+*   they were last sent, and StripLights keeps the sum of those bytes for
+*   its row as pixels are written (StripLights_RowDrive()), so the estimate
+*   is one number per string, updated as each string goes out; nothing
+*   rescans the pixels.
+*
+*  Before a string is sent, powerCheck() works out what the whole display
+*   would draw with it in place of what that string shows now. If that's
+*   over budget it pulls the brightness limit down to fit, and says so, and
+*   the display code draws the string again in the dimmer colors, and queues
+*   the others to follow. The strings already out are still showing the
+*   brighter colors, though, so powerFits() holds back any string that would
+*   go over the budget next to them until they've been sent dimmer. When
+*   none of the strings queued can go out without that, powerDimToFit()
+*   says how far the StripLights hardware dim shift has to take one down
+*   to go out anyway, so the LEDs never draw more than the budget.
+*
+*  Each string's drive is also kept as it would be with no limit (what was
+*   sent, scaled back up by the limit it was sent at), so the limit that
+*   fits can be worked out directly, and can go back up again when the
+*   display gets darker. Strings still queued are only known by what they
+*   showed last, so the limit only goes up on the last string of a frame,
+*   when there's nothing left it doesn't know about. It only goes up as far
+*   as the brightest the display has been for the last POWER_RAISE_HOLD_S
+*   would allow, though, or it would follow the seconds digits down and up
+*   again all minute, sending the whole display each time. For the same
+*   reason the colons, which blink, count while they're off at the drive
+*   they last had on.
+******************************************************************************/
+
+// LEDs there are, lit or not.
+#define IDLE_MA (((NUM_DIGITS * LEDS_PER_DIGIT) + (2 * COLON_LEDS)) * \
+  POWER_IDLE_MA)
+
+// POWER_RAISE_HOLD_S in scheduler ticks.
+#define POWER_RAISE_HOLD (POWER_RAISE_HOLD_S * SCHED_TIMER_HZ)
+
+static uint32_t budgetMa = POWER_BUDGET_MA;
+
+// Per string: the drive it was sent, and the same with no limit.
+static uint32_t sentDrive[COLON_STRING + 1];
+static uint32_t fullDrive[COLON_STRING + 1];
+
+// The most the display has drawn with no limit, in the hold period now
+//  running and the one before, and when the one now running started.
+static uint64_t peakTotal[2];
+static uint32_t holdStart;
+
+// The colon channel drives both colon strings, so twice the row.
+static uint32_t stringDrive(uint8_t string, uint32_t drive)
+{
+  return (string == COLON_STRING) ? (2 * drive) : drive;
+}
+
+// The LED drive the budget leaves once the idle current is taken out.
+static uint32_t allowedDrive(void)
+{
+  return (budgetMa > IDLE_MA) ?
+    (((budgetMa - IDLE_MA) * 255) / POWER_CHANNEL_MA) : 0;
+}
+
+static uint32_t unlimited(uint32_t drive)
+{
+  return (uint32_t)(((uint64_t)drive * BRIGHTNESS_UNLIMITED) /
+    brightnessLimit());
+}
+
+// The string's drive with no limit, as the limit sees it: dark colons count
+//  as they were when last lit.
+static uint32_t budgetedDrive(uint8_t string, uint32_t drive)
+{
+  if ((string == COLON_STRING) && (drive == 0))
+  {
+    return fullDrive[COLON_STRING];
+  }
+  return unlimited(stringDrive(string, drive));
+}
+
+void powerBudget(uint32_t milliamps)
+{
+  budgetMa = milliamps;
+}
+
+// Call with the drive of a string about to be sent, and whether it's the
+//  last one queued. Returns true if the limit had to move, so the string
+//  needs drawing again.
+bool powerCheck(uint8_t string, uint32_t drive, bool lastQueued)
+{
+  uint16_t limit = brightnessLimit();
+  uint32_t wanted = BRIGHTNESS_UNLIMITED;
+  uint32_t raised = BRIGHTNESS_UNLIMITED;
+  uint32_t held = schedulerUptime() - holdStart;
+  uint32_t allowed = allowedDrive();
+  uint32_t target = allowed - (allowed >> POWER_MARGIN_SHIFT);
+  uint32_t ceiling = allowed - (allowed >> (POWER_MARGIN_SHIFT + 1));
+  uint64_t total = 0;
+  uint64_t brightest;
+  uint8_t other;
+
+  if (budgetMa != POWER_NO_BUDGET)
+  {
+    for (other = 0; other <= COLON_STRING; other++)
+    {
+      total += (other == string) ? budgetedDrive(string, drive) :
+        fullDrive[other];
+    }
+    if (total > target)
+    {
+      wanted = (uint32_t)(((uint64_t)target * BRIGHTNESS_UNLIMITED) / total);
+      wanted = (wanted > 0) ? wanted : 1;
+    }
+    // Going up, it goes by the brightest it's been over the hold.
+    if (held >= POWER_RAISE_HOLD)
+    {
+      peakTotal[1] = (held < (2 * POWER_RAISE_HOLD)) ? peakTotal[0] : 0;
+      peakTotal[0] = 0;
+      holdStart += held;
+    }
+    peakTotal[0] = (total > peakTotal[0]) ? total : peakTotal[0];
+    brightest = (peakTotal[1] > peakTotal[0]) ? peakTotal[1] : peakTotal[0];
+    if (brightest > target)
+    {
+      raised = (uint32_t)(((uint64_t)target * BRIGHTNESS_UNLIMITED) /
+        brightest);
+    }
+  }
+
+  // Down as soon as it's needed; up only at the end of a frame, and by
+  //  enough to be worth sending the display again.
+  if ((wanted < limit) &&
+    (((total * limit) / BRIGHTNESS_UNLIMITED) > ceiling))
+  {
+    brightnessSetLimit((uint16_t)wanted);
+    return true;
+  }
+  if (lastQueued && (raised > limit) &&
+    ((raised == BRIGHTNESS_UNLIMITED) ||
+    ((raised - limit) >= (uint32_t)(limit >> POWER_RAISE_SHIFT))))
+  {
+    brightnessSetLimit((uint16_t)raised);
+    return true;
+  }
+  return false;
+}
+
+// What the other strings draw now, as they were last sent.
+static uint32_t othersDrive(uint8_t string)
+{
+  uint32_t total = 0;
+  uint8_t other;
+
+  for (other = 0; other <= COLON_STRING; other++)
+  {
+    total += (other == string) ? 0 : sentDrive[other];
+  }
+  return total;
+}
+
+// True if the string can go out now without the LEDs, as they'll be once
+//  it's latched, drawing more than the budget.
+bool powerFits(uint8_t string, uint32_t drive)
+{
+  return (budgetMa == POWER_NO_BUDGET) ||
+    ((othersDrive(string) + stringDrive(string, drive)) <= allowedDrive());
+}
+
+// Of the strings in the mask (bit 6 the colons), the one drawing the most
+//  now, as it was last sent.
+uint8_t powerBrightest(uint8_t strings)
+{
+  uint8_t brightest = 0;
+  uint32_t most = 0;
+  uint8_t string;
+
+  for (string = 0; string <= COLON_STRING; string++)
+  {
+    if ((strings & (1 << string)) && (sentDrive[string] >= most))
+    {
+      brightest = string;
+      most = sentDrive[string];
+    }
+  }
+  return brightest;
+}
+
+// The least dim shift that lets the string go out now within the budget.
+//  The shift drops each byte's low bits, so the string draws no more than
+//  its drive shifted down.
+uint8_t powerDimToFit(uint8_t string, uint32_t drive)
+{
+  uint32_t others = othersDrive(string);
+  uint8_t dim;
+
+  for (dim = 0; dim <= POWER_DIM_MAX; dim++)
+  {
+    if ((budgetMa == POWER_NO_BUDGET) ||
+      ((others + stringDrive(string, drive >> dim)) <= allowedDrive()))
+    {
+      return dim;
+    }
+  }
+  return POWER_DIM_BLACK;
+}
+
+// Call with the drive of the string as drawn, and the dim shift it's sent
+//  at, as it goes out.
+void powerSent(uint8_t string, uint32_t drive, uint8_t dim)
+{
+  sentDrive[string] = (dim > POWER_DIM_MAX) ? 0 :
+    stringDrive(string, drive >> dim);
+  fullDrive[string] = budgetedDrive(string, drive);
+}
+
+// What the LEDs draw now, as they were last sent.
+uint32_t powerEstimateMa(void)
+{
+  uint32_t total = 0;
+  uint8_t string;
+
+  for (string = 0; string <= COLON_STRING; string++)
+  {
+    total += sentDrive[string];
+  }
+  return ((total * POWER_CHANNEL_MA) + 127) / 255 + IDLE_MA;
+}
@@ -0,0 +1,41 @@
+#ifndef __power_h__
+#define __power_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// What the LED supply can deliver, and what the LEDs draw from it:
+//  POWER_CHANNEL_MA for each color at full drive, in proportion to its byte,
+//  and POWER_IDLE_MA per LED whatever it shows. All eights in white, as at
+//  boot, is about 16A at the default brightness and 31A at full.
+#define POWER_BUDGET_MA    10000
+#define POWER_CHANNEL_MA   20
+#define POWER_IDLE_MA      1
+
+// powerBudget(POWER_NO_BUDGET) turns the limiter off.
+#define POWER_NO_BUDGET    0
+
+// The limit aims 1/2^POWER_MARGIN_SHIFT under the budget, which more than
+//  covers the LED bytes rounding up, and only comes down once the display
+//  would use up half that margin. It only goes back up when the display
+//  could take at least 1/2^POWER_RAISE_SHIFT more light, and has for at
+//  least POWER_RAISE_HOLD_S: a minute covers the seconds going all the way
+//  round, so they don't move it.
+#define POWER_MARGIN_SHIFT 6
+#define POWER_RAISE_SHIFT  3
+#define POWER_RAISE_HOLD_S 60
+
+// powerDimToFit() gives the StripLights dim shift a string can go out at,
+//  up to POWER_DIM_MAX, or POWER_DIM_BLACK if it can only go out black.
+#define POWER_DIM_MAX      7
+#define POWER_DIM_BLACK    (POWER_DIM_MAX + 1)
+
+void powerBudget(uint32_t milliamps);
+bool powerCheck(uint8_t string, uint32_t drive, bool lastQueued);
+bool powerFits(uint8_t string, uint32_t drive);
+uint8_t powerBrightest(uint8_t strings);
+uint8_t powerDimToFit(uint8_t string, uint32_t drive);
+void powerSent(uint8_t string, uint32_t drive, uint8_t dim);
+uint32_t powerEstimateMa(void);
+
+#endif
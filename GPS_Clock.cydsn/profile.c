@@ -0,0 +1,112 @@
+#include "profile.h"
+#include "project.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#if defined(__linux__)
+  #include <time.h>
+#endif
+
+/******************************************************************************
+*  A very small profiler: PROFILE_START()/PROFILE_STOP() pairs around the
+*   interesting bits of code, a table of call count, min, max and total time
+*   per pair, and a way to get the table out over USB.
+*
+*  On the PSoC the clock is the Cortex-M3's DWT cycle counter, which runs at
+*   the CPU clock and costs a single load to read. On a host build there's no
+*   DWT, so we use CLOCK_MONOTONIC instead.
+*
+*  Nothing here locks; a section timed in main code and interrupted by an ISR
+*   includes the ISR's time, which is usually what you want to know anyway.
+*   Don't time the same section from both, though; they share a start time.
+******************************************************************************/
+
+void profileStart(void)
+{
+#if !defined(__linux__)
+  // The DWT cycle counter is off until the trace block is enabled.
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+#if PROFILING
+  profileReset();
+#endif
+}
+
+// Free-running count (CPU cycles, or ns on a host). It wraps, so only take
+//  differences.
+uint32_t cycleCount(void)
+{
+#if defined(__linux__)
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((now.tv_sec * 1000000000ULL) + now.tv_nsec);
+#else
+  return DWT->CYCCNT;
+#endif
+}
+
+#if PROFILING
+
+profileEntry profileTable[PROF_COUNT];
+
+void profileRecordTime(profileID id, uint32_t elapsed)
+{
+  profileEntry* entry = &profileTable[id];
+
+  entry->calls++;
+  entry->total += elapsed;
+  if (elapsed < entry->min)
+  {
+    entry->min = elapsed;
+  }
+  if (elapsed > entry->max)
+  {
+    entry->max = elapsed;
+  }
+}
+
+void profileReset(void)
+{
+  uint8_t id;
+  uint8 intState = CyEnterCriticalSection();
+  memset(profileTable, 0, sizeof(profileTable));
+  for (id = 0; id < PROF_COUNT; id++)
+  {
+    profileTable[id].min = UINT32_MAX;
+  }
+  CyExitCriticalSection(intState);
+}
+
+// Fills in the record for one table entry; false once index runs off the end.
+bool profileRead(uint8_t index, profileRecord* record)
+{
+  profileEntry entry;
+  uint8_t i;
+
+  if (index >= PROF_COUNT)
+  {
+    return false;
+  }
+  // The ISRs may be updating their entries; take a consistent copy.
+  uint8 intState = CyEnterCriticalSection();
+  entry = profileTable[index];
+  CyExitCriticalSection(intState);
+
+  memset(record, 0, sizeof(profileRecord));
+  record->sync = PROFILE_SYNC;
+  record->id = index;
+  record->count = PROF_COUNT;
+  record->calls = entry.calls;
+  record->min = entry.calls ? entry.min : 0;
+  record->max = entry.max;
+  record->mean = entry.calls ? (uint32_t)(entry.total / entry.calls) : 0;
+  for (i = 0; i < PROFILE_RECORD_SIZE - 1; i++)
+  {
+    record->checksum ^= ((const uint8_t*)record)[i];
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __profile_h__
+#define __profile_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Set to 1 to time the hot paths below, here or with -DPROFILING=1. At 0 the
+//  PROFILE_ macros vanish and the table isn't even built, so leaving the
+//  hooks in place costs nothing.
+#ifndef PROFILING
+  #define PROFILING 0
+#endif
+
+// Every timed section gets one of these. The host decoder has a matching list
+//  of names, in the same order.
+typedef enum
+{
+  PROF_NMEA_PARSE,
+  PROF_UTC_OFFSET,
+  PROF_DST_CHECK,
+  PROF_WRITE_DIGIT,
+  PROF_RENDER_STRING,
+  PROF_STRIP_FISR,
+  PROF_STRIP_CISR,
+  PROF_USB,
+  PROF_SOLAR,
+  PROF_COUNT
+} profileID;
+
+// What gets kept for each section. Times are CPU cycles on the PSoC, and
+//  nanoseconds on a host build.
+typedef struct
+{
+  uint32_t calls;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  uint32_t start;
+} profileEntry;
+
+// One section's figures, as they go out over USB CDC in answer to a
+//  PROFILE_DUMP_CMD. The layout rules are the same as for telemetryRecord.
+typedef struct
+{
+  uint8_t  sync;          // Always PROFILE_SYNC
+  uint8_t  id;            // profileID
+  uint8_t  count;         // PROF_COUNT, so the reader knows when it's done
+  uint8_t  reserved;
+  uint32_t calls;
+  uint32_t min;
+  uint32_t max;
+  uint32_t mean;
+  uint8_t  pad[3];
+  uint8_t  checksum;      // XOR of all the bytes before it
+} profileRecord;
+
+#define PROFILE_SYNC         0x5A
+#define PROFILE_RECORD_SIZE  24
+
+// Bytes the host sends to ask for the table, or to clear it.
+#define PROFILE_DUMP_CMD     'P'
+#define PROFILE_RESET_CMD    'R'
+
+void profileStart(void);
+uint32_t cycleCount(void);
+
+#if PROFILING
+  extern profileEntry profileTable[PROF_COUNT];
+
+  #define PROFILE_START(id) (profileTable[id].start = cycleCount())
+  #define PROFILE_STOP(id)  profileRecordTime(id, \
+    cycleCount() - profileTable[id].start)
+
+  void profileRecordTime(profileID id, uint32_t elapsed);
+  void profileReset(void);
+  bool profileRead(uint8_t index, profileRecord* record);
+#else
+  #define PROFILE_START(id)
+  #define PROFILE_STOP(id)
+#endif
+
+#endif
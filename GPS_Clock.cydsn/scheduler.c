@@ -0,0 +1,153 @@
+#include "scheduler.h"
+#include "project.h"
+#include <stdint.h>
+
+/******************************************************************************
+*  The clock spends almost all of its time waiting: for the next GPS byte, the
+*   next colon blink, or the LED hardware to finish shifting a string out. So
+*   rather than spin, the main loop hands its work to runScheduler(), which
+*   runs whatever tasks have events pending and otherwise puts the CPU to sleep
+*   until the next interrupt.
+*
+*  Some event sources (the UART receive buffer, the StripLights transfer) live
+*   inside generated components whose ISRs we can't post from. Those get
+*   checked by the poll function every pass instead; any interrupt wakes the
+*   CPU, so the poll always gets a look after the hardware has done something.
+*
+*  The SysTick runs free off the ILO with its interrupt off, purely as a
+*   timestamp, so we can keep track of how much of the time the CPU is awake.
+******************************************************************************/
+
+#define SYSTICK_MASK 0x00FFFFFF
+
+static volatile uint32_t pendingEvents;
+
+// Sleep bookkeeping for the busy figure.
+static uint32_t windowStart;
+static uint32_t windowIdle;
+static uint8_t busyPercent;
+
+static schedStats stats;
+
+// The table runScheduler() was last handed, for its run counts.
+static const schedTask* taskTable;
+static uint8_t taskCount;
+
+// Time since schedulerStart(), carried past the SysTick's 24 bits by adding in
+//  what's elapsed on every pass. Passes come far more often than it wraps.
+static uint32_t uptime;
+static uint32_t uptimeStamp;
+
+// SysTick counts down, so time elapsed is earlier minus later, modulo its 24
+//  bits.
+static uint32_t ticksSince(uint32_t then)
+{
+  return (then - CySysTickGetValue()) & SYSTICK_MASK;
+}
+
+void schedulerStart(void)
+{
+  CySysTickSetClockSource(CY_SYS_SYST_CSR_CLK_SRC_LFCLK);
+  CySysTickSetReload(SYSTICK_MASK);
+  CySysTickClear();
+  CySysTickDisableInterrupt();
+  CySysTickEnable();
+  windowStart = CySysTickGetValue();
+  windowIdle = 0;
+  busyPercent = 0;
+  uptime = 0;
+  uptimeStamp = windowStart;
+  stats.passes = 0;
+  stats.sleeps = 0;
+  stats.emptyWakes = 0;
+}
+
+// Safe to call from an ISR.
+void postEvent(uint32_t events)
+{
+  uint8 intState = CyEnterCriticalSection();
+  pendingEvents |= events;
+  CyExitCriticalSection(intState);
+}
+
+// One pass: collect events, sleeping first if there are none, then run the
+//  tasks that want them. Call it forever from main().
+void runScheduler(schedTask tasks[], uint8_t numTasks,
+  void (*pollEvents)(void))
+{
+  uint32_t events;
+  uint8_t i;
+
+  // The poll and the sleep both happen with interrupts masked. Otherwise an
+  //  interrupt landing between the two could leave work sitting there while
+  //  we sleep. WFI still wakes on a masked interrupt; it runs as soon as we
+  //  leave the critical section.
+  uint8 intState = CyEnterCriticalSection();
+  pollEvents();
+  if (pendingEvents == 0)
+  {
+    uint32_t sleepStart = CySysTickGetValue();
+    CY_PM_WFI;
+    windowIdle += ticksSince(sleepStart);
+    stats.sleeps++;
+  }
+  events = pendingEvents;
+  pendingEvents = 0;
+  CyExitCriticalSection(intState);
+
+  taskTable = tasks;
+  taskCount = numTasks;
+  stats.passes++;
+  if (events == 0)
+  {
+    stats.emptyWakes++;
+  }
+  for (i = 0; i < numTasks; i++)
+  {
+    if (tasks[i].events & events)
+    {
+      tasks[i].run();
+      tasks[i].runCount++;
+    }
+  }
+
+  uint32_t now = CySysTickGetValue();
+  uptime += (uptimeStamp - now) & SYSTICK_MASK;
+  uptimeStamp = now;
+
+  uint32_t windowLength = ticksSince(windowStart);
+  if (windowLength >= SCHED_WINDOW)
+  {
+    if (windowIdle > windowLength)
+    {
+      windowIdle = windowLength;
+    }
+    busyPercent = ((windowLength - windowIdle) * 100) / windowLength;
+    windowStart = CySysTickGetValue();
+    windowIdle = 0;
+  }
+}
+
+// Time since schedulerStart(), in SysTick counts (SCHED_TIMER_HZ).
+uint32_t schedulerUptime(void)
+{
+  return uptime + ticksSince(uptimeStamp);
+}
+
+// Share of the last window the CPU spent awake, 0-100.
+uint8_t cpuBusyPercent(void)
+{
+  return busyPercent;
+}
+
+void schedulerStats(schedStats* out)
+{
+  *out = stats;
+}
+
+// The tasks, with their run counts; none before the first pass.
+const schedTask* schedulerTasks(uint8_t* numTasks)
+{
+  *numTasks = taskCount;
+  return taskTable;
+}
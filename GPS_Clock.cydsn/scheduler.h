@@ -0,0 +1,47 @@
+#ifndef __scheduler_h__
+#define __scheduler_h__
+
+#include <stdint.h>
+
+// Events that wake the main loop. Interrupts (or the poll function handed to
+//  runScheduler()) post them; each pass of the scheduler takes every pending
+//  event at once and runs the tasks that asked for them. One bit per event.
+#define EVENT_UART_RX       0x01  // GPS bytes waiting in the UART buffer
+#define EVENT_TICK          0x02  // ClockTick fired; time to blink the colons
+#define EVENT_TIME_CHANGED  0x04  // A new time came in from the GPS
+#define EVENT_DISPLAY       0x08  // LED transfer finished, or strings queued
+#define EVENT_USB           0x10  // USB host has room for more data
+
+// A task runs once per scheduler pass in which any of its events are pending.
+//  runCount is there for profiling; the scheduler bumps it on every run.
+typedef struct
+{
+  uint32_t events;
+  void (*run)(void);
+  uint32_t runCount;
+} schedTask;
+
+// The busy figure is worked out over windows of this many SysTick counts. The
+//  SysTick is clocked from the 100kHz ILO, so this is one second.
+#define SCHED_TIMER_HZ      100000
+#define SCHED_WINDOW        SCHED_TIMER_HZ
+
+// Counts since schedulerStart(). A wake with nothing pending was some
+//  interrupt no task cares about.
+typedef struct
+{
+  uint32_t passes;
+  uint32_t sleeps;
+  uint32_t emptyWakes;
+} schedStats;
+
+void schedulerStart(void);
+void postEvent(uint32_t events);
+void runScheduler(schedTask tasks[], uint8_t numTasks,
+  void (*pollEvents)(void));
+uint8_t cpuBusyPercent(void);
+void schedulerStats(schedStats* stats);
+const schedTask* schedulerTasks(uint8_t* numTasks);
+uint32_t schedulerUptime(void);
+
+#endif
@@ -0,0 +1,302 @@
+#include "solar.h"
+#include "date_time.h"
+#include "profile.h"
+#include "trig.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  Sunrise, sunset and civil twilight from the position the GPS reports, for
+*   the brightness schedule. There's nothing here but arithmetic, so the
+*   same code runs on the host against a reference table (see Host/sim).
+*
+*  Where the sun is comes from the Astronomical Almanac's low-precision
+*   formulas: its mean longitude and anomaly, a straight line in time from
+*   2000, give its true longitude, and from that its declination and the
+*   equation of time, to about 0.01 degree and a few seconds this century.
+*   The hour angle at which the sun's center is a given height above or
+*   below the horizon is then
+*
+*    cos(h) = (sin(height) - sin(lat) sin(decl)) / (cos(lat) cos(decl))
+*
+*   and the sun crosses that height h either side of its noon. Sunrise and
+*   sunset take the height as -0.833 degrees, for refraction and the sun's
+*   radius; civil twilight ends at -6. If the right hand side is out of
+*   +-1, the sun doesn't cross that height all day. It's all worked out
+*   first with the sun where it is at noon, then again with it where it is
+*   at each of the times that gives, as it moves on a little in between.
+*
+*  All of it is integer. Angles are binary (trig.h), with the long-running
+*   ones in 2^32nds of a turn so a daily step adds up right over decades;
+*   sines are Q15. It comes out within a minute or so of the full
+*   calculation below the polar circles, far finer than a schedule needs,
+*   and it's only worked out once a day, when the date changes.
+******************************************************************************/
+
+#define SECONDS_PER_DAY   86400L
+#define MICRODEGREES_TURN 360000000LL
+
+// The sun's mean longitude and mean anomaly at 00:00 UTC on 1 January 2000,
+//  and how far each goes in a day; 2^32nds of a turn.
+#define LONGITUDE_AT_2000   3340138517UL  // 279.967 degrees
+#define LONGITUDE_A_DAY     11759232UL    // 0.9856474 degrees
+#define ANOMALY_AT_2000     4259595852UL  // 357.036 degrees
+#define ANOMALY_A_DAY       11758670UL    // 0.9856003 degrees
+
+// The equation of center, 1.915 and 0.020 degrees.
+#define CENTER_1            22846840L
+#define CENTER_2            238609L
+
+// The tilt of the earth's axis, 23.439 degrees in 2000, and its drift, in
+//  2^32nds of a turn a hundred days.
+#define OBLIQUITY_AT_2000   279638162UL
+#define OBLIQUITY_DRIFT     477
+
+// sin() of the heights, Q15.
+#define SUNRISE_HEIGHT    (-476)   // -0.833 degrees
+#define TWILIGHT_HEIGHT   (-3425)  // -6 degrees
+
+// The sun's declination, as a sine and cosine (Q15), and the equation of
+//  time, the seconds the sun's noon is ahead of the clock's.
+typedef struct
+{
+  int16_t sinDeclination;
+  int16_t cosDeclination;
+  int32_t equation;
+} sunPosition;
+
+// Today's times, and what they were worked out for.
+static solarTimes today;
+static bool todayValid;
+static uint16_t todayDay;
+static int32_t todayLatitude;
+static int32_t todayLongitude;
+
+// Rounds a division to nearest, either sign.
+static int32_t divideRounded(int32_t value, int32_t by)
+{
+  return (value >= 0) ? ((value + (by / 2)) / by) : ((value - (by / 2)) / by);
+}
+
+// Seconds past midnight, wrapped into the one day.
+static int32_t wrapDay(int32_t seconds)
+{
+  seconds %= SECONDS_PER_DAY;
+  return (seconds < 0) ? (seconds + SECONDS_PER_DAY) : seconds;
+}
+
+// A 2^32nds of a turn angle, to the nearest binary angle.
+static uint16_t binary(uint32_t angle)
+{
+  return (uint16_t)((angle + 0x8000UL) >> 16);
+}
+
+static uint32_t squareRoot(uint32_t x)
+{
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > x)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (x >= root + bit)
+    {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Where the sun is, seconds from 00:00 UTC on a day (days since 1 January
+//  2000). The angles wrap round a turn as they add up, as they should.
+static void sunAt(uint16_t day, int32_t seconds, sunPosition* sun)
+{
+  uint32_t meanLongitude = LONGITUDE_AT_2000 + (day * LONGITUDE_A_DAY) +
+    (uint32_t)((seconds * (int64_t)LONGITUDE_A_DAY) / SECONDS_PER_DAY);
+  uint32_t anomaly = ANOMALY_AT_2000 + (day * ANOMALY_A_DAY) +
+    (uint32_t)((seconds * (int64_t)ANOMALY_A_DAY) / SECONDS_PER_DAY);
+  uint32_t obliquity = OBLIQUITY_AT_2000 -
+    (((uint32_t)day * OBLIQUITY_DRIFT) / 100);
+  int16_t sinAnomaly = trigSin(binary(anomaly));
+  int16_t sin2Anomaly = trigSin((uint16_t)(2 * binary(anomaly)));
+  uint16_t longitude = binary(meanLongitude + (uint32_t)((((int64_t)CENTER_1 *
+    sinAnomaly) + ((int64_t)CENTER_2 * sin2Anomaly)) / TRIG_ONE));
+  int32_t sinDeclination = ((int32_t)trigSin(binary(obliquity)) *
+    trigSin(longitude)) / TRIG_ONE;
+  uint32_t cosDeclination = squareRoot((uint32_t)((TRIG_ONE * TRIG_ONE) -
+    (sinDeclination * sinDeclination)));
+
+  // The equation of time, tenths of a second.
+  int32_t equation = ((-4596 * sinAnomaly) - (48 * sin2Anomaly) +
+    (5918 * trigSin((uint16_t)(2 * longitude))) -
+    (127 * trigSin((uint16_t)(4 * longitude)))) / TRIG_ONE;
+
+  sun->sinDeclination = (int16_t)sinDeclination;
+  sun->cosDeclination = (int16_t)((cosDeclination < TRIG_ONE) ?
+    cosDeclination : (TRIG_ONE - 1));
+  sun->equation = divideRounded(equation, 10);
+}
+
+// When the sun crosses a height (its sine, Q15) on one side of noon, going
+//  by where it is at the time in sun. Times are seconds from 00:00 UTC on
+//  the day; noon is when it would be noon with no equation of time.
+static uint8_t crossing(const sunPosition* sun, int16_t sinLatitude,
+  int16_t cosLatitude, int32_t height, int32_t noon, bool rising,
+  int32_t* when)
+{
+  // Both Q30.
+  int32_t above = (height * TRIG_ONE) -
+    ((int32_t)sinLatitude * sun->sinDeclination);
+  int32_t scale = (int32_t)cosLatitude * sun->cosDeclination;
+  int64_t cosHour;
+  int32_t half;
+
+  // At a pole, the sun is up or down all day.
+  if (scale <= 0)
+  {
+    cosHour = (above > 0) ? TRIG_ONE : -TRIG_ONE;
+  }
+  else
+  {
+    cosHour = ((int64_t)above * TRIG_ONE) / scale;
+  }
+  if (cosHour >= TRIG_ONE - 1)
+  {
+    return SOLAR_ALWAYS_DOWN;
+  }
+  if (cosHour <= -(TRIG_ONE - 1))
+  {
+    return SOLAR_ALWAYS_UP;
+  }
+
+  // A turn of hour angle is a day; 86400/65536 is 675/512.
+  half = (((int32_t)trigAcos((int32_t)cosHour) * 675) + 256) >> 9;
+  *when = noon - sun->equation + (rising ? -half : half);
+  return SOLAR_RISES_AND_SETS;
+}
+
+// Sunrise and sunset, or dawn and dusk: a first go with the sun where it is
+//  at noon, then again with it where it is at those times.
+static void crossings(uint16_t day, const sunPosition* atNoon,
+  int16_t sinLatitude, int16_t cosLatitude, int32_t height, int32_t noon,
+  int8_t zone, solarEvent* event)
+{
+  sunPosition sun;
+  int32_t rise;
+  int32_t set;
+
+  event->sky = crossing(atNoon, sinLatitude, cosLatitude, height, noon,
+    true, &rise);
+  if (event->sky != SOLAR_RISES_AND_SETS)
+  {
+    return;
+  }
+  crossing(atNoon, sinLatitude, cosLatitude, height, noon, false, &set);
+
+  // Just inside the polar circles the second go can find the sun no longer
+  //  crosses; the first go's time is as good as any then.
+  sunAt(day, rise, &sun);
+  crossing(&sun, sinLatitude, cosLatitude, height, noon, true, &rise);
+  sunAt(day, set, &sun);
+  crossing(&sun, sinLatitude, cosLatitude, height, noon, false, &set);
+
+  event->rise = wrapDay(rise + ((int32_t)zone * 3600));
+  event->set = wrapDay(set + ((int32_t)zone * 3600));
+}
+
+// latitude and longitude are in millionths of a degree, north and east
+//  positive; day counts from 1 January 2000, as dateTimeToEpoch() does.
+//  Times come out in seconds past midnight in the zone zone hours from UTC.
+void solarCalculate(int32_t latitude, int32_t longitude, uint16_t day,
+  int8_t zone, solarTimes* times)
+{
+  uint16_t latitudeAngle = (uint16_t)(((int64_t)latitude * TRIG_TURN) /
+    MICRODEGREES_TURN);
+  int16_t sinLatitude = trigSin(latitudeAngle);
+  int16_t cosLatitude = trigCos(latitudeAngle);
+  sunPosition sun;
+
+  // Noon on the clock of the sun, less the equation of time: four minutes
+  //  from 12:00 UTC for every degree west.
+  int32_t noon = (SECONDS_PER_DAY / 2) - divideRounded(longitude * 6, 25000);
+
+  sunAt(day, noon, &sun);
+  crossings(day, &sun, sinLatitude, cosLatitude, SUNRISE_HEIGHT, noon, zone,
+    &times->sun);
+  crossings(day, &sun, sinLatitude, cosLatitude, TWILIGHT_HEIGHT, noon, zone,
+    &times->twilight);
+}
+
+// The times for the day localDateTime (standard time, TIMEZONE) is in, at
+//  the given position; only worked out again when the date changes, or the
+//  position moves by more than SOLAR_MOVED.
+const solarTimes* solarToday(const date_time* localDateTime, int32_t latitude,
+  int32_t longitude)
+{
+  uint16_t day = (uint16_t)(dateTimeToEpoch(localDateTime) / SECONDS_PER_DAY);
+
+  if (!todayValid || (day != todayDay) ||
+    (latitude - todayLatitude > SOLAR_MOVED) ||
+    (todayLatitude - latitude > SOLAR_MOVED) ||
+    (longitude - todayLongitude > SOLAR_MOVED) ||
+    (todayLongitude - longitude > SOLAR_MOVED))
+  {
+    PROFILE_START(PROF_SOLAR);
+    solarCalculate(latitude, longitude, day, TIMEZONE, &today);
+    PROFILE_STOP(PROF_SOLAR);
+    todayValid = true;
+    todayDay = day;
+    todayLatitude = latitude;
+    todayLongitude = longitude;
+  }
+  return &today;
+}
+
+// Whether now (seconds past local standard midnight) is between the rise
+//  and the set; the set comes first when the day straddles midnight.
+static bool isUp(const solarEvent* event, int32_t now)
+{
+  if (event->sky != SOLAR_RISES_AND_SETS)
+  {
+    return event->sky == SOLAR_ALWAYS_UP;
+  }
+  if (event->rise <= event->set)
+  {
+    return (now >= event->rise) && (now < event->set);
+  }
+  return (now >= event->rise) || (now < event->set);
+}
+
+// The brightness the schedule wants at now, seconds past local standard
+//  midnight.
+uint8_t solarBrightness(const solarTimes* times, int32_t now)
+{
+  if (isUp(&times->sun, now))
+  {
+    return SOLAR_DAY_BRIGHTNESS;
+  }
+  if (isUp(&times->twilight, now))
+  {
+    return SOLAR_DUSK_BRIGHTNESS;
+  }
+  return SOLAR_NIGHT_BRIGHTNESS;
+}
+
+// Whether the display should be dark at minutes past midnight, display time.
+bool solarBlanked(uint16_t minutes)
+{
+  if (SOLAR_BLANK_FROM <= SOLAR_BLANK_UNTIL)
+  {
+    return (minutes >= SOLAR_BLANK_FROM) && (minutes < SOLAR_BLANK_UNTIL);
+  }
+  return (minutes >= SOLAR_BLANK_FROM) || (minutes < SOLAR_BLANK_UNTIL);
+}
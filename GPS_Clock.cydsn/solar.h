@@ -0,0 +1,67 @@
+#ifndef __solar_h__
+#define __solar_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "date_time.h"
+
+// Set to 1 to have the brightness follow the sun: SOLAR_DAY_BRIGHTNESS from
+//  sunrise to sunset, SOLAR_DUSK_BRIGHTNESS in the civil twilight either
+//  side, and SOLAR_NIGHT_BRIGHTNESS the rest of the night. With the ambient
+//  light sensor fitted (ambient.h) that has the last word on brightness, and
+//  only the blanking below applies.
+#ifndef SOLAR_SCHEDULE
+  #define SOLAR_SCHEDULE  1
+#endif
+
+#define SOLAR_DAY_BRIGHTNESS    255
+#define SOLAR_DUSK_BRIGHTNESS   140
+#define SOLAR_NIGHT_BRIGHTNESS  60
+
+// Where the clock is taken to be until the GPS gives a position, in
+//  millionths of a degree, north and east positive; a spot in the TIMEZONE
+//  (date_time.h) is near enough. This is Salt Lake City.
+#define SOLAR_LATITUDE    40725000L
+#define SOLAR_LONGITUDE (-111858333L)
+
+// The display goes dark, and nothing is sent to the LEDs at all, from
+//  SOLAR_BLANK_FROM up to SOLAR_BLANK_UNTIL, in minutes past midnight by the
+//  time on the display. The same for both never blanks.
+#ifndef SOLAR_BLANK_FROM
+  #define SOLAR_BLANK_FROM   0
+#endif
+#ifndef SOLAR_BLANK_UNTIL
+  #define SOLAR_BLANK_UNTIL  0
+#endif
+
+// How far the position can move before the day's times are worked out
+//  again; a tenth of a degree is well under a minute of sunrise.
+#define SOLAR_MOVED       100000L
+
+// When the sun crosses a horizon: either a rise and a set in seconds past
+//  local standard midnight, or it doesn't cross that day at all.
+#define SOLAR_RISES_AND_SETS  0
+#define SOLAR_ALWAYS_UP       1
+#define SOLAR_ALWAYS_DOWN     2
+
+typedef struct
+{
+  int32_t rise;
+  int32_t set;
+  uint8_t sky;
+} solarEvent;
+
+typedef struct
+{
+  solarEvent sun;       // Sunrise and sunset
+  solarEvent twilight;  // Civil dawn and dusk, the sun 6 degrees down
+} solarTimes;
+
+void solarCalculate(int32_t latitude, int32_t longitude, uint16_t day,
+  int8_t zone, solarTimes* times);
+const solarTimes* solarToday(const date_time* localDateTime, int32_t latitude,
+  int32_t longitude);
+uint8_t solarBrightness(const solarTimes* times, int32_t now);
+bool solarBlanked(uint16_t minutes);
+
+#endif
@@ -0,0 +1,131 @@
+#include "telemetry.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************
+*  Telemetry goes out over USB CDC as fixed-size binary records rather than
+*   formatted text. The tasks that know the numbers fill in a sample record as
+*   they go; telemetrySample() queues a copy of it only if something worth
+*   reporting has changed, and telemetryTick() makes sure one goes out every
+*   so often regardless.
+*
+*  The ring has exactly one producer (the sampling calls) and one consumer
+*   (telemetryRead(), from the USB task). Each side only ever writes its own
+*   index, so neither needs to lock the other out. If the host isn't reading,
+*   the ring fills and new records are dropped, and counted.
+******************************************************************************/
+
+static telemetryRecord ring[TELEMETRY_RING_SIZE];
+static volatile uint8_t ringHead; // Next slot to write; producer only
+static volatile uint8_t ringTail; // Next slot to read; consumer only
+
+static uint8_t seq;
+static uint8_t ringHighWater;
+static uint8_t dropped;
+static uint8_t ticksSinceSent;
+static telemetryRecord lastSent;
+
+// Read offset into the record at the tail, for reads that split records.
+static uint8_t tailOffset;
+
+// The fields that make a record worth sending. The cycle counts and the busy
+//  figure wander about all the time, so on their own they wait for the period.
+static bool sameState(const telemetryRecord* a, const telemetryRecord* b)
+{
+  return (a->fix == b->fix) &&
+    (a->hrs == b->hrs) && (a->min == b->min) && (a->sec == b->sec) &&
+    (a->day == b->day) && (a->month == b->month) && (a->year == b->year) &&
+    (a->uartHighWater == b->uartHighWater) &&
+    (a->lineHighWater == b->lineHighWater) &&
+    (ringHighWater == lastSent.ringHighWater) && (dropped == lastSent.dropped);
+}
+
+static void queueRecord(telemetryRecord* sample)
+{
+  uint8_t used = (uint8_t)(ringHead - ringTail);
+  uint8_t i;
+
+  if (used >= TELEMETRY_RING_SIZE)
+  {
+    if (dropped < 0xFF)
+    {
+      dropped++;
+    }
+    return;
+  }
+  if (used + 1 > ringHighWater)
+  {
+    ringHighWater = used + 1;
+  }
+
+  sample->sync = TELEMETRY_SYNC;
+  sample->seq = seq++;
+  sample->ringHighWater = ringHighWater;
+  sample->dropped = dropped;
+  sample->reserved = 0;
+  sample->checksum = 0;
+  for (i = 0; i < TELEMETRY_RECORD_SIZE - 1; i++)
+  {
+    sample->checksum ^= ((const uint8_t*)sample)[i];
+  }
+
+  ring[ringHead & (TELEMETRY_RING_SIZE - 1)] = *sample;
+  ringHead++; // Publish only once the record is all there.
+  lastSent = *sample;
+  ticksSinceSent = 0;
+}
+
+// Queue the sample if it differs from the last record sent.
+void telemetrySample(telemetryRecord* sample)
+{
+  if (!sameState(sample, &lastSent))
+  {
+    queueRecord(sample);
+  }
+}
+
+// Call on each ClockTick; queues the sample if the period has run out.
+void telemetryTick(telemetryRecord* sample)
+{
+  if (++ticksSinceSent >= TELEMETRY_PERIOD)
+  {
+    queueRecord(sample);
+  }
+  else
+  {
+    telemetrySample(sample);
+  }
+}
+
+bool telemetryPending(void)
+{
+  return ringHead != ringTail;
+}
+
+// Copies out as many queued bytes as fit, for the USB task. Records may split
+//  across reads; the decoder resyncs on TELEMETRY_SYNC and the checksum.
+uint16_t telemetryRead(uint8_t* buffer, uint16_t length)
+{
+  uint16_t copied = 0;
+
+  while ((copied < length) && (ringHead != ringTail))
+  {
+    const uint8_t* record =
+      (const uint8_t*)&ring[ringTail & (TELEMETRY_RING_SIZE - 1)];
+    uint16_t chunk = TELEMETRY_RECORD_SIZE - tailOffset;
+    if (chunk > length - copied)
+    {
+      chunk = length - copied;
+    }
+    memcpy(buffer + copied, record + tailOffset, chunk);
+    copied += chunk;
+    tailOffset += chunk;
+    if (tailOffset == TELEMETRY_RECORD_SIZE)
+    {
+      tailOffset = 0;
+      ringTail++; // Free the slot only once it's all copied out.
+    }
+  }
+  return copied;
+}
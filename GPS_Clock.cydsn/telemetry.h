@@ -0,0 +1,51 @@
+#ifndef __telemetry_h__
+#define __telemetry_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// One telemetry record, as it goes out over the USB CDC link. Everything is
+//  laid out on its natural alignment so there's no padding, and multi-byte
+//  fields are little-endian (as are both the M3 and any PC that will read
+//  them). The decoder in Host/ includes this header, so keep the two in step.
+typedef struct
+{
+  uint8_t  sync;          // Always TELEMETRY_SYNC
+  uint8_t  seq;           // Counts up per record; a gap means drops
+  uint8_t  fix;           // RMC status: 'A' valid, 'V' no fix, 0 no RMC yet
+  uint8_t  busy;          // CPU busy percent, from the scheduler
+  uint8_t  hrs;           // Local standard time, as parsed (no DST)
+  uint8_t  min;
+  uint8_t  sec;
+  uint8_t  day;
+  uint8_t  month;
+  uint8_t  year;
+  uint8_t  uartHighWater; // Most bytes ever waiting in the UART buffer
+  uint8_t  lineHighWater; // Longest NMEA sentence seen
+  uint32_t parseCycles;   // CPU cycles for the last parseNMEAData()
+  uint32_t renderCycles;  // CPU cycles for the last string render/trigger
+  uint32_t firstFrameMs;  // Reset to the first whole frame on the LEDs
+  uint32_t firstTimeMs;   // Reset to the first valid time from the GPS
+  uint8_t  ringHighWater; // Most records ever waiting to go out
+  uint8_t  dropped;       // Records lost to a full ring, saturating
+  uint8_t  reserved;
+  uint8_t  checksum;      // XOR of all the bytes before it
+} telemetryRecord;
+
+#define TELEMETRY_SYNC        0xA5
+#define TELEMETRY_RECORD_SIZE 32
+
+// Records queue up in a ring until the USB host takes them. Must be a power
+//  of two.
+#define TELEMETRY_RING_SIZE   16
+
+// Even if nothing changes, a record goes out every this many ClockTicks so
+//  the host can tell the clock is still alive.
+#define TELEMETRY_PERIOD      10
+
+void telemetrySample(telemetryRecord* sample);
+void telemetryTick(telemetryRecord* sample);
+bool telemetryPending(void);
+uint16_t telemetryRead(uint8_t* buffer, uint16_t length);
+
+#endif
@@ -0,0 +1,278 @@
+#include "ticklock.h"
+#include "project.h"
+#include "timesync.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  Left to itself ClockTick runs at whatever the IMO makes of half a second,
+*   so the colons drift through the seconds, and the digits change whenever
+*   the sentence happens to be parsed. This locks the ticks to the GPS
+*   instead, with no PPS pin: the only reference is when each second's RMC
+*   starts coming in, which is a fixed lag after the top of the second give
+*   or take the module's jitter.
+*
+*  Everything is measured on ClockTick's own count: the ISR adds up the
+*   counts in each tick, and a stamp is that plus how far the counter has got
+*   into the current one. The RMC's "$" is stamped as it's read, less the
+*   time on the wire of any bytes that came in behind it. Its distance from
+*   the last second's tick, against where it should be, is the phase error,
+*   and a PI loop works it off: part straight onto the next tick, and a
+*   little into the tick period, which is kept to a 65536th of a count so
+*   the average rate can match the GPS closely.
+*
+*  Every other tick starts a second. Once the loop has settled, that tick is
+*   when the seconds change on the display, and the RMC that follows only
+*   confirms it.
+*
+*  A slave clock has no RMC, but each time frame from the master says how
+*   far into the master's second it went out, and from that the loop gets
+*   a reference just as good (ticklockFrame()). The master fills that in from
+*   its own ticks (ticklockPhaseMs()), so the slaves' digits change with its.
+******************************************************************************/
+
+// Where the RMC should start after the second's tick.
+#define TARGET_MS  ((uint32_t)TICKLOCK_GPS_LAG_MS + TICKLOCK_LEAD_MS)
+
+#define SLIP_COUNTS  (((uint32_t)TICKLOCK_SLIP_MS * CLOCKTICK_HZ) / 1000)
+
+#define NOMINAL_PERIOD  ((int32_t)CLOCKTICK_COUNTS << 16)
+
+// Counts in every tick before the current one, and in the current one and
+//  the next (which is in the period register already).
+static volatile uint32_t tickTotal;
+static volatile uint16_t running = CLOCKTICK_COUNTS;
+static volatile uint16_t queued = CLOCKTICK_COUNTS;
+
+// The tick period, in 16.16 counts, and the fraction of a count carried
+//  over from the ticks so far.
+static int32_t period = NOMINAL_PERIOD;
+static int32_t carry;
+
+// Whether the last tick started a second, when it was, and how many have.
+static volatile bool second;
+static volatile uint32_t secondStamp;
+static volatile uint32_t secondCount;
+
+// The last sentence's time, and the second it started.
+static uint32_t referenceEpoch;
+static uint32_t referenceSecond;
+
+// The loop's gain shift, and seconds at it.
+static bool acquired;
+static uint8_t shift;
+static uint16_t settled;
+static uint8_t slips;
+
+// The first sentence since the last jump.
+static uint32_t firstEpoch;
+static uint32_t firstStamp;
+
+// Puts the period ClockTick starts out with, from TopDesign, to one this
+//  can steer: call straight after ClockTick_Start().
+void ticklockStart(void)
+{
+  ClockTick_WritePeriod(CLOCKTICK_COUNTS - 1);
+  ClockTick_WriteCounter(CLOCKTICK_COUNTS - 1);
+}
+
+// From the ClockTick ISR. The counter has just reloaded from the period
+//  register, so the period written here is for the tick after this one.
+//  Returns true when this tick starts a second.
+bool ticklockTick(void)
+{
+  int32_t next = carry + period;
+
+  tickTotal += running;
+  running = queued;
+  queued = next >> 16;
+  carry = next & 0xFFFF;
+  ClockTick_WritePeriod(queued - 1);
+
+  second = !second;
+  if (second)
+  {
+    secondStamp = tickTotal;
+    secondCount++;
+  }
+  return second;
+}
+
+// When something happened, on ClockTick's count: now, less bytesSince bytes
+//  on the wire from the UART, for a byte that has had others come in behind
+//  it.
+uint32_t ticklockStamp(uint16_t bytesSince)
+{
+  uint32_t total;
+  uint16_t counts;
+  uint16_t counter;
+
+  // The ISR can't run in between, but the counter may have reloaded just
+  //  before it does; read again if so.
+  do
+  {
+    total = tickTotal;
+    counts = running;
+    counter = ClockTick_ReadCounter();
+  } while (total != tickTotal);
+
+  // 10 bits a byte on the wire.
+  return total + (counts - 1 - counter) -
+    (((uint32_t)bytesSince * 10 * CLOCKTICK_HZ) / TIMESYNC_BAUD);
+}
+
+// Moves the next tick not yet under way by amount 16.16 counts, and every
+//  tick after it with it.
+static void nudge(int32_t amount)
+{
+  int32_t total = carry + amount;
+  int32_t whole = total >> 16;
+
+  carry = total - (whole * 65536);
+  queued += whole;
+  ClockTick_WritePeriod(queued - 1);
+}
+
+// Straight to where the GPS says, flipping which ticks start seconds if the
+//  half second ticks are nearer.
+static void jump(int32_t error)
+{
+  if (error >= (CLOCKTICK_COUNTS / 2))
+  {
+    error -= CLOCKTICK_COUNTS;
+    second = !second;
+  }
+  else if (error < -(CLOCKTICK_COUNTS / 2))
+  {
+    error += CLOCKTICK_COUNTS;
+    second = !second;
+  }
+  nudge(error * 65536L);
+  acquired = true;
+  shift = TICKLOCK_ACQUIRE_SHIFT;
+  settled = 0;
+  slips = 0;
+}
+
+static void setPeriod(int32_t newPeriod)
+{
+  if (newPeriod > NOMINAL_PERIOD + (NOMINAL_PERIOD >> TICKLOCK_RANGE_SHIFT))
+  {
+    newPeriod = NOMINAL_PERIOD + (NOMINAL_PERIOD >> TICKLOCK_RANGE_SHIFT);
+  }
+  else if (newPeriod < NOMINAL_PERIOD - (NOMINAL_PERIOD >> TICKLOCK_RANGE_SHIFT))
+  {
+    newPeriod = NOMINAL_PERIOD - (NOMINAL_PERIOD >> TICKLOCK_RANGE_SHIFT);
+  }
+  period = newPeriod;
+}
+
+// One second's worth of the PI loop.
+static void steer(int32_t error)
+{
+  setPeriod(period + ((error * 65536L) / (1L << ((2 * shift) + 3))));
+  nudge((error * 65536L) / (1L << shift));
+}
+
+// ms in counts, at the rate the loop has found.
+static uint32_t msToCounts(uint32_t ms)
+{
+  return ((uint64_t)ms * (uint32_t)period) / (32768UL * 1000);
+}
+
+// A second's RMC started at stamp (from ticklockStamp()), with a valid fix,
+//  and epoch is the second it gives.
+void ticklockReference(uint32_t epoch, uint32_t stamp)
+{
+  uint8_t interrupts = CyEnterCriticalSection();
+  // The target in counts at the rate the loop has found, not the nominal
+  //  one, or the IMO's error would be in it.
+  int32_t error = (int32_t)(stamp - secondStamp) -
+    (int32_t)msToCounts(TARGET_MS);
+  uint32_t seconds = secondCount;
+  bool slipped;
+
+  // Positive is the ticks running early. Take it to the nearest second's
+  //  tick, which may be the next one if they're running late.
+  while (error >= (CLOCKTICK_HZ / 2))
+  {
+    error -= CLOCKTICK_HZ;
+    seconds++;
+  }
+  while (error < -(CLOCKTICK_HZ / 2))
+  {
+    error += CLOCKTICK_HZ;
+    seconds--;
+  }
+
+  slipped = (error > (int32_t)SLIP_COUNTS) || (error < -(int32_t)SLIP_COUNTS);
+  if (!acquired || (slipped && (++slips >= TICKLOCK_SLIP_SECONDS)))
+  {
+    jump(error);
+    firstEpoch = epoch;
+    firstStamp = stamp;
+  }
+  else if (!slipped)
+  {
+    slips = 0;
+    steer(error);
+    // Twice the time constant at each gain, then on to the next narrower.
+    //  The wider loop won't have quite settled on the rate by then, but
+    //  steering doesn't touch the count itself, so the counts between the
+    //  first sentence and this one give it straight out, with the jitter
+    //  spread over all the seconds between; the narrower loop starts from
+    //  that.
+    if ((shift < TICKLOCK_TRACK_SHIFT) && (++settled >= (4U << shift)) &&
+      (epoch > firstEpoch))
+    {
+      setPeriod((((uint64_t)(stamp - firstStamp)) << 15) /
+        (epoch - firstEpoch));
+      shift++;
+      settled = 0;
+    }
+  }
+  // A sentence that's been left out says nothing about which tick is which.
+  if (slips == 0)
+  {
+    referenceEpoch = epoch;
+    referenceSecond = seconds;
+  }
+  CyExitCriticalSection(interrupts);
+}
+
+// For a slave: a master's time frame started at stamp, phaseMs into the
+//  master's second. Back at the top of that second, an RMC would have been
+//  TICKLOCK_GPS_LAG_MS behind it, so the loop takes it as one.
+void ticklockFrame(uint32_t epoch, uint32_t stamp, uint16_t phaseMs)
+{
+  ticklockReference(epoch, stamp - msToCounts(phaseMs) +
+    msToCounts(TICKLOCK_GPS_LAG_MS));
+}
+
+// For a master: how far into the second the ticks are, in ms, counting it
+//  as starting TICKLOCK_LEAD_MS after its tick. Only means anything locked.
+uint16_t ticklockPhaseMs(void)
+{
+  int32_t ms = (int32_t)((((uint64_t)(ticklockStamp(0) - secondStamp)) *
+    32768UL * 1000) / (uint32_t)period) - TICKLOCK_LEAD_MS;
+  return (ms < 0) ? 0 : ms;
+}
+
+// True once the loop has settled, and while sentences keep coming.
+bool ticklockLocked(void)
+{
+  return acquired && (shift >= TICKLOCK_LOCK_SHIFT) &&
+    (secondCount - referenceSecond <= TICKLOCK_HOLDOVER);
+}
+
+// For the task that handles the tick: true when locked and the tick just
+//  gone started a second, and if so which.
+bool ticklockSecond(uint32_t* epoch)
+{
+  if (!ticklockLocked() || !second)
+  {
+    return false;
+  }
+  *epoch = referenceEpoch + (secondCount - referenceSecond);
+  return true;
+}
@@ -0,0 +1,63 @@
+#ifndef __ticklock_h__
+#define __ticklock_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ClockTick is a 16-bit timer clocked at CLOCKTICK_HZ, off the IMO, with its
+//  interrupt on terminal count. It counts down from its period to 0, so a
+//  tick is period + 1 counts; CLOCKTICK_COUNTS of them make the half second
+//  the colons blink at. The clock must be fast enough to steer by, since the
+//  tick edges can only move in whole counts: 10kHz puts them within 100us.
+#define CLOCKTICK_HZ        10000
+#define CLOCKTICK_COUNTS    (CLOCKTICK_HZ / 2)
+
+// How long after the top of each second the GPS's first sentence (the RMC)
+//  starts coming in. It's fixed for a given module and baud rate; a scope on
+//  the module's PPS pin and its TX shows what it is.
+#ifndef TICKLOCK_GPS_LAG_MS
+  #define TICKLOCK_GPS_LAG_MS  50
+#endif
+
+// Each second's tick comes this long before the second itself, so that the
+//  seconds digit, which is the first string to go out, is on the LEDs right
+//  at the top of the second: about one string's time on the wire.
+#ifndef TICKLOCK_LEAD_MS
+  #define TICKLOCK_LEAD_MS  3
+#endif
+
+// The loop's gains, as shifts: each second it takes 1/2^shift of the phase
+//  error out at once and 1/2^(2 * shift + 3) of it into the tick period,
+//  which makes it critically damped with a time constant of about 2^(shift
+//  + 1) seconds. It starts wide, to pull in the IMO's error quickly, and
+//  narrows a step at a time, after twice the time constant at each, to ride
+//  out the jitter in when the sentences arrive. The display goes by the
+//  ticks from TICKLOCK_LOCK_SHIFT on.
+#define TICKLOCK_ACQUIRE_SHIFT  2
+#define TICKLOCK_LOCK_SHIFT     4
+#define TICKLOCK_TRACK_SHIFT    6
+
+// A sentence more than TICKLOCK_SLIP_MS from where it's expected is left
+//  out, as a one-off; TICKLOCK_SLIP_SECONDS of them in a row mean the ticks
+//  really are somewhere else, and they jump straight to where the GPS says.
+#define TICKLOCK_SLIP_MS       100
+#define TICKLOCK_SLIP_SECONDS  3
+
+// The period can be steered this far (1/2^shift) either side of nominal,
+//  which covers the IMO with room to spare.
+#define TICKLOCK_RANGE_SHIFT   5
+
+// Seconds the ticks keep counting the time themselves with no sentence, once
+//  locked, before the timebase takes over.
+#define TICKLOCK_HOLDOVER      2
+
+void ticklockStart(void);
+bool ticklockTick(void);
+uint32_t ticklockStamp(uint16_t bytesSince);
+void ticklockReference(uint32_t epoch, uint32_t stamp);
+void ticklockFrame(uint32_t epoch, uint32_t stamp, uint16_t phaseMs);
+uint16_t ticklockPhaseMs(void);
+bool ticklockLocked(void);
+bool ticklockSecond(uint32_t* epoch);
+
+#endif
@@ -0,0 +1,148 @@
+#include "timebase.h"
+#include "scheduler.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  Between GPS fixes (at boot, before the first one, or if the GPS loses
+*   its view of the sky) the clock keeps time by itself, off the scheduler's
+*   uptime. Each GPS time that arrives re-anchors us; with a fix, we also
+*   measure how many uptime counts really make 256 seconds, so the free-run
+*   stays honest. That measured rate is also what gets saved for next boot.
+******************************************************************************/
+
+// SysTick counts per 256 s.
+static uint32_t tickRate = TIMEBASE_NOMINAL_RATE;
+
+// The last time we were told the time, and when (in uptime) that was.
+static uint32_t anchorEpoch;
+static uint32_t anchorUptime;
+
+// Start of the current rate measurement.
+static uint32_t rateEpoch;
+static uint32_t rateUptime;
+static bool measuring;
+
+// True from a GPS time until TIMEBASE_HOLDOVER passes without another.
+static bool gpsAnchor;
+
+// Seconds since the anchor, by the local timebase.
+static uint32_t secondsSince(uint32_t uptime, uint32_t then)
+{
+  return ((uint64_t)(uptime - then) * 256) / tickRate;
+}
+
+// Warm start: an estimated time, and the rate saved last time around.
+void timebaseSet(uint32_t epoch, uint32_t rate)
+{
+  anchorEpoch = epoch;
+  anchorUptime = schedulerUptime();
+  if ((rate >= TIMEBASE_MIN_RATE) && (rate <= TIMEBASE_MAX_RATE))
+  {
+    tickRate = rate;
+  }
+  gpsAnchor = false;
+  measuring = false;
+}
+
+// A valid time just came in from the GPS.
+void timebaseSync(uint32_t epoch)
+{
+  timebaseSyncAt(epoch, schedulerUptime());
+}
+
+// As timebaseSync(), for a time that was true at some earlier uptime; a
+//  slave's frame has been on the wire a while by the time we have it.
+void timebaseSyncAt(uint32_t epoch, uint32_t uptime)
+{
+  // Sentences come in a fixed time after the top of each GPS second, so the
+  //  arrival times make a fine ruler. Measure over at least 256 s, and start
+  //  again if the GPS jumps backwards or drops out for a while.
+  if (!measuring || !gpsAnchor || (epoch < rateEpoch))
+  {
+    rateEpoch = epoch;
+    rateUptime = uptime;
+    measuring = true;
+  }
+  else if (epoch - rateEpoch >= 256)
+  {
+    uint32_t rate = ((uint64_t)(uptime - rateUptime) * 256) / 
+      (epoch - rateEpoch);
+    if ((rate >= TIMEBASE_MIN_RATE) && (rate <= TIMEBASE_MAX_RATE))
+    {
+      tickRate = rate;
+    }
+    rateEpoch = epoch;
+    rateUptime = uptime;
+  }
+
+  anchorEpoch = epoch;
+  anchorUptime = uptime;
+  gpsAnchor = true;
+}
+
+// Best guess at the time right now.
+uint32_t timebaseNow(void)
+{
+  uint32_t uptime = schedulerUptime();
+  uint32_t seconds = secondsSince(uptime, anchorUptime);
+
+  // Uptime wraps after about 12 hours, so on a long free-run move the anchor
+  //  along now and then to keep the difference well short of that.
+  if (seconds >= 3600)
+  {
+    anchorEpoch += seconds;
+    anchorUptime += ((uint64_t)seconds * tickRate) / 256;
+    seconds = 0;
+  }
+  if (gpsAnchor && (uptime - anchorUptime > TIMEBASE_HOLDOVER))
+  {
+    gpsAnchor = false;
+  }
+  return anchorEpoch + seconds;
+}
+
+// The time at a given uptime, to the microsecond, without disturbing the
+//  anchor. The uptime may be a little before the anchor, if one came in
+//  since it was taken.
+uint32_t timebaseAt(uint32_t uptime, uint32_t* micros)
+{
+  int64_t us = ((int64_t)(int32_t)(uptime - anchorUptime) * 256000000) /
+    tickRate;
+  int32_t seconds = us / 1000000;
+  int32_t rem = us % 1000000;
+
+  if (rem < 0)
+  {
+    rem += 1000000;
+    seconds--;
+  }
+  *micros = rem;
+  return anchorEpoch + seconds;
+}
+
+// How far into the current second we are, in ms, counting the second as
+//  starting at the anchor.
+uint16_t timebasePhaseMs(void)
+{
+  uint32_t elapsed = schedulerUptime() - anchorUptime;
+  return (((uint64_t)elapsed * 256000) / tickRate) % 1000;
+}
+
+// Turns a span of ms into uptime counts, at the measured rate.
+uint32_t timebaseMsToTicks(uint32_t ms)
+{
+  return ((uint64_t)ms * tickRate) / 256000;
+}
+
+uint32_t timebaseRate(void)
+{
+  return tickRate;
+}
+
+// True while the GPS is keeping us fed.
+bool timebaseSynced(void)
+{
+  return gpsAnchor && 
+    (schedulerUptime() - anchorUptime <= TIMEBASE_HOLDOVER);
+}
@@ -0,0 +1,31 @@
+#ifndef __timebase_h__
+#define __timebase_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scheduler.h"
+
+// The SysTick runs off the ILO, which is nowhere near accurate, so its rate is
+//  measured against the GPS: SysTick counts per 256 GPS seconds. This is the
+//  nominal value, used until there's a measurement.
+#define TIMEBASE_NOMINAL_RATE  (SCHED_TIMER_HZ * 256UL)
+
+// Rates more than 50% off nominal are garbage, and get thrown out.
+#define TIMEBASE_MIN_RATE      (TIMEBASE_NOMINAL_RATE / 2)
+#define TIMEBASE_MAX_RATE      (TIMEBASE_NOMINAL_RATE + (TIMEBASE_NOMINAL_RATE / 2))
+
+// How long after the last GPS time we keep trusting the GPS to bring the
+//  next one, before counting seconds ourselves. In SysTick counts.
+#define TIMEBASE_HOLDOVER      ((SCHED_TIMER_HZ * 3) / 2)
+
+void timebaseSet(uint32_t epoch, uint32_t rate);
+void timebaseSync(uint32_t epoch);
+void timebaseSyncAt(uint32_t epoch, uint32_t uptime);
+uint16_t timebasePhaseMs(void);
+uint32_t timebaseMsToTicks(uint32_t ms);
+uint32_t timebaseNow(void);
+uint32_t timebaseAt(uint32_t uptime, uint32_t* micros);
+uint32_t timebaseRate(void);
+bool timebaseSynced(void);
+
+#endif
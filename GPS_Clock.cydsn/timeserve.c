@@ -0,0 +1,65 @@
+#include "timeserve.h"
+#include "date_time.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************
+*  Answers time queries from the USB host. The receive time is taken by the
+*   caller, as soon after the packet is read as it can manage; the transmit
+*   time is taken here, when the answer is built, which is right before it's
+*   handed to the USB component. Everything between the two shows up in the
+*   answer, so the host can take it out of the round trip.
+*
+*  There's room for one query at a time; the client waits for each answer
+*   before sending the next, so a second one arriving early just replaces
+*   the first.
+******************************************************************************/
+
+static timeserveRecord answer;
+static bool pending;
+
+void timeserveQuery(const uint8_t origin[TIMESERVE_ORIGIN_SIZE],
+  uint32_t rxUptime, bool timeSet)
+{
+  answer.sync = TIMESERVE_SYNC;
+  answer.flags = timeSet ? TIMESERVE_SET : 0;
+  answer.zone = TIMEZONE;
+  answer.reserved = 0;
+  memcpy(&answer.originLo, origin, TIMESERVE_ORIGIN_SIZE);
+  answer.rxSeconds = timebaseAt(rxUptime, &answer.rxMicros);
+  pending = true;
+}
+
+bool timeservePending(void)
+{
+  return pending;
+}
+
+// Stamps and copies out the answer, if there is one. buffer needs room for
+//  TIMESERVE_RECORD_SIZE bytes. Returns how many bytes went in.
+uint16_t timeserveRead(uint8_t* buffer)
+{
+  uint8_t i;
+
+  if (!pending)
+  {
+    return 0;
+  }
+  if (timebaseSynced())
+  {
+    answer.flags |= TIMESERVE_SYNCED;
+  }
+  answer.txSeconds = timebaseAt(schedulerUptime(), &answer.txMicros);
+  memset(answer.pad, 0, sizeof(answer.pad));
+  answer.checksum = 0;
+  for (i = 0; i < TIMESERVE_RECORD_SIZE - 1; i++)
+  {
+    answer.checksum ^= ((const uint8_t*)&answer)[i];
+  }
+  memcpy(buffer, &answer, TIMESERVE_RECORD_SIZE);
+  pending = false;
+  return TIMESERVE_RECORD_SIZE;
+}
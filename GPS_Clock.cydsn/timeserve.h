@@ -0,0 +1,47 @@
+#ifndef __timeserve_h__
+#define __timeserve_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A PC on the USB link can use the clock as a time reference, NTP style. It
+//  sends TIMESERVE_QUERY_CMD followed by TIMESERVE_ORIGIN_SIZE bytes of its
+//  own (its send time, say), all in one write; the clock answers with one of
+//  these, giving back those bytes along with its own time when the query came
+//  in and when the answer went out. Host/timeserve_client.c is the other end,
+//  and includes this header, so keep the two in step.
+//
+// Times are seconds since 2000 in the clock's local standard time (take
+//  zone hours off for UTC) plus microseconds. The clock's second starts when
+//  the RMC sentence for it finishes arriving, which is some way behind the
+//  GPS's own; the client has a bias option to take that out.
+typedef struct
+{
+  uint8_t  sync;          // Always TIMESERVE_SYNC
+  uint8_t  flags;         // TIMESERVE_SET, TIMESERVE_SYNCED
+  int8_t   zone;          // TIMEZONE, in hours
+  uint8_t  reserved;
+  uint32_t originLo;      // The query's bytes, handed straight back
+  uint32_t originHi;
+  uint32_t rxSeconds;     // When the query came in
+  uint32_t rxMicros;
+  uint32_t txSeconds;     // When this went out
+  uint32_t txMicros;
+  uint8_t  pad[3];
+  uint8_t  checksum;      // XOR of all the bytes before it
+} timeserveRecord;
+
+#define TIMESERVE_SYNC         0x3C
+#define TIMESERVE_RECORD_SIZE  32
+#define TIMESERVE_QUERY_CMD    'T'
+#define TIMESERVE_ORIGIN_SIZE  8
+
+#define TIMESERVE_SET     0x01  // There's a time at all, GPS or saved
+#define TIMESERVE_SYNCED  0x02  // A GPS time came in within the holdover
+
+void timeserveQuery(const uint8_t origin[TIMESERVE_ORIGIN_SIZE],
+  uint32_t rxUptime, bool timeSet);
+bool timeservePending(void);
+uint16_t timeserveRead(uint8_t* buffer);
+
+#endif
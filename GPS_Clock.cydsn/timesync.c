@@ -0,0 +1,73 @@
+#include "timesync.h"
+#include "persist.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  The master/slave time frame, both ends of it. Building and parsing the
+*   frame lives here; when to send one and what to do with one that arrives
+*   is up to main.c. The frame uses the same CRC as the EEPROM records.
+******************************************************************************/
+
+// Bytes of a frame the receiver has collected so far.
+static uint8_t rxFrame[TIMESYNC_FRAME_SIZE];
+static uint8_t rxCount;
+
+// Lays a frame out for sending; returns how many bytes that came to.
+uint8_t timesyncEncode(const timesyncFrame* frame,
+  uint8_t buffer[TIMESYNC_FRAME_SIZE])
+{
+  uint16_t crc;
+
+  buffer[0] = TIMESYNC_SYNC0;
+  buffer[1] = TIMESYNC_SYNC1;
+  buffer[2] = (uint8_t)(frame->epoch);
+  buffer[3] = (uint8_t)(frame->epoch >> 8);
+  buffer[4] = (uint8_t)(frame->epoch >> 16);
+  buffer[5] = (uint8_t)(frame->epoch >> 24);
+  buffer[6] = (uint8_t)(frame->phaseMs);
+  buffer[7] = (uint8_t)(frame->phaseMs >> 8);
+  buffer[8] = (uint8_t)(frame->zone);
+  buffer[9] = frame->flags;
+  crc = persistCRC(&buffer[2], 8);
+  buffer[10] = (uint8_t)(crc);
+  buffer[11] = (uint8_t)(crc >> 8);
+  return TIMESYNC_FRAME_SIZE;
+}
+
+// Feed received bytes in one at a time. Returns true, with frame filled in,
+//  on the last byte of a good frame. Anything else (noise, a frame we joined
+//  halfway through, a bad CRC) is dropped and we hunt for the next sync.
+bool timesyncReceive(uint8_t byte, timesyncFrame* frame)
+{
+  if (((rxCount == 0) && (byte != TIMESYNC_SYNC0)) ||
+    ((rxCount == 1) && (byte != TIMESYNC_SYNC1)))
+  {
+    // A stray 0xAA followed by the real sync still has to work.
+    rxCount = (byte == TIMESYNC_SYNC0) ? 1 : 0;
+    if (rxCount == 1)
+    {
+      rxFrame[0] = byte;
+    }
+    return false;
+  }
+
+  rxFrame[rxCount++] = byte;
+  if (rxCount < TIMESYNC_FRAME_SIZE)
+  {
+    return false;
+  }
+  rxCount = 0;
+
+  if (persistCRC(&rxFrame[2], 8) !=
+    (uint16_t)(rxFrame[10] | (rxFrame[11] << 8)))
+  {
+    return false;
+  }
+  frame->epoch = (uint32_t)rxFrame[2] | ((uint32_t)rxFrame[3] << 8) |
+    ((uint32_t)rxFrame[4] << 16) | ((uint32_t)rxFrame[5] << 24);
+  frame->phaseMs = rxFrame[6] | (rxFrame[7] << 8);
+  frame->zone = (int8_t)rxFrame[8];
+  frame->flags = rxFrame[9];
+  return true;
+}
@@ -0,0 +1,53 @@
+#ifndef __timesync_h__
+#define __timesync_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// One GPS clock can keep a whole building's worth of clocks in time. The
+//  master sends a short time frame out of its UART's TX pin (TX_Echo) once a
+//  second; each slave has that line, instead of a GPS, on its UART RX pin.
+//  Pick one of these for TIMESYNC_MODE.
+#define TIMESYNC_OFF     0  // Stand-alone: GPS in, nothing out
+#define TIMESYNC_MASTER  1  // GPS in, time frames out
+#define TIMESYNC_SLAVE   2  // Time frames in, no NMEA at all
+
+#ifndef TIMESYNC_MODE
+#define TIMESYNC_MODE    TIMESYNC_OFF
+#endif
+
+// The UART runs at the GPS's baud rate; keep this in step with the UART
+//  component, since a slave needs it to know how long a frame took to arrive.
+#define TIMESYNC_BAUD    9600
+
+// On the wire, little-endian:
+//   0xAA 0x55           sync
+//   epoch (4)           Seconds since 2000, the master's local standard time
+//   phase (2)           ms between the master's top of second and sending
+//   zone (1)            The master's TIMEZONE, in hours
+//   flags (1)           TIMESYNC_VALID, TIMESYNC_DST
+//   crc (2)             CRC-16/CCITT of epoch through flags
+#define TIMESYNC_SYNC0       0xAA
+#define TIMESYNC_SYNC1       0x55
+#define TIMESYNC_FRAME_SIZE  12
+
+#define TIMESYNC_VALID   0x01  // The master has a GPS fix right now
+#define TIMESYNC_DST     0x02  // The master has DST in effect
+
+typedef struct
+{
+  uint32_t epoch;
+  uint16_t phaseMs;
+  int8_t   zone;
+  uint8_t  flags;
+} timesyncFrame;
+
+// How long a whole frame takes on the wire (10 bits a byte), in ms.
+#define TIMESYNC_FRAME_MS \
+  (((TIMESYNC_FRAME_SIZE * 10 * 1000) + TIMESYNC_BAUD - 1) / TIMESYNC_BAUD)
+
+uint8_t timesyncEncode(const timesyncFrame* frame,
+  uint8_t buffer[TIMESYNC_FRAME_SIZE]);
+bool timesyncReceive(uint8_t byte, timesyncFrame* frame);
+
+#endif
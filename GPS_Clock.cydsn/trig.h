@@ -0,0 +1,17 @@
+#ifndef __trig_h__
+#define __trig_h__
+
+#include <stdint.h>
+
+// Angles are binary: TRIG_TURN to a full circle, so they wrap for free in a
+//  uint16_t. Sines and cosines are Q15, -32767 to 32767.
+#define TRIG_TURN     65536L
+#define TRIG_QUARTER  16384
+#define TRIG_HALF     32768
+#define TRIG_ONE      32768L
+
+int16_t trigSin(uint16_t angle);
+int16_t trigCos(uint16_t angle);
+uint16_t trigAcos(int32_t x);
+
+#endif
@@ -0,0 +1,87 @@
+#include "usb_cdc.h"
+#include "project.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+*  The USB link is optional: the clock mostly runs with no PC attached. So
+*   rather than wait around at boot for a host that may never come, the USB
+*   component is started and then left to enumerate in the background while
+*   the display and GPS get on with things. usbPoll() runs on every pass of
+*   the scheduler and notices when the host has configured us, has
+*   re-enumerated us (a replug, or a host reboot), or has gone away.
+*
+*  There's no VBUS sense pin, so an unplug is spotted by the bus going quiet:
+*   a host sends a start-of-frame every millisecond, so a whole ClockTick
+*   without any activity means nobody's there.
+******************************************************************************/
+
+static usbState state;
+
+void usbStart(void)
+{
+  USBUART_Start(0, USBUART_3V_OPERATION);
+  state = USB_ENUMERATING;
+}
+
+// Cheap enough to call every scheduler pass; USB events arrive by interrupt,
+//  and any interrupt gets us another pass.
+void usbPoll(void)
+{
+  // A bus reset and re-enumeration shows up as a configuration change; the
+  //  CDC endpoints have to be set up again each time.
+  if (USBUART_IsConfigurationChanged())
+  {
+    if (USBUART_GetConfiguration() != 0)
+    {
+      USBUART_CDC_Init();
+      state = USB_CONFIGURED;
+    }
+    else
+    {
+      state = USB_ENUMERATING;
+    }
+  }
+}
+
+// Call once per ClockTick.
+void usbTick(void)
+{
+  bool active = (USBUART_CheckActivity() != 0);
+  if ((state == USB_CONFIGURED) && !active)
+  {
+    state = USB_SUSPENDED;
+  }
+  else if ((state == USB_SUSPENDED) && active)
+  {
+    state = USB_CONFIGURED;
+  }
+}
+
+// True when there's a host listening and room to send it something.
+bool usbReady(void)
+{
+  return (state == USB_CONFIGURED) && (USBUART_CDCIsReady() != 0);
+}
+
+// True when the host has sent us something.
+bool usbDataWaiting(void)
+{
+  return (state == USB_CONFIGURED) && (USBUART_DataIsReady() != 0);
+}
+
+// Takes whatever the host has sent, up to USB_PACKET_SIZE bytes, without
+//  waiting. Returns how many bytes that was.
+uint16_t usbRead(uint8_t* buffer)
+{
+  if (!usbDataWaiting())
+  {
+    return 0;
+  }
+  return USBUART_GetAll(buffer);
+}
+
+usbState usbGetState(void)
+{
+  return state;
+}
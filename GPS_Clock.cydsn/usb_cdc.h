@@ -0,0 +1,27 @@
+#ifndef __usb_cdc_h__
+#define __usb_cdc_h__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Where the USB link is up to. Nothing blocks on any of these; usbPoll()
+//  moves between them as the host comes and goes.
+typedef enum
+{
+  USB_ENUMERATING,  // Started, waiting on a host to configure us
+  USB_CONFIGURED,   // CDC up, and the host is talking to us
+  USB_SUSPENDED     // Configured, but the bus has gone quiet (unplugged?)
+} usbState;
+
+// usbRead() may hand back up to a full packet.
+#define USB_PACKET_SIZE 64
+
+void usbStart(void);
+void usbPoll(void);
+void usbTick(void);
+bool usbReady(void);
+bool usbDataWaiting(void);
+uint16_t usbRead(uint8_t* buffer);
+usbState usbGetState(void);
+
+#endif
@@ -1,5 +1,11 @@
 #include "ws281x_7seg.h"
+#include "brightness.h"
+#include "effects.h"
+#include "framestream.h"
+#include "power.h"
 #include "project.h"
+#include "profile.h"
+#include "scheduler.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -27,8 +33,9 @@
 *   values, and then we scan through as appropriate in main.
 ******************************************************************************/
 
-void writeDigit(bool digitSegs[7], uint8_t digit)
+void writeDigit(bool digitSegs[SEGMENTS_PER_DIGIT], uint8_t digit)
 {
+  PROFILE_START(PROF_WRITE_DIGIT);
   switch(digit)
   {
     case 0:
@@ -122,43 +129,486 @@ void writeDigit(bool digitSegs[7], uint8_t digit)
       digitSegs[G] = true;
       break;
   }
+  PROFILE_STOP(PROF_WRITE_DIGIT);
 }
 
-// NB: This function assumes a 6-digit display, with 12 lights per segment
-//  for a total of 84 lights per digit. If you try to use some other dimension
-//  you'll bork the code. Sorry.
-void updateDisplay(bool** LEDValues, uint32_t** segmentValues)
+// Sets all six digits for a local standard time. dst puts the hour on by one;
+//  in 12-hour time the hours run 12, 1 ... 11, with no AM/PM.
+void writeTime(bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT],
+  const date_time* localTime, bool dst, bool twentyFourHour)
 {
-  uint8_t digitIndex;
-  // For each digit...
-  for (digitIndex = 0; digitIndex < 6; digitIndex++)
+  int8_t displayHours = localTime->hrs;
+  if (dst)
   {
-    // ...we must index across the segments...
-    uint8_t segmentIndex;
-    for (segmentIndex = 0; segmentIndex < 8; segmentIndex++)
+    if(++displayHours > 23)
     {
-      //...and, if that segment is to be enabled, send the value to it.
-      if (segmentValues[digitIndex][segmentIndex])
+      displayHours = 0;
+    }
+  }
+
+  if (!twentyFourHour)
+  {
+    if (displayHours > 12)
+    {
+      displayHours -= 12;
+    }
+    else if (displayHours == 0)
+    {
+      displayHours = 12;
+    }
+  }
+  if (displayHours < 10)
+  {
+    writeDigit(segmentValues[5], 0);
+    writeDigit(segmentValues[4], displayHours);
+  }
+  else
+  {
+    writeDigit(segmentValues[5], 1);
+    writeDigit(segmentValues[4], displayHours - 10);
+  }
+
+  writeDigit(segmentValues[3], localTime->tmin);
+  writeDigit(segmentValues[2], localTime->min);
+  writeDigit(segmentValues[1], localTime->tsecs);
+  writeDigit(segmentValues[0], localTime->secs);
+}
+
+// The digits and the colons all share the one StripLights row buffer; the
+//  mux picks which string it goes out to. So strings go out one at a time,
+//  each one rendered into the buffer only once the previous transfer, latch
+//  gap included, has finished. queueDisplay() marks strings as needing an
+//  update, and serviceDisplay() is called on every EVENT_DISPLAY to move
+//  things along without ever waiting on the hardware.
+
+// In RGB display memory the colon pixels carry their own color; in LUT display
+//  memory they point at the colon palette entries and blinking recolors those.
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  #define COLON_COLOR StripLights_CLUT[StripLights_WHITE]
+#else
+  #define COLON_COLOR StripLights_WHITE
+#endif
+
+#if ((DITHER_SHADES != 1) && (DITHER_SHADES != 2) && (DITHER_SHADES != 4) && \
+  (DITHER_SHADES != 8))
+  #error "DITHER_SHADES must be 1, 2, 4 or 8"
+#endif
+#if ((StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) && \
+  (2 * DITHER_SHADES > StripLights_USER_COLORS))
+  #error "Not enough StripLights user colors for the dither shades"
+#endif
+
+// The order LEDs take the shades in, for 8 shades: each next one is as far
+//  from those before as it can be, so bright and dim LEDs are well mixed at
+//  any phase. Every (8 / DITHER_SHADES)th entry gives the order for fewer.
+static const uint8_t shadeOrder[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+// How far each string has got round the shades. Every refresh of a string
+//  moves it on one, so over its refreshes each LED takes every shade in turn
+//  and none stays the bright one; only strings that have changed are sent
+//  (queueChangedDigits()), so that costs no transfers of its own.
+static uint8_t ditherPhase[COLON_STRING + 1];
+
+// Each digit's lit segments when it last went out, a bit each.
+static uint8_t sentSegments[NUM_DIGITS];
+
+// The color setDigitColor() was last given, for when the power limit moves.
+static uint32_t digitBaseColor;
+
+// One bit per string waiting to go out; bit 6 is the colons.
+static uint8_t queuedStrings;
+
+// Each digit's share of EFFECT_BUDGET_CYCLES, and how many have gone over.
+#define EFFECT_DIGIT_CYCLES (EFFECT_BUDGET_CYCLES / NUM_DIGITS)
+static uint32_t effectOverruns;
+
+// While the display is blanked, each string goes out black once, and then
+//  nothing more is sent to it until the display comes back.
+static bool blanked;
+static uint8_t blankedStrings;
+
+// The shade of the LED this far along a string.
+static uint8_t ditherShade(uint8_t led, uint8_t phase)
+{
+  return shadeOrder[((led + phase) % DITHER_SHADES) * (8 / DITHER_SHADES)];
+}
+
+// A digit's lit segments, a bit each.
+static uint8_t segmentBits(const bool digitSegs[SEGMENTS_PER_DIGIT])
+{
+  uint8_t segments = 0;
+  uint8_t segmentIndex;
+
+  for (segmentIndex = 0; segmentIndex < SEGMENTS_PER_DIGIT; segmentIndex++)
+  {
+    segments |= (digitSegs[segmentIndex] ? 1 : 0) << segmentIndex;
+  }
+  return segments;
+}
+
+// Thresholds spaced evenly, each in the middle of its 1/DITHER_SHADES share,
+//  so one shade is just brightnessApply().
+static uint8_t shadeThreshold(uint8_t shade)
+{
+  return (uint8_t)(((2 * shade + 1) * 128) / DITHER_SHADES);
+}
+
+// True from Trigger until StripLights_Ready() says the string is latched.
+static bool transferActive;
+
+// A string takes a few ms at most, latch gap and all. One that's taken this
+//  long never will finish, as when its interrupt was lost; it's given up on,
+//  or the display would wait on it forever.
+#define TRANSFER_TIMEOUT (SCHED_TIMER_HZ / 20)
+static uint32_t transferStart;
+static uint32_t transferTimeouts;
+
+// The palette is read as a string goes out, so a change partway through one
+//  would reach only its later LEDs, and not the power estimate at all; a
+//  setDigitColor() then waits for serviceDisplay() to see the string done.
+//  With a moving effect (effects.c) there's nearly always one going out.
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+static bool paletteWaiting;
+
+static void writeDigitPalette(void)
+{
+  uint8_t shade;
+  for (shade = 0; shade < DITHER_SHADES; shade++)
+  {
+    StripLights_SetPalette(DIGIT_PALETTE_INDEX + shade,
+      brightnessDither(digitBaseColor, shadeThreshold(shade)));
+  }
+  effectsRefresh();
+}
+#endif
+
+// In LUT display memory, puts a color at the current brightness into the
+//  digits' palette entries, one per shade, and redoes the effect's entries
+//  to match. Call it again after every brightnessSet().
+void setDigitColor(uint32_t color)
+{
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  digitBaseColor = color;
+  if (transferActive)
+  {
+    paletteWaiting = true;
+    return;
+  }
+  writeDigitPalette();
+#else
+  (void)color;
+#endif
+}
+
+// Returns whether anything is now waiting to go out; once the display is
+//  blanked, nothing will be.
+bool queueDisplay(uint8_t stringMask)
+{
+  queuedStrings |= stringMask & ~blankedStrings;
+  return queuedStrings != 0;
+}
+
+// Queues just the digits whose segments differ from what they last went out
+//  with, so a new time only sends the digits that moved: the seconds, most
+//  seconds. Returns as queueDisplay() does.
+bool queueChangedDigits(bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT])
+{
+  uint8_t changed = 0;
+  uint8_t digit;
+
+  for (digit = 0; digit < NUM_DIGITS; digit++)
+  {
+    if (segmentBits(segmentValues[digit]) != sentSegments[digit])
+    {
+      changed |= 1 << digit;
+    }
+  }
+  return queueDisplay(changed);
+}
+
+// Turns the whole display off, or back on again.
+void blankDisplay(bool blank)
+{
+  if (blank != blanked)
+  {
+    blanked = blank;
+    blankedStrings = 0;
+    queuedStrings |= DIGIT_STRINGS | COLON_STRINGS;
+  }
+}
+
+// Polled from the scheduler; true once, when the transfer in flight is done
+//  or has timed out.
+bool displayTransferDone(void)
+{
+  if (!transferActive)
+  {
+    return false;
+  }
+  if (StripLights_Ready())
+  {
+    transferActive = false;
+    return true;
+  }
+  if (schedulerUptime() - transferStart >= TRANSFER_TIMEOUT)
+  {
+    StripLights_Stop();
+    transferTimeouts++;
+    transferActive = false;
+    return true;
+  }
+  return false;
+}
+
+// One string has to hold a whole digit; the colons are shorter.
+#if (StripLights_COLUMNS < LEDS_PER_DIGIT)
+  #error "StripLights LEDs per strip is too short for a digit"
+#endif
+
+// A lit segment in a moving effect (effects.c): each LED's own color, put
+//  through the brightness with its dither shade in RGB display memory, or
+//  its band's palette entry in LUT. A digit that's run over its share of
+//  the budget gets the color from the middle of the segment, in one fill.
+static void renderEffect(uint8_t digit, uint8_t segment, uint8_t phase,
+  bool rushed)
+{
+  uint8_t first = segment * LEDS_PER_SEGMENT;
+  uint32_t color;
+  uint8_t led;
+
+  if (rushed)
+  {
+    color = effectsPixel(digit, segment, LEDS_PER_SEGMENT / 2);
+#if (StripLights_MEMORY_TYPE != StripLights_MEMORY_LUT)
+    color = brightnessApply(color);
+#endif
+    StripLights_FillRow(first, first + LEDS_PER_SEGMENT - 1, 0, color);
+    return;
+  }
+  for (led = 0; led < LEDS_PER_SEGMENT; led++)
+  {
+    color = effectsPixel(digit, segment, led);
+#if (StripLights_MEMORY_TYPE != StripLights_MEMORY_LUT)
+    color = brightnessDither(color, shadeThreshold(ditherShade(led, phase)));
+#endif
+    StripLights_Pixel(first + led, 0, color);
+  }
+  (void)phase;
+}
+
+// A digit is all one color, so an unlit segment is a single span fill of
+//  black, and a lit one is its LEDs in the digit's shades (one span fill too
+//  when there's only the one shade). In RGB display memory the shades are
+//  worked out here; in LUT display memory they're already in the palette,
+//  and digitColor is the first of them. In a moving effect the lit segments
+//  come from effects.c instead.
+static void renderDigit(uint8_t digit, uint32_t digitColor,
+  bool digitSegs[SEGMENTS_PER_DIGIT], uint8_t phase)
+{
+  bool effect = (effectsCurrent() != EFFECT_SOLID);
+  uint32_t start = effect ? cycleCount() : 0;
+  bool rushed = false;
+  uint32_t shades[DITHER_SHADES];
+  uint8_t segmentIndex;
+  uint8_t shade;
+  uint8_t led;
+
+  for (shade = 0; shade < DITHER_SHADES; shade++)
+  {
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    shades[shade] = digitColor + shade;
+#else
+    shades[shade] = brightnessDither(digitColor, shadeThreshold(shade));
+#endif
+  }
+  for (segmentIndex = 0; segmentIndex < SEGMENTS_PER_DIGIT; segmentIndex++)
+  {
+    uint8_t first = segmentIndex * LEDS_PER_SEGMENT;
+    if (effect && digitSegs[segmentIndex])
+    {
+      if (!rushed && ((cycleCount() - start) > EFFECT_DIGIT_CYCLES))
       {
-        uint8_t pixelIndex;
-        for (pixelIndex = 0; pixelIndex < 12; pixelIndex++)
-        {
-          StripLights_Pixel((segmentIndex * 12)+pixelIndex, 0, 
-            LEDValues[digitIndex][(segmentIndex*12 + pixelIndex)]);
-        }
+        rushed = true;
+        effectOverruns++;
       }
-      else
+      renderEffect(digit, segmentIndex, phase, rushed);
+    }
+    else if (!digitSegs[segmentIndex] || (DITHER_SHADES == 1))
+    {
+      StripLights_FillRow(first, first + LEDS_PER_SEGMENT - 1, 0, 
+        digitSegs[segmentIndex] ? shades[0] : StripLights_BLACK);
+    }
+    else
+    {
+      for (led = 0; led < LEDS_PER_SEGMENT; led++)
       {
-        uint8_t pixelIndex;
-        for (pixelIndex = 0; pixelIndex < 12; pixelIndex++)
-        {
-          StripLights_Pixel((segmentIndex * 12)+pixelIndex, 0, 
-            StripLights_BLACK);
-        }
+        StripLights_Pixel(first + led, 0, shades[ditherShade(led, phase)]);
       }
     }
-    StripChannelSelect_Write(digitIndex);
-    StripLights_Trigger(1); 
-    CyDelay(10);
   }
 }
+
+// Channel 6 is the two colon strings, in parallel. They are each tied to a
+//  separate pin, however, so the pin drivers don't get overloaded. The row
+//  past the colon LEDs is left black, so its drive is just the colons'.
+static void renderColon(bool colonOn, uint8_t phase)
+{
+  uint32_t shades[DITHER_SHADES];
+  uint8_t shade;
+  uint8_t led;
+
+  for (shade = 0; shade < DITHER_SHADES; shade++)
+  {
+    uint32_t color = colonOn ? 
+      brightnessDither(COLON_COLOR, shadeThreshold(shade)) : 0;
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    StripLights_SetPalette(COLON_PALETTE_INDEX + shade, color);
+    shades[shade] = COLON_PALETTE_INDEX + shade;
+#else
+    shades[shade] = color;
+#endif
+  }
+  for (led = 0; led < COLON_LEDS; led++)
+  {
+    StripLights_Pixel(led, 0, shades[ditherShade(led, phase)]);
+  }
+  StripLights_FillRow(COLON_LEDS, StripLights_COLUMNS - 1, 0,
+    StripLights_BLACK);
+}
+
+static void renderString(uint8_t stringIndex,
+  const uint32_t digitColors[NUM_DIGITS],
+  bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT], bool colonOn)
+{
+  if (blanked)
+  {
+    StripLights_FillRow(0, StripLights_COLUMNS - 1, 0, StripLights_BLACK);
+  }
+  else if (stringIndex == COLON_STRING)
+  {
+    renderColon(colonOn, ditherPhase[stringIndex]);
+  }
+  else
+  {
+    renderDigit(stringIndex, digitColors[stringIndex],
+      segmentValues[stringIndex], ditherPhase[stringIndex]);
+  }
+}
+
+// Sends the next queued string, if the last one is done, and if the LEDs can
+//  afford it; one that can't waits for the others to go out dimmer first
+//  (see power.c), and if none can, one goes out dimmed to fit in the
+//  meantime. Returns true while there's still a transfer in flight.
+bool serviceDisplay(const uint32_t digitColors[NUM_DIGITS],
+  bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT], bool colonOn)
+{
+  uint8_t stringIndex;
+  uint8_t sendIndex = 0;
+  uint32_t drive = 0;
+  uint8_t dim = POWER_DIM_BLACK;
+  uint8_t step;
+
+  if (transferActive)
+  {
+    return true;
+  }
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  if (paletteWaiting)
+  {
+    paletteWaiting = false;
+    writeDigitPalette();
+  }
+#endif
+  if (queuedStrings == 0)
+  {
+    return false;
+  }
+
+  // Twice round, so when the limit comes down late in the first pass, the
+  //  strings before it get a look in at the new limit.
+  PROFILE_START(PROF_RENDER_STRING);
+  for (step = 0; step < 2 * (COLON_STRING + 1); step++)
+  {
+    stringIndex = step % (COLON_STRING + 1);
+    if (!(queuedStrings & (1 << stringIndex)))
+    {
+      continue;
+    }
+    // Without StripLights_TRACK_DRIVE, RowDrive() adds the row up, so it's
+    //  asked once a render.
+    renderString(stringIndex, digitColors, segmentValues, colonOn);
+    drive = StripLights_RowDrive(0);
+    if (powerCheck(stringIndex, drive,
+      (queuedStrings & ~(1 << stringIndex)) == 0))
+    {
+      // The power limit moved, and the colors with it: draw this string
+      //  again, and send the rest again to match.
+      setDigitColor(digitBaseColor);
+      renderString(stringIndex, digitColors, segmentValues, colonOn);
+      drive = StripLights_RowDrive(0);
+      queuedStrings |= (DIGIT_STRINGS | COLON_STRINGS) & ~blankedStrings &
+        ~(1 << stringIndex);
+    }
+    sendIndex = stringIndex;
+    if (powerFits(stringIndex, drive))
+    {
+      dim = 0;
+      break;
+    }
+  }
+  stringIndex = sendIndex;
+  if (dim == 0)
+  {
+    queuedStrings &= ~(1 << stringIndex);
+    if (blanked)
+    {
+      blankedStrings |= 1 << stringIndex;
+    }
+    else if (stringIndex < NUM_DIGITS)
+    {
+      sentSegments[stringIndex] = segmentBits(segmentValues[stringIndex]);
+    }
+    ditherPhase[stringIndex] = (ditherPhase[stringIndex] + 1) % DITHER_SHADES;
+  }
+  else
+  {
+    // Nothing fits next to what's showing: the others are still brighter
+    //  than the limit now allows, or the budget has come down under them.
+    //  The queued string showing brightest goes out shifted down just enough
+    //  to fit, or black, which makes room for the rest, and stays queued to
+    //  go again in full.
+    stringIndex = powerBrightest(queuedStrings);
+    if (stringIndex != sendIndex)
+    {
+      renderString(stringIndex, digitColors, segmentValues, colonOn);
+      drive = StripLights_RowDrive(0);
+    }
+    dim = powerDimToFit(stringIndex, drive);
+    if (dim > POWER_DIM_MAX)
+    {
+      StripLights_FillRow(0, StripLights_COLUMNS - 1, 0, StripLights_BLACK);
+    }
+  }
+  powerSent(stringIndex, drive, dim);
+  StripLights_Dim((dim > POWER_DIM_MAX) ? 0 : dim);
+  StripChannelSelect_Write(stringIndex);
+  StripLights_Trigger(1);
+  framestreamCapture(stringIndex);
+  PROFILE_STOP(PROF_RENDER_STRING);
+  transferStart = schedulerUptime();
+  transferActive = true;
+  return true;
+}
+
+// Strings given up on since startup, for want of transfer complete.
+uint32_t displayTransferTimeouts(void)
+{
+  return transferTimeouts;
+}
+
+// Digits that have run over their share of EFFECT_BUDGET_CYCLES since
+//  startup.
+uint32_t displayEffectOverruns(void)
+{
+  return effectOverruns;
+}
@@ -3,13 +3,55 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "date_time.h"
 
 // Each digit is made up of seven segments, and each segment is a string of 12
 //  WS2812 LEDs. This enum gives the order in which those strings appear. The
 //  segment names are "standard" across most seven segment LED types.
 enum SEGMENT_NAME {D, C, B, A, F, G, E};
 
-void writeDigit(bool digitSegs[7], uint8_t digit);
-void updateDisplay(bool** LEDValues, uint32_t** segmentValues);
+// At night the brightness sits where one byte more or less of drive is a
+//  visible jump, so a lit segment is drawn in DITHER_SHADES shades of its
+//  color, some a touch brighter than the level and some a touch dimmer,
+//  which average out to the level itself (see brightnessDither()). The LEDs
+//  along a segment take the shades in turn, and move on one shade each time
+//  their string is sent, so no LED is always the bright one. 1 turns it off;
+//  otherwise a power of two, up to 8.
+#ifndef DITHER_SHADES
+  #define DITHER_SHADES 4
+#endif
+
+// When the StripLights component is set to LUT display memory, the digits and
+//  colons are drawn with these palette entries (user colors, past the end of
+//  the CLUT), DITHER_SHADES of each. Changing the color of the whole display
+//  is then a few palette writes instead of a rewrite of every pixel.
+#define DIGIT_PALETTE_INDEX StripLights_CLUT_SIZE
+#define COLON_PALETTE_INDEX (StripLights_CLUT_SIZE + DITHER_SHADES)
+
+// Display geometry. Every buffer in the clock is sized from these.
+#define NUM_DIGITS          6
+#define SEGMENTS_PER_DIGIT  7
+#define LEDS_PER_SEGMENT    12
+#define LEDS_PER_DIGIT      (SEGMENTS_PER_DIGIT * LEDS_PER_SEGMENT)
+
+// Mux channels 0-5 are the digits, least significant first; channel 6 drives
+//  both colon strings at once. Each colon string is COLON_LEDS long.
+#define COLON_STRING  6
+#define COLON_LEDS    8
+#define DIGIT_STRINGS ((1 << NUM_DIGITS) - 1)
+#define COLON_STRINGS (1 << COLON_STRING)
+
+void writeDigit(bool digitSegs[SEGMENTS_PER_DIGIT], uint8_t digit);
+void writeTime(bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT],
+  const date_time* localTime, bool dst, bool twentyFourHour);
+void setDigitColor(uint32_t color);
+bool queueDisplay(uint8_t stringMask);
+bool queueChangedDigits(bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT]);
+void blankDisplay(bool blank);
+bool displayTransferDone(void);
+bool serviceDisplay(const uint32_t digitColors[NUM_DIGITS],
+  bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT], bool colonOn);
+uint32_t displayTransferTimeouts(void);
+uint32_t displayEffectOverruns(void);
 
 #endif
@@ -0,0 +1,706 @@
+/******************************************************************************
+*  frame_view - watches what the clock's LEDs are showing, over USB, and
+*   records it for later.
+*
+*  Build:  gcc -O2 -Wall -o frame_view frame_view.c
+*  Usage:  frame_view [-q] [-w capture] [-p prefix] [-i seconds] [-f]
+*            <tty or capture file>
+*    -q           Don't draw the display, just sum up at the end
+*    -w capture   Save everything that comes in, to play back later
+*    -p prefix    Write the display to prefixNNNNNN.ppm whenever it changes,
+*                  laid out as the simulator's are
+*    -i seconds   At most one picture per this many seconds of the clock's
+*                  time
+*    -f           Play a capture back as fast as it'll go, not at the pace
+*                  the clock showed it
+*
+*  From a tty it asks the clock for the display stream (framestream.h), and
+*   draws the digits on the terminal as they change, with each string's
+*   latch rate; Ctrl-C stops the stream and sums up. A capture is the bytes
+*   off the tty as they were, so it plays back the same way, paced by the
+*   clock's own timestamps.
+*
+*  The record layout comes straight from the firmware's framestream.h.
+*   Telemetry comes in between records, so we hunt for the sync byte and
+*   only take a record whose checksum matches and whose segments add up to
+*   its length. A gap in the sequence means changes were missed, so the
+*   picture can't be trusted; live, we ask the clock to start again.
+*
+*  Between records the clock only sends what changed, and a host that falls
+*   behind is sent the latest of each string rather than every one that
+*   went out. So the picture is always what the LEDs showed, but the rates
+*   come from the latch counts, not from counting records.
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "../GPS_Clock.cydsn/framestream.h"
+
+_Static_assert(sizeof(framestreamHeader) == FRAMESTREAM_HEADER_SIZE,
+  "framestreamHeader has picked up padding");
+
+#define STRINGS  (COLON_STRING + 1)
+
+// The terminal is redrawn at most this often, whatever the clock sends.
+#define DRAW_INTERVAL_NS  40000000LL
+
+// How soon to ask again, live, if a restart doesn't seem to have taken.
+#define RESTART_INTERVAL_NS  1000000000LL
+
+// Pictures: pixels per LED, and the LED positions in each digit.
+#define PPM_SCALE  4
+#define DIGIT_W    (LEDS_PER_SEGMENT + 2)
+#define DIGIT_H    ((2 * LEDS_PER_SEGMENT) + 3)
+#define COLON_W    2
+#define GAP_W      2
+
+// The display as the records have built it up, red, green, blue.
+static uint8_t leds[STRINGS][LEDS_PER_DIGIT][3];
+
+// Each string's latch count and time, as of its first and latest records,
+//  with the wraps taken out.
+typedef struct
+{
+  bool seen;
+  uint16_t lastLatches;
+  uint64_t latches;
+  uint64_t firstLatches;
+  int64_t firstAt;
+  int64_t lastAt;
+  uint32_t records;
+} stringStats;
+
+static stringStats stats[STRINGS];
+
+// The clock's uptime, in SCHED_TIMER_HZ counts, with the wraps taken out.
+static bool clockKnown;
+static uint32_t lastUptime;
+static int64_t clockNow;
+
+static uint32_t records;
+static uint32_t gaps;
+static uint32_t skipped;
+static uint64_t bytesIn;
+
+static volatile sig_atomic_t interrupted;
+static bool quiet;
+static const char* ppmPrefix;
+static double ppmInterval;
+static int64_t nextPpmAt;
+static unsigned pictures;
+
+// What's changed since the terminal and the pictures last showed it, and
+//  each string's segments the clock has yet to send; a picture waits until
+//  there are none, so it's never half of one update and half the next.
+static bool drawPending;
+static bool ppmPending;
+static uint8_t segmentsToCome[STRINGS];
+
+static void onSignal(int sig)
+{
+  (void)sig;
+  interrupted = 1;
+}
+
+static int64_t nowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double clockSeconds(int64_t counts)
+{
+  return (double)counts / SCHED_TIMER_HZ;
+}
+
+static int checksumOkay(const uint8_t* bytes, int size)
+{
+  uint8_t sum = 0;
+  int i;
+  for (i = 0; i < size - 1; i++)
+  {
+    sum ^= bytes[i];
+  }
+  return sum == bytes[size - 1];
+}
+
+// True if the segments in a record's body come out at exactly its length.
+static bool segmentsOkay(const uint8_t* body, uint8_t length)
+{
+  uint8_t at = 0;
+  while (at < length)
+  {
+    bool fill = (body[at] & FRAMESTREAM_FILL) != 0;
+    if ((body[at] & ~FRAMESTREAM_FILL) >= SEGMENTS_PER_DIGIT)
+    {
+      return false;
+    }
+    at += fill ? FRAMESTREAM_FILL_SIZE : FRAMESTREAM_FULL_SIZE;
+  }
+  return at == length;
+}
+
+/*****************************************************************************
+*  Drawing, as the simulator does it.
+*****************************************************************************/
+
+// A segment's color: the average of its lit LEDs. False if none are lit.
+static bool segmentColor(uint8_t string, uint8_t first, uint8_t count,
+  uint8_t rgb[3])
+{
+  unsigned sum[3] = {0, 0, 0};
+  unsigned lit = 0;
+  uint8_t led;
+  uint8_t c;
+
+  for (led = first; led < first + count; led++)
+  {
+    const uint8_t* color = leds[string][led];
+    if (color[0] | color[1] | color[2])
+    {
+      lit++;
+      for (c = 0; c < 3; c++)
+      {
+        sum[c] += color[c];
+      }
+    }
+  }
+  for (c = 0; c < 3; c++)
+  {
+    rgb[c] = lit ? (uint8_t)(sum[c] / lit) : 0;
+  }
+  return lit > 0;
+}
+
+// One character of a digit, drawn in its segment's color if it's lit.
+static void drawSegment(uint8_t string, int segment, const char* glyph)
+{
+  uint8_t rgb[3];
+  if (segmentColor(string, segment * LEDS_PER_SEGMENT, LEDS_PER_SEGMENT,
+    rgb))
+  {
+    // Dimmed colors can be too dark to see; scale them up for the screen.
+    unsigned peak = rgb[0];
+    peak = (rgb[1] > peak) ? rgb[1] : peak;
+    peak = (rgb[2] > peak) ? rgb[2] : peak;
+    printf("\x1b[38;2;%u;%u;%um%s\x1b[0m", (rgb[0] * 255) / peak,
+      (rgb[1] * 255) / peak, (rgb[2] * 255) / peak, glyph);
+  }
+  else
+  {
+    printf(" ");
+  }
+}
+
+static void drawColon(int line)
+{
+  uint8_t rgb[3];
+  bool lit = segmentColor(COLON_STRING, (line == 1) ? 0 : COLON_LEDS / 2,
+    COLON_LEDS / 2, rgb);
+  printf(lit && (line > 0) ? "." : " ");
+}
+
+// Latches a second over each string's records so far.
+static double latchRate(const stringStats* string)
+{
+  double span = clockSeconds(string->lastAt - string->firstAt);
+  return (span > 0) ? (string->latches - string->firstLatches) / span : 0;
+}
+
+// The six digits, most significant first, with the colons between pairs,
+//  and the clock's time and the strings' latch rates alongside.
+static void drawTerminal(void)
+{
+  static bool drawn;
+  int line;
+  int digit;
+
+  if (drawn && isatty(STDOUT_FILENO))
+  {
+    printf("\x1b[3A"); // Draw over the last one.
+  }
+  drawn = true;
+  for (line = 0; line < 3; line++)
+  {
+    for (digit = NUM_DIGITS - 1; digit >= 0; digit--)
+    {
+      switch (line)
+      {
+        case 0:
+          printf(" ");
+          drawSegment(digit, A, "_");
+          printf(" ");
+          break;
+        case 1:
+          drawSegment(digit, F, "|");
+          drawSegment(digit, G, "_");
+          drawSegment(digit, B, "|");
+          break;
+        default:
+          drawSegment(digit, E, "|");
+          drawSegment(digit, D, "_");
+          drawSegment(digit, C, "|");
+          break;
+      }
+      if ((digit == 4) || (digit == 2))
+      {
+        drawColon(line);
+      }
+    }
+    if (line == 0)
+    {
+      printf("   uptime %.3f s  records %u  gaps %u", clockSeconds(clockNow),
+        records, gaps);
+    }
+    else if (line == 1)
+    {
+      printf("   latches/s:");
+      for (digit = NUM_DIGITS - 1; digit >= 0; digit--)
+      {
+        printf(" %.1f", latchRate(&stats[digit]));
+      }
+      printf("  colons %.1f", latchRate(&stats[COLON_STRING]));
+    }
+    printf("\x1b[K\n");
+  }
+  fflush(stdout);
+}
+
+static void plot(uint8_t* image, int width, int x, int y,
+  const uint8_t rgb[3])
+{
+  int dx;
+  int dy;
+  for (dy = 0; dy < PPM_SCALE - 1; dy++)
+  {
+    for (dx = 0; dx < PPM_SCALE - 1; dx++)
+    {
+      uint8_t* pixel = &image[(((y * PPM_SCALE) + dy) * width +
+        (x * PPM_SCALE) + dx) * 3];
+      memcpy(pixel, rgb, 3);
+    }
+  }
+}
+
+// An LED's spot on the picture: lit LEDs in their own color, dark ones a
+//  faint grey so the shape of the display shows.
+static void plotLed(uint8_t* image, int width, int x, int y, uint8_t string,
+  uint16_t led)
+{
+  static const uint8_t dark[3] = {24, 24, 24};
+  const uint8_t* rgb = leds[string][led];
+  plot(image, width, x, y, (rgb[0] | rgb[1] | rgb[2]) ? rgb : dark);
+}
+
+// Lays a segment's LEDs out along its bar, from (x, y), across or down.
+static void plotSegment(uint8_t* image, int width, int x, int y, bool down,
+  uint8_t string, int segment)
+{
+  int i;
+  for (i = 0; i < LEDS_PER_SEGMENT; i++)
+  {
+    plotLed(image, width, down ? x : x + i, down ? y + i : y, string,
+      (segment * LEDS_PER_SEGMENT) + i);
+  }
+}
+
+static void writePpm(void)
+{
+  const int columns = (NUM_DIGITS * DIGIT_W) + (2 * COLON_W) +
+    ((NUM_DIGITS + 1) * GAP_W);
+  const int width = columns * PPM_SCALE;
+  const int height = (DIGIT_H + 2) * PPM_SCALE;
+  uint8_t* image = calloc((size_t)width * height, 3);
+  char path[4096];
+  int x = GAP_W;
+  int digit;
+  int i;
+
+  for (digit = NUM_DIGITS - 1; digit >= 0; digit--)
+  {
+    const int L = LEDS_PER_SEGMENT;
+    plotSegment(image, width, x + 1, 1, false, digit, A);
+    plotSegment(image, width, x + 1, L + 2, false, digit, G);
+    plotSegment(image, width, x + 1, (2 * L) + 3, false, digit, D);
+    plotSegment(image, width, x, 2, true, digit, F);
+    plotSegment(image, width, x + L + 1, 2, true, digit, B);
+    plotSegment(image, width, x, L + 3, true, digit, E);
+    plotSegment(image, width, x + L + 1, L + 3, true, digit, C);
+    x += DIGIT_W + GAP_W;
+    if ((digit == 4) || (digit == 2))
+    {
+      // Each colon string is two dots of four LEDs, one above the other.
+      for (i = 0; i < COLON_LEDS; i++)
+      {
+        int dot = i / (COLON_LEDS / 2);
+        plotLed(image, width, x - (GAP_W / 2) + (i % 2),
+          (dot ? (DIGIT_H * 2) / 3 : DIGIT_H / 3) + ((i / 2) % 2),
+          COLON_STRING, i);
+      }
+      x += COLON_W;
+    }
+  }
+
+  snprintf(path, sizeof(path), "%s%06u.ppm", ppmPrefix, pictures++);
+  FILE* out = fopen(path, "wb");
+  if (!out)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  fprintf(out, "P6\n# uptime %.5f s\n%d %d\n255\n", clockSeconds(clockNow),
+    width, height);
+  fwrite(image, 3, (size_t)width * height, out);
+  fclose(out);
+  free(image);
+}
+
+/*****************************************************************************
+*  Records.
+*****************************************************************************/
+
+// Puts a record's segments into the picture, and its times into the stats.
+//  Returns the clock time it's from.
+static int64_t applyRecord(const framestreamHeader* header,
+  const uint8_t* body)
+{
+  stringStats* string = &stats[header->string];
+  uint8_t at = 0;
+
+  while (at < header->length)
+  {
+    uint8_t segment = body[at] & ~FRAMESTREAM_FILL;
+    bool fill = (body[at] & FRAMESTREAM_FILL) != 0;
+    uint8_t led;
+
+    for (led = 0; led < LEDS_PER_SEGMENT; led++)
+    {
+      memcpy(leds[header->string][(segment * LEDS_PER_SEGMENT) + led],
+        &body[at + 1 + (fill ? 0 : 3 * led)], 3);
+    }
+    at += fill ? FRAMESTREAM_FILL_SIZE : FRAMESTREAM_FULL_SIZE;
+  }
+
+  // Records aren't quite in time order (the strings take turns), so the
+  //  uptime can step back a little as well as forward.
+  if (!clockKnown)
+  {
+    clockKnown = true;
+    clockNow = header->uptime;
+  }
+  else
+  {
+    clockNow += (int32_t)(header->uptime - lastUptime);
+  }
+  lastUptime = header->uptime;
+
+  if (!string->seen)
+  {
+    string->seen = true;
+    string->latches = header->latches;
+    string->firstLatches = header->latches;
+    string->firstAt = clockNow;
+  }
+  else
+  {
+    string->latches += (uint16_t)(header->latches - string->lastLatches);
+  }
+  string->lastLatches = header->latches;
+  string->lastAt = clockNow;
+  string->records++;
+  records++;
+  segmentsToCome[header->string] = header->pending;
+  if (header->length > 0)
+  {
+    drawPending = true;
+    ppmPending = true;
+  }
+  return clockNow;
+}
+
+// Takes every whole, valid record out of buffer[0, used), and returns how
+//  many bytes it got through. Anything else it slides past a byte at a time
+//  until it's back in sync. Calls back with each record's clock time.
+static size_t takeRecords(const uint8_t* buffer, size_t used, int* lastSeq,
+  void (*pace)(int64_t at))
+{
+  size_t start = 0;
+
+  while (used - start >= FRAMESTREAM_HEADER_SIZE)
+  {
+    framestreamHeader header;
+    size_t size;
+
+    memcpy(&header, buffer + start, sizeof(header));
+    size = FRAMESTREAM_HEADER_SIZE + header.length + 1;
+    if ((header.sync != FRAMESTREAM_SYNC) || (header.string >= STRINGS) ||
+      (size > FRAMESTREAM_RECORD_MAX))
+    {
+      start++;
+      skipped++;
+      continue;
+    }
+    if (used - start < size)
+    {
+      break; // Could be the start of one; wait for the rest.
+    }
+    if (!checksumOkay(buffer + start, (int)size) ||
+      !segmentsOkay(buffer + start + FRAMESTREAM_HEADER_SIZE, header.length))
+    {
+      start++;
+      skipped++;
+      continue;
+    }
+    if ((*lastSeq >= 0) && (header.seq != (uint8_t)(*lastSeq + 1)))
+    {
+      gaps++;
+    }
+    *lastSeq = header.seq;
+    pace(applyRecord(&header, buffer + start + FRAMESTREAM_HEADER_SIZE));
+    start += size;
+  }
+  return start;
+}
+
+/*****************************************************************************
+*  Live from the clock, or from a capture.
+*****************************************************************************/
+
+static bool live;
+static bool fast;
+static int64_t lastDrawAt;
+static int64_t replayStartNs;
+static int64_t replayStartAt;
+static bool replayStarted;
+
+// Brings the outputs up to date with the picture. The terminal is only
+//  redrawn every DRAW_INTERVAL_NS, unless there's a wait coming (flush).
+static void show(bool flush)
+{
+  int64_t wall = nowNs();
+  uint8_t string;
+  bool whole = true;
+
+  for (string = 0; string < STRINGS; string++)
+  {
+    whole = whole && (segmentsToCome[string] == 0);
+  }
+  if (ppmPrefix && ppmPending && whole && (clockNow >= nextPpmAt))
+  {
+    writePpm();
+    ppmPending = false;
+    nextPpmAt = clockNow + (int64_t)(ppmInterval * SCHED_TIMER_HZ);
+  }
+  if (!quiet && drawPending &&
+    (flush || (wall - lastDrawAt >= DRAW_INTERVAL_NS)))
+  {
+    drawTerminal();
+    drawPending = false;
+    lastDrawAt = wall;
+  }
+}
+
+// Live, the records come as fast as the clock sends them; played back,
+//  each waits for its time to come round.
+static void pace(int64_t at)
+{
+  if (!live && !fast)
+  {
+    int64_t due;
+
+    if (!replayStarted)
+    {
+      replayStarted = true;
+      replayStartNs = nowNs();
+      replayStartAt = at;
+    }
+    due = replayStartNs +
+      ((at - replayStartAt) * (1000000000LL / SCHED_TIMER_HZ));
+    if (due > nowNs())
+    {
+      struct timespec wait;
+      int64_t left = due - nowNs();
+      show(true);
+      wait.tv_sec = left / 1000000000;
+      wait.tv_nsec = left % 1000000000;
+      nanosleep(&wait, NULL);
+    }
+  }
+  show(false);
+}
+
+static bool sendCommand(int fd, char command)
+{
+  return write(fd, &command, 1) == 1;
+}
+
+static void summary(void)
+{
+  uint8_t string;
+
+  printf("%u records, %llu bytes in, %u sequence gaps, %u bytes skipped\n",
+    records, (unsigned long long)bytesIn, gaps, skipped);
+  printf("%-8s %8s %10s %10s %10s\n", "string", "records", "latches",
+    "seconds", "latches/s");
+  for (string = 0; string < STRINGS; string++)
+  {
+    const stringStats* s = &stats[string];
+    char name[16];
+    if (string == COLON_STRING)
+    {
+      snprintf(name, sizeof(name), "colons");
+    }
+    else
+    {
+      snprintf(name, sizeof(name), "digit %u", string);
+    }
+    printf("%-8s %8u %10llu %10.3f %10.2f\n", name, s->records,
+      (unsigned long long)(s->seen ? s->latches - s->firstLatches : 0),
+      s->seen ? clockSeconds(s->lastAt - s->firstAt) : 0.0, latchRate(s));
+  }
+  if (clockKnown)
+  {
+    double span = 0;
+    for (string = 0; string < STRINGS; string++)
+    {
+      double each = stats[string].seen ?
+        clockSeconds(stats[string].lastAt - stats[string].firstAt) : 0;
+      span = (each > span) ? each : span;
+    }
+    printf("%.1f records/s, %.0f bytes/s over %.3f s of the clock's time\n",
+      (span > 0) ? records / span : 0.0, (span > 0) ? bytesIn / span : 0.0,
+      span);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  uint8_t buffer[4 * FRAMESTREAM_RECORD_MAX];
+  size_t used = 0;
+  int lastSeq = -1;
+  const char* capturePath = NULL;
+  FILE* capture = NULL;
+  int64_t restartAt = 0;
+  uint32_t restartGaps = 0;
+  struct termios tio;
+  int opt;
+  int fd;
+
+  while ((opt = getopt(argc, argv, "qw:p:i:f")) != -1)
+  {
+    switch (opt)
+    {
+      case 'q': quiet = true; break;
+      case 'w': capturePath = optarg; break;
+      case 'p': ppmPrefix = optarg; break;
+      case 'i': ppmInterval = atof(optarg); break;
+      case 'f': fast = true; break;
+      default: optind = argc + 1; break;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    fprintf(stderr, "usage: %s [-q] [-w capture] [-p prefix] [-i seconds] "
+      "[-f] <tty or capture file>\n", argv[0]);
+    return 2;
+  }
+
+  fd = open(argv[optind], O_RDWR | O_NOCTTY);
+  if (fd < 0)
+  {
+    fd = open(argv[optind], O_RDONLY);
+  }
+  if (fd < 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  live = isatty(fd);
+  // CDC ignores the baud rate, but the line discipline would still mangle
+  //  binary data unless the port is raw.
+  if (live && (tcgetattr(fd, &tio) == 0))
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  if (capturePath)
+  {
+    capture = fopen(capturePath, "wb");
+    if (!capture)
+    {
+      fprintf(stderr, "%s: %s\n", capturePath, strerror(errno));
+      return 1;
+    }
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  if (live && !sendCommand(fd, FRAMESTREAM_START_CMD))
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+
+  while (!interrupted)
+  {
+    ssize_t got;
+
+    if (live)
+    {
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      if (poll(&pfd, 1, 200) <= 0)
+      {
+        show(true);
+        continue;
+      }
+    }
+    got = read(fd, buffer + used, sizeof(buffer) - used);
+    if (got <= 0)
+    {
+      break;
+    }
+    used += got;
+    bytesIn += got;
+    if (capture)
+    {
+      fwrite(buffer + used - got, 1, got, capture);
+    }
+
+    size_t start = takeRecords(buffer, used, &lastSeq, pace);
+    memmove(buffer, buffer + start, used - start);
+    used -= start;
+
+    // Changes have gone missing; the picture's only right again once every
+    //  string has been sent afresh.
+    if (live && (gaps != restartGaps) && (nowNs() >= restartAt))
+    {
+      restartGaps = gaps;
+      restartAt = nowNs() + RESTART_INTERVAL_NS;
+      sendCommand(fd, FRAMESTREAM_START_CMD);
+    }
+  }
+
+  if (live)
+  {
+    sendCommand(fd, FRAMESTREAM_STOP_CMD);
+  }
+  if (capture)
+  {
+    fclose(capture);
+  }
+  close(fd);
+  show(true);
+  summary();
+  return 0;
+}
@@ -0,0 +1,261 @@
+// Behavioural stand-ins for the PSoC 5LP UDB primitives B_WS2811_v1_3 uses:
+//  the 8-bit datapath, and the control and status registers. They model
+//  what the component relies on and no more; anything else it is configured
+//  for is reported at time 0 rather than silently simulated wrong.
+//
+// The CPU side is a task per register, for a testbench to call through the
+//  instance, e.g. dut.ctrl.cpu_write(8'h19). Call them away from the rising
+//  clock edge, as the bus does.
+`include "cypress.v"
+
+// Datapath: A0, A1, D0, D1, the ALU, shifter and conditions, and a 4-byte
+//  F0 the CPU writes and the datapath reads (FIFO0 on the bus side). F1,
+//  carry, chaining, masks and CRC aren't modelled. The conditions come
+//  straight off the registers, so they change on the clock that changes the
+//  registers. The auxiliary control register's FIFO0 clear bit is modelled
+//  the way the StripLights API uses it on pwm8: while it's set, F0 holds
+//  the last byte written, and reading it doesn't use it up.
+module cy_psoc3_dp8 (
+    input        reset,
+    input        clk,
+    input  [2:0] cs_addr,
+    input        route_si,
+    input        route_ci,
+    input        f0_load,
+    input        f1_load,
+    input        d0_load,
+    input        d1_load,
+    output       ce0,
+    output       cl0,
+    output       z0,
+    output       ff0,
+    output       ce1,
+    output       cl1,
+    output       z1,
+    output       ff1,
+    output       ov_msb,
+    output       co_msb,
+    output       cmsb,
+    output       so,
+    output       f0_bus_stat,
+    output       f0_blk_stat,
+    output       f1_bus_stat,
+    output       f1_blk_stat
+);
+    parameter [207:0] cy_dpconfig_a = 208'd0;
+    parameter [7:0] a0_init_a = 8'd0;
+    parameter [7:0] a1_init_a = 8'd0;
+    parameter [7:0] d0_init_a = 8'd0;
+    parameter [7:0] d1_init_a = 8'd0;
+
+    reg [7:0] a0;
+    reg [7:0] a1;
+    reg [7:0] d0;
+    reg [7:0] d1;
+    reg [7:0] f0 [0:3];
+    reg [1:0] f0Head;          // Next byte the datapath reads
+    reg [2:0] f0Count;
+    reg       f0Hold;          // ACTL FIFO0 clear: single buffer, never used up
+    integer   f0Overflows;     // CPU writes dropped, FIFO full
+    integer   f0Underflows;    // Datapath reads of an empty FIFO
+
+    wire [1:0] f0Tail = f0Head + f0Count[1:0];
+
+    // This cycle's CFGRAM word. CFGRAM0 comes first in the parameter, above
+    //  the 80 bits of static configuration.
+    wire [15:0] cfg = cy_dpconfig_a >> (80 + 16 * (7 - cs_addr));
+    wire [2:0] aluOp  = cfg[15:13];
+    wire       srcA   = cfg[12];
+    wire [1:0] srcB   = cfg[11:10];
+    wire [1:0] shftOp = cfg[9:8];
+    wire [1:0] a0Src  = cfg[7:6];
+    wire [1:0] a1Src  = cfg[5:4];
+    wire       cmpSel = cfg[0];
+
+    // Static configuration, CFG13-12 and CFG15-14
+    wire [1:0] cmpB     = cy_dpconfig_a[47:46];
+    wire [1:0] cmpA     = cy_dpconfig_a[45:44];
+    wire       defSi    = cy_dpconfig_a[36];
+    wire [1:0] shiftDir = cy_dpconfig_a[30:29];
+
+    wire [7:0] aluA = (srcA == `CS_SRCA_A1) ? a1 : a0;
+    wire [7:0] aluB = (srcB == `CS_SRCB_D0) ? d0 :
+                      (srcB == `CS_SRCB_D1) ? d1 :
+                      (srcB == `CS_SRCB_A0) ? a0 : a1;
+    reg  [7:0] alu;
+
+    always @(*)
+    begin
+        case (aluOp)
+            `CS_ALU_OP_PASS: alu = aluA;
+            `CS_ALU_OP__INC: alu = aluA + 8'd1;
+            `CS_ALU_OP__DEC: alu = aluA - 8'd1;
+            `CS_ALU_OP__ADD: alu = aluA + aluB;
+            `CS_ALU_OP__SUB: alu = aluA - aluB;
+            `CS_ALU_OP__XOR: alu = aluA ^ aluB;
+            `CS_ALU_OP__AND: alu = aluA & aluB;
+            default:         alu = aluA | aluB;
+        endcase
+    end
+
+    wire [7:0] shifted = (shftOp == `CS_SHFT_OP___SL) ? {alu[6:0], defSi} :
+                         (shftOp == `CS_SHFT_OP___SR) ? {defSi, alu[7:1]} :
+                         (shftOp == `CS_SHFT_OP_SWAP) ? {alu[3:0], alu[7:4]} :
+                         alu;
+
+    // Shift out is the bit a shift in the static direction would lose.
+    assign so = (shiftDir == `SC_SHIFT_SR) ? alu[0] : alu[7];
+
+    // Compare 1 is A1 or A0 against D1 or A0, as configuration A or B says.
+    wire [1:0] cmp1   = (cmpSel == `CS_CMP_SEL_CFGB) ? cmpB : cmpA;
+    wire [7:0] cmp1L  = ((cmp1 == `SC_CMPA_A0_D1) || (cmp1 == `SC_CMPA_A0_A0)) ? a0 : a1;
+    wire [7:0] cmp1R  = ((cmp1 == `SC_CMPA_A1_D1) || (cmp1 == `SC_CMPA_A0_D1)) ? d1 : a0;
+
+    assign ce0 = (a0 == d0);
+    assign cl0 = (a0 < d0);
+    assign z0  = (a0 == 8'h00);
+    assign ff0 = (a0 == 8'hFF);
+    assign ce1 = (cmp1L == cmp1R);
+    assign cl1 = (cmp1L < cmp1R);
+    assign z1  = (a1 == 8'h00);
+    assign ff1 = (a1 == 8'hFF);
+    assign ov_msb = 1'b0;
+    assign co_msb = 1'b0;
+    assign cmsb   = 1'b0;
+
+    // Bus side: not full. Block side: empty.
+    assign f0_bus_stat = (f0Count != 3'd4);
+    assign f0_blk_stat = (f0Count == 3'd0);
+    assign f1_bus_stat = 1'b1;
+    assign f1_blk_stat = 1'b1;
+
+    initial
+    begin
+        a0 = a0_init_a;
+        a1 = a1_init_a;
+        d0 = d0_init_a;
+        d1 = d1_init_a;
+        f0Head = 2'd0;
+        f0Count = 3'd0;
+        f0Hold = 1'b0;
+        f0Overflows = 0;
+        f0Underflows = 0;
+        if (cy_dpconfig_a[25] != `SC_FIFO0_BUS)
+            $display("%m: only a CPU-written F0 is modelled");
+        if ((cy_dpconfig_a[35:32] != 4'd0) || (cy_dpconfig_a[39:37] != 3'd0) ||
+            (cy_dpconfig_a[24] != `SC_MSB_DSBL) || (cy_dpconfig_a[1:0] != 2'd0))
+            $display("%m: shift in routing, masks, MSB, CRC and chaining aren't modelled");
+    end
+
+    always @(posedge clk)
+    begin
+        case (a0Src)
+            `CS_A0_SRC__ALU: a0 <= shifted;
+            `CS_A0_SRC___D0: a0 <= d0;
+            `CS_A0_SRC___F0:
+            begin
+                a0 <= f0[f0Head];
+                if (f0Count == 3'd0)
+                    f0Underflows = f0Underflows + 1;
+                else if (!f0Hold)
+                begin
+                    f0Head  <= f0Head + 2'd1;
+                    f0Count <= f0Count - 3'd1;
+                end
+            end
+            default: ;
+        endcase
+
+        case (a1Src)
+            `CS_A1_SRC__ALU: a1 <= shifted;
+            `CS_A1_SRC___D1: a1 <= d1;
+            default: ;
+        endcase
+    end
+
+    task cpu_write_f0;
+        input [7:0] value;
+        begin
+            if (f0Hold)
+            begin
+                f0[f0Head] = value;
+                f0Count = 3'd1;
+            end
+            else if (f0Count == 3'd4)
+                f0Overflows = f0Overflows + 1;
+            else
+            begin
+                f0[f0Tail] = value;
+                f0Count = f0Count + 3'd1;
+            end
+        end
+    endtask
+
+    task cpu_write_d0;
+        input [7:0] value;
+        d0 = value;
+    endtask
+
+    task cpu_write_d1;
+        input [7:0] value;
+        d1 = value;
+    endtask
+
+    task cpu_write_actl;
+        input [7:0] value;
+        begin
+            f0Hold = value[0];
+            if (f0Hold)
+                f0Count = 3'd0;
+        end
+    endtask
+endmodule
+
+// Control register: what the CPU last wrote, straight to the UDBs.
+module cy_psoc3_control (
+    output [7:0] control
+);
+    parameter [7:0] cy_init_value = 8'd0;
+    parameter cy_force_order = 0;
+    parameter [7:0] cy_ctrl_mode_1 = 8'd0;
+    parameter [7:0] cy_ctrl_mode_0 = 8'd0;
+
+    reg [7:0] controlReg;
+
+    assign control = controlReg;
+
+    initial
+        controlReg = cy_init_value;
+
+    task cpu_write;
+        input [7:0] value;
+        controlReg = value;
+    endtask
+endmodule
+
+// Status register: samples status on each clock. Bits set in cy_md_select
+//  are sticky until the CPU reads them.
+module cy_psoc3_status (
+    input  [7:0] status,
+    input        reset,
+    input        clock
+);
+    parameter cy_force_order = 0;
+    parameter [7:0] cy_md_select = 8'd0;
+
+    reg [7:0] statusReg;
+
+    initial
+        statusReg = 8'd0;
+
+    always @(posedge clock)
+        statusReg <= (statusReg & cy_md_select) | status;
+
+    task cpu_read;
+        output [7:0] value;
+        begin
+            value = statusReg;
+            statusReg = statusReg & ~cy_md_select;
+        end
+    endtask
+endmodule
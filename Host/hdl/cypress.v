@@ -0,0 +1,126 @@
+// Stand-in for the cypress.v PSoC Creator gives components, with just the
+//  macros B_WS2811_v1_3 uses, so the component can be simulated on its own
+//  (see run.sh). The datapath configuration fields are laid out in the order
+//  the component concatenates them; the values only have to agree with
+//  cy_psoc3.v, which decodes them, and aren't all the vendor's encodings.
+`ifndef CYPRESS_V_STANDIN
+`define CYPRESS_V_STANDIN
+
+`timescale 1ps/1ps
+
+`define TRUE  1'b1
+`define FALSE 1'b0
+
+// Dynamic configuration, one 16-bit word per CFGRAM address
+`define CS_ALU_OP_PASS    3'd0
+`define CS_ALU_OP__INC    3'd1
+`define CS_ALU_OP__DEC    3'd2
+`define CS_ALU_OP__ADD    3'd3
+`define CS_ALU_OP__SUB    3'd4
+`define CS_ALU_OP__XOR    3'd5
+`define CS_ALU_OP__AND    3'd6
+`define CS_ALU_OP___OR    3'd7
+`define CS_SRCA_A0        1'd0
+`define CS_SRCA_A1        1'd1
+`define CS_SRCB_D0        2'd0
+`define CS_SRCB_D1        2'd1
+`define CS_SRCB_A0        2'd2
+`define CS_SRCB_A1        2'd3
+`define CS_SHFT_OP_PASS   2'd0
+`define CS_SHFT_OP___SL   2'd1
+`define CS_SHFT_OP___SR   2'd2
+`define CS_SHFT_OP_SWAP   2'd3
+`define CS_A0_SRC_NONE    2'd0
+`define CS_A0_SRC__ALU    2'd1
+`define CS_A0_SRC___D0    2'd2
+`define CS_A0_SRC___F0    2'd3
+`define CS_A1_SRC_NONE    2'd0
+`define CS_A1_SRC__ALU    2'd1
+`define CS_A1_SRC___D1    2'd2
+`define CS_A1_SRC___F1    2'd3
+`define CS_FEEDBACK_DSBL  1'd0
+`define CS_FEEDBACK_ENBL  1'd1
+`define CS_CI_SEL_CFGA    1'd0
+`define CS_CI_SEL_CFGB    1'd1
+`define CS_SI_SEL_CFGA    1'd0
+`define CS_SI_SEL_CFGB    1'd1
+`define CS_CMP_SEL_CFGA   1'd0
+`define CS_CMP_SEL_CFGB   1'd1
+
+// Static configuration, CFG13-12
+`define SC_CMPB_A1_D1     2'd0
+`define SC_CMPB_A1_A0     2'd1
+`define SC_CMPB_A0_D1     2'd2
+`define SC_CMPB_A0_A0     2'd3
+`define SC_CMPA_A1_D1     2'd0
+`define SC_CMPA_A1_A0     2'd1
+`define SC_CMPA_A0_D1     2'd2
+`define SC_CMPA_A0_A0     2'd3
+`define SC_CI_B_ARITH     2'd0
+`define SC_CI_B_REGIS     2'd1
+`define SC_CI_B_ROUTE     2'd2
+`define SC_CI_B_CHAIN     2'd3
+`define SC_CI_A_ARITH     2'd0
+`define SC_CI_A_REGIS     2'd1
+`define SC_CI_A_ROUTE     2'd2
+`define SC_CI_A_CHAIN     2'd3
+`define SC_C1_MASK_DSBL   1'd0
+`define SC_C1_MASK_ENBL   1'd1
+`define SC_C0_MASK_DSBL   1'd0
+`define SC_C0_MASK_ENBL   1'd1
+`define SC_A_MASK_DSBL    1'd0
+`define SC_A_MASK_ENBL    1'd1
+`define SC_DEF_SI_0       1'd0
+`define SC_DEF_SI_1       1'd1
+`define SC_SI_B_DEFSI     2'd0
+`define SC_SI_B_REGIS     2'd1
+`define SC_SI_B_ROUTE     2'd2
+`define SC_SI_B_CHAIN     2'd3
+`define SC_SI_A_DEFSI     2'd0
+`define SC_SI_A_REGIS     2'd1
+`define SC_SI_A_ROUTE     2'd2
+`define SC_SI_A_CHAIN     2'd3
+
+// CFG15-14
+`define SC_A0_SRC_ACC     1'd0
+`define SC_A0_SRC_PIN     1'd1
+`define SC_SHIFT_SL       2'd0
+`define SC_SHIFT_SR       2'd1
+`define SC_FIFO1_BUS      1'd0
+`define SC_FIFO1_ALU      1'd1
+`define SC_FIFO0_BUS      1'd0
+`define SC_FIFO0_ALU      1'd1
+`define SC_MSB_DSBL       1'd0
+`define SC_MSB_ENBL       1'd1
+`define SC_MSB_BIT0       3'd0
+`define SC_MSB_BIT1       3'd1
+`define SC_MSB_BIT2       3'd2
+`define SC_MSB_BIT3       3'd3
+`define SC_MSB_BIT4       3'd4
+`define SC_MSB_BIT5       3'd5
+`define SC_MSB_BIT6       3'd6
+`define SC_MSB_BIT7       3'd7
+`define SC_MSB_NOCHN      1'd0
+`define SC_MSB_CHNED      1'd1
+`define SC_FB_NOCHN       2'd0
+`define SC_FB_CHNED       2'd1
+`define SC_CMP1_NOCHN     1'd0
+`define SC_CMP1_CHNED     1'd1
+`define SC_CMP0_NOCHN     1'd0
+`define SC_CMP0_CHNED     1'd1
+
+// CFG17-16
+`define SC_FIFO_CLK__DP   1'd0
+`define SC_FIFO_CLK_BUS   1'd1
+`define SC_FIFO_CAP_AX    1'd0
+`define SC_FIFO_CAP_FX    1'd1
+`define SC_FIFO__EDGE     1'd0
+`define SC_FIFO_LEVEL     1'd1
+`define SC_FIFO__SYNC     1'd0
+`define SC_FIFO_ASYNC     1'd1
+`define SC_EXTCRC_DSBL    1'd0
+`define SC_EXTCRC_ENBL    1'd1
+`define SC_WRK16CAT_DSBL  1'd0
+`define SC_WRK16CAT_ENBL  1'd1
+
+`endif
@@ -0,0 +1,77 @@
+#!/bin/sh
+# Simulates the B_WS2811 component with Icarus Verilog, against the
+#  stand-ins for the PSoC primitives here, and runs each testbench. Each one
+#  prints PASS or FAIL last; this prints the simulator's version first and a
+#  line per testbench at the end, and exits 1 if any failed or never said,
+#  or 2 if there's no iverilog to run them with.
+#
+#   ./run.sh [testbench ...]      (default: all of them)
+#
+#   ws2811_dim_tb       hardware dimming is bit exact and leaves timing alone
+#   ws2811_timing_tb    line timing and ISR latency headroom at 24, 48 and
+#                       64 MHz bus clocks, and FIFO starvation is caught
+#   ws2811_latch_tb     latch gap, dead time between rows, and latch 0 as
+#                       the component was before the gap timer
+#
+# The firmware's side is ws2811_bench.v, which does what SLights.c does;
+#  keep the two in step.
+
+set -e
+cd "$(dirname "$0")"
+
+DUT=../../GPS_Clock.cydsn/B_WS2811_v1_3/B_WS2811_v1_3.v
+OUT=${OUT:-build}
+mkdir -p "$OUT"
+
+for tool in iverilog vvp
+do
+  if ! command -v $tool > /dev/null
+  then
+    echo "$tool not found; install Icarus Verilog" >&2
+    exit 2
+  fi
+done
+iverilog -V 2>&1 | head -n 1
+
+failed=0
+results=
+
+# run <testbench> [name] [iverilog options]
+run()
+{
+  tb=$1
+  name=${2:-$1}
+  shift
+  [ $# -gt 0 ] && shift
+  echo "== $name"
+  iverilog -g2005 -I . -s "$tb" -o "$OUT/$name.vvp" "$@" \
+    "$tb.v" ws2811_bench.v ws281x_monitor.v cy_psoc3.v "$DUT"
+  vvp -n "$OUT/$name.vvp" | tee "$OUT/$name.log"
+  if tail -n 1 "$OUT/$name.log" | grep -q '^PASS'
+  then
+    results="$results$name PASS\n"
+  else
+    results="$results$name FAIL\n"
+    failed=1
+  fi
+}
+
+tests=${*:-"ws2811_dim_tb ws2811_timing_tb ws2811_latch_tb"}
+for tb in $tests
+do
+  case $tb in
+    ws2811_timing_tb)
+      for khz in 24000 48000 64000
+      do
+        run "$tb" "${tb}_$khz" "-P$tb.CLK_KHZ=$khz"
+      done
+      ;;
+    *)
+      run "$tb"
+      ;;
+  esac
+done
+
+echo "=="
+printf "$results"
+exit $failed
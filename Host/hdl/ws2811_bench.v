@@ -0,0 +1,250 @@
+`include "cypress.v"
+
+// One B_WS2811_v1_3 on a CLK_KHZ bus clock, with a monitor on its output
+//  and the firmware's side as tasks: start() is StripLights_Start(), and
+//  send_rows() is StripLights_Trigger() and the two interrupt handlers as
+//  SLights.c has them, each handler isrLatency bus clocks after its
+//  interrupt. The transfer complete interrupt is latched, as the NVIC
+//  would; the FIFO one is a level.
+//
+// CPU register writes are cpuClocks bus clocks apart, as a store to a UDB
+//  register and the instructions between them take more than one. (At one
+//  clock apart, a FIFO refill straight after NEXT_ROW used to take the
+//  state machine from IDLE to START before pwm8 was reloaded, and put a
+//  one-clock pulse ahead of the row; START now loads it whatever the timing.)
+//
+// The LEDs sent are leds[], row after row, as StripLights colors: bits 7:0
+//  go first.
+module ws2811_bench;
+    parameter CLK_KHZ  = 24000;
+    parameter MAX_LEDS = 128;
+
+    // As SLights.h works them out, for 800 kHz
+    localparam PERIOD     = CLK_KHZ / 800;
+    localparam DATA_ZERO  = (PERIOD * 20) / 25;
+    localparam DATA_ONE   = (PERIOD * 12) / 25;
+    localparam LATCH_BITS = (55000 + 1249) / 1250;
+    localparam HALF_PS    = 500000000 / CLK_KHZ;
+    localparam BIT_PS     = 2 * HALF_PS * PERIOD;
+
+    // Control register bits
+    localparam ENABLE         = 8'h01;
+    localparam FIFO_IRQ_EN    = 8'h08;
+    localparam XFRCMPT_IRQ_EN = 8'h10;
+    localparam NEXT_ROW       = 8'h20;
+
+    reg clk = 1'b0;
+    reg reset = 1'b1;
+
+    always #HALF_PS clk = ~clk;
+
+    wire firq;
+    wire cirq;
+    wire sout;
+    wire cntl;
+
+    B_WS2811_v1_3 dut (
+        .firq(firq),
+        .cirq(cirq),
+        .sout(sout),
+        .cntl(cntl),
+        .clk(clk),
+        .reset(reset)
+    );
+
+    ws281x_monitor mon (
+        .sout(sout)
+    );
+
+    reg [23:0] leds [0:MAX_LEDS-1];
+    integer isrLatency;
+    integer cpuClocks;
+    integer underruns;     // As StripLights_Underruns() counts them
+    reg     cisrPending;
+    time    cisrAt;        // When the last transfer complete interrupt came
+
+    initial
+    begin
+        isrLatency = 0;
+        cpuClocks = 2;
+        underruns = 0;
+        cisrPending = 1'b0;
+        cisrAt = 0;
+    end
+
+    always @(posedge cirq)
+    begin
+        cisrPending = 1'b1;
+        cisrAt = $time;
+    end
+
+    task write_control;
+        input [7:0] value;
+        begin
+            repeat (cpuClocks - 1) @(negedge clk);
+            @(negedge clk) dut.ctrl.cpu_write(value);
+        end
+    endtask
+
+    task write_data;
+        input [7:0] value;
+        begin
+            repeat (cpuClocks - 1) @(negedge clk);
+            @(negedge clk) dut.dshifter.cpu_write_f0(value);
+        end
+    endtask
+
+    task put_led;
+        input integer index;
+        begin
+            write_data(leds[index][7:0]);
+            write_data(leds[index][15:8]);
+            write_data(leds[index][23:16]);
+        end
+    endtask
+
+    // StripLights_Start(), with the dim level and latch gap to use.
+    task start;
+        input [2:0] dim;
+        input [7:0] latchBits;
+        begin
+            reset = 1'b1;
+            repeat (2) @(negedge clk);
+            reset = 1'b0;
+            @(negedge clk) dut.pwm8.cpu_write_actl(8'h03);
+            @(negedge clk) dut.pwm8.cpu_write_f0(PERIOD - 1);
+            @(negedge clk) dut.pwm8.cpu_write_d0(DATA_ZERO);
+            @(negedge clk) dut.pwm8.cpu_write_d1(DATA_ONE);
+            @(negedge clk) dut.latchCtrl.cpu_write(latchBits);
+            @(negedge clk) dut.dimCtrl.cpu_write({5'd0, dim});
+            write_control(8'h00);
+            underruns = 0;
+            cisrPending = 1'b0;
+        end
+    endtask
+
+    // Trigger, then the interrupts until the last row's transfer is
+    //  complete, then StripLights_Ready() turning the component off.
+    task send_rows;
+        input integer rowCount;
+        input integer ledsPerRow;
+        integer row;
+        integer led;
+        begin
+            row = 0;
+            put_led(0);
+            led = 1;
+            write_control(ENABLE | XFRCMPT_IRQ_EN | FIFO_IRQ_EN);
+            while (row < rowCount)
+            begin
+                wait (cisrPending || firq);
+                repeat (isrLatency) @(posedge clk);
+                if (cisrPending)
+                begin
+                    // StripLights_CISR
+                    cisrPending = 1'b0;
+                    if (led < ledsPerRow)
+                        underruns = underruns + 1;
+                    write_control(ENABLE | NEXT_ROW);
+                    row = row + 1;
+                    if (row < rowCount)
+                    begin
+                        put_led(row * ledsPerRow);
+                        led = 1;
+                        write_control(ENABLE | FIFO_IRQ_EN);
+                    end
+                end
+                else if (firq)
+                begin
+                    // StripLights_FISR
+                    if (led < ledsPerRow)
+                    begin
+                        put_led(row * ledsPerRow + led);
+                        led = led + 1;
+                    end
+                    else
+                        write_control(ENABLE | XFRCMPT_IRQ_EN);
+                end
+            end
+            write_control(8'h00);
+        end
+    endtask
+
+    // Thirty bytes with every bit pattern that matters to the shifter: all
+    //  zeros and ones, a one or a zero in each place, alternating, runs.
+    //  Repeated along leds[], changed each time round.
+    task load_pattern;
+        integer i;
+        reg [23:0] color;
+        begin
+            for (i = 0; i < MAX_LEDS; i = i + 1)
+            begin
+                case (i % 10)
+                    0: color = 24'h80FF00;
+                    1: color = 24'h55AA01;
+                    2: color = 24'h080402;
+                    3: color = 24'h402010;
+                    4: color = 24'hFBFDFE;
+                    5: color = 24'hDFEFF7;
+                    6: color = 24'hC37FBF;
+                    7: color = 24'h69963C;
+                    8: color = 24'h5A0FF0;
+                    default: color = 24'h18E7A5;
+                endcase
+                leds[i] = color ^ {3{i[7:0] / 8'd10}};
+            end
+        end
+    endtask
+
+    // Waits out a latch, and has the monitor close the row.
+    task settle;
+        begin
+            #(2 * 50000000);
+            mon.finish;
+        end
+    endtask
+
+    // Compares the row the monitor saw with leds[first...], each byte
+    //  shifted right by dim. Returns the number of mismatches, counting a
+    //  short or long row as one.
+    task check_row;
+        input integer row;
+        input integer first;
+        input integer count;
+        input [2:0] dim;
+        output integer errors;
+        integer base;
+        integer length;
+        integer i;
+        reg [7:0] expected;
+        begin
+            errors = 0;
+            if (row >= mon.rows)
+            begin
+                $display("  row %0d: never latched", row);
+                errors = 1;
+            end
+            else
+            begin
+                mon.row_bytes(row, base, length);
+                if (length != 3 * count)
+                begin
+                    $display("  row %0d: %0d bytes, expected %0d", row, length, 3 * count);
+                    errors = errors + 1;
+                end
+                for (i = 0; (i < length) && (i < 3 * count); i = i + 1)
+                begin
+                    expected = leds[first + i / 3] >> (8 * (i % 3));
+                    expected = expected >> dim;
+                    if (mon.bytes[base + i] != expected)
+                    begin
+                        if (errors < 4)
+                            $display("  row %0d byte %0d: %h, expected %h",
+                                row, i, mon.bytes[base + i], expected);
+                        errors = errors + 1;
+                    end
+                end
+            end
+        end
+    endtask
+endmodule
@@ -0,0 +1,86 @@
+`include "cypress.v"
+
+// Hardware dimming: at each dim level the string must get every byte
+//  shifted right by that level, bit for bit, with the timing exactly as it
+//  is undimmed: the same bit periods, and each bit high for as long as an
+//  undimmed bit of its value in its place in the byte. (The first bit of a
+//  byte is longer, for the START state, and dimmed it's always a zero, so
+//  the overall T1H range does change.)
+module ws2811_dim_tb;
+    parameter CLK_KHZ = 24000;
+
+    localparam LEDS = 10;
+
+    ws2811_bench #(.CLK_KHZ(CLK_KHZ)) bench ();
+
+    integer dim;
+    integer errors;
+    integer failures;
+    integer i;
+    time minHigh [0:15];
+    time maxHigh [0:15];
+    time bitPeriod [0:3];
+
+    initial
+    begin
+        #(64'd50_000_000_000);
+        $display("FAIL: timed out");
+        $finish;
+    end
+
+    initial
+    begin
+        failures = 0;
+        bench.load_pattern;
+        for (dim = 0; dim < 8; dim = dim + 1)
+        begin
+            bench.start(dim, bench.LATCH_BITS);
+            bench.mon.clear_stats;
+            bench.send_rows(1, LEDS);
+            bench.settle;
+            bench.check_row(dim, 0, LEDS, dim, errors);
+            $display("dim %0d: %0d of %0d bytes wrong", dim, errors, 3 * LEDS);
+            bench.mon.report;
+            if (dim == 0)
+            begin
+                for (i = 0; i < 16; i = i + 1)
+                begin
+                    minHigh[i] = bench.mon.minHigh[i];
+                    maxHigh[i] = bench.mon.maxHigh[i];
+                end
+                bitPeriod[0] = bench.mon.minBit;
+                bitPeriod[1] = bench.mon.maxBit;
+                bitPeriod[2] = bench.mon.minByte;
+                bitPeriod[3] = bench.mon.maxByte;
+            end
+            else
+            begin
+                for (i = 0; i < 16; i = i + 1)
+                begin
+                    if ((bench.mon.maxHigh[i] != 0) &&
+                        ((bench.mon.minHigh[i] != minHigh[i]) ||
+                         (bench.mon.maxHigh[i] != maxHigh[i])))
+                    begin
+                        $display("  bit %0d, a %0d: high %0d-%0d ps, undimmed %0d-%0d ps",
+                            i / 2, i % 2, bench.mon.minHigh[i], bench.mon.maxHigh[i],
+                            minHigh[i], maxHigh[i]);
+                        errors = errors + 1;
+                    end
+                end
+                if ((bench.mon.minBit != bitPeriod[0]) || (bench.mon.maxBit != bitPeriod[1]) ||
+                    (bench.mon.minByte != bitPeriod[2]) || (bench.mon.maxByte != bitPeriod[3]))
+                begin
+                    $display("  bit periods differ from undimmed");
+                    errors = errors + 1;
+                end
+            end
+            failures = failures + errors;
+        end
+
+        if (failures == 0)
+            $display("PASS: dimmed bytes exact, timing unchanged at every level");
+        else
+            $display("FAIL: %0d errors", failures);
+        $finish;
+    end
+endmodule
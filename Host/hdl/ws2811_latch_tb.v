@@ -0,0 +1,162 @@
+`include "cypress.v"
+
+// The latch gap timer and the dead time between rows.
+//
+//  - With the latch register at LATCH_BITS, transfer complete comes only
+//    after the line has been low that many bit periods.
+//  - Rows chained by the CISR with NEXT_ROW have at least that gap between
+//    them, plus the ISR's latency.
+//  - A FIFO refilled in DONE, without NEXT_ROW, starts the next row as soon
+//    as the gap is up.
+//  - With the latch register at 0 the component is as it was before the
+//    timer: complete straight away, and a refill waits for NEXT_ROW.
+module ws2811_latch_tb;
+    parameter CLK_KHZ = 24000;
+
+    localparam LEDS = 10;
+    localparam ROWS = 3;
+    localparam CLOCKS_PER_US = CLK_KHZ / 1000;
+    localparam STATE_DONE = 2'b11;
+
+    ws2811_bench #(.CLK_KHZ(CLK_KHZ)) bench ();
+
+    integer failures;
+    integer errors;
+    integer firstRow;
+    integer row;
+    integer bytesBefore;
+    time    gapMin;
+    time    gapMax;
+    time    lowTime;
+
+    initial
+    begin
+        #(64'd50_000_000_000);
+        $display("FAIL: timed out");
+        $finish;
+    end
+
+    // A time in ps as us, to 0.01 us
+    task show_us;
+        input [8*40-1:0] label;
+        input time value;
+        $display("  %0s %0d.%02d us", label, (value + 5000) / 1000000,
+            ((value + 5000) % 1000000) / 10000);
+    endtask
+
+    initial
+    begin
+        failures = 0;
+        bench.load_pattern;
+        gapMin = bench.LATCH_BITS * bench.BIT_PS;
+        gapMax = (bench.LATCH_BITS + 2) * bench.BIT_PS;
+        $display("%0d kHz bus clock, latch gap %0d bits", CLK_KHZ, bench.LATCH_BITS);
+
+        // One row: transfer complete after the gap
+        firstRow = bench.mon.rows;
+        bench.isrLatency = 2 * CLOCKS_PER_US;
+        bench.start(0, bench.LATCH_BITS);
+        bench.send_rows(1, LEDS);
+        lowTime = bench.cisrAt - bench.mon.lastFall;
+        bench.settle;
+        show_us("last bit to transfer complete", lowTime);
+        if ((lowTime < gapMin) || (lowTime > gapMax))
+        begin
+            $display("  expected %0d-%0d bit periods", bench.LATCH_BITS, bench.LATCH_BITS + 2);
+            failures = failures + 1;
+        end
+        bench.check_row(firstRow, 0, LEDS, 0, errors);
+        failures = failures + errors;
+
+        // Rows chained by the CISR and NEXT_ROW
+        firstRow = bench.mon.rows;
+        bench.mon.clear_stats;
+        bench.send_rows(ROWS, LEDS);
+        bench.settle;
+        show_us("dead time between rows, min", bench.mon.minReset);
+        show_us("dead time between rows, max", bench.mon.maxReset);
+        if (bench.mon.minReset < gapMin)
+        begin
+            $display("  rows closer than the latch gap");
+            failures = failures + 1;
+        end
+        for (row = 0; row < ROWS; row = row + 1)
+        begin
+            bench.check_row(firstRow + row, row * LEDS, LEDS, 0, errors);
+            failures = failures + errors;
+        end
+
+        // A refill in DONE, without NEXT_ROW, chains after the gap
+        firstRow = bench.mon.rows;
+        bench.mon.clear_stats;
+        bench.start(0, bench.LATCH_BITS);
+        bench.put_led(0);
+        bench.write_control(bench.ENABLE);
+        wait (bench.dut.state == STATE_DONE);
+        bench.put_led(1);
+        repeat (2 * LEDS * 24 * bench.PERIOD) @(posedge bench.clk);
+        bench.settle;
+        show_us("refilled in DONE, gap", bench.mon.minReset);
+        if ((bench.mon.rows - firstRow != 2) || (bench.mon.minReset < gapMin) ||
+            (bench.mon.maxReset > gapMax))
+        begin
+            $display("  %0d rows, expected the second after the latch gap",
+                bench.mon.rows - firstRow);
+            failures = failures + 1;
+        end
+        else
+        begin
+            bench.check_row(firstRow, 0, 1, 0, errors);
+            failures = failures + errors;
+            bench.check_row(firstRow + 1, 1, 1, 0, errors);
+            failures = failures + errors;
+        end
+
+        // Latch register 0: complete at once, and a refill waits for NEXT_ROW
+        firstRow = bench.mon.rows;
+        bench.mon.clear_stats;
+        bench.start(0, 8'h00);
+        bench.put_led(0);
+        bench.write_control(bench.ENABLE | bench.XFRCMPT_IRQ_EN);
+        wait (bench.dut.state == STATE_DONE);
+        wait (bench.cirq);
+        lowTime = $time - bench.mon.lastFall;
+        show_us("latch 0, last bit to complete", lowTime);
+        if (lowTime > bench.BIT_PS)
+        begin
+            $display("  expected under a bit period");
+            failures = failures + 1;
+        end
+        bytesBefore = bench.mon.byteCount;
+        bench.put_led(1);
+        repeat (4 * bench.LATCH_BITS * bench.PERIOD) @(posedge bench.clk);
+        if ((bench.mon.byteCount != bytesBefore) || (bench.dut.state != STATE_DONE))
+        begin
+            $display("  refilled row started without NEXT_ROW");
+            failures = failures + 1;
+        end
+        bench.write_control(bench.ENABLE | bench.NEXT_ROW);
+        bench.write_control(bench.ENABLE);
+        repeat (2 * 24 * bench.PERIOD) @(posedge bench.clk);
+        bench.write_control(8'h00);
+        bench.settle;
+        if (bench.mon.rows - firstRow != 2)
+        begin
+            $display("  %0d rows, expected 2", bench.mon.rows - firstRow);
+            failures = failures + 1;
+        end
+        else
+        begin
+            bench.check_row(firstRow, 0, 1, 0, errors);
+            failures = failures + errors;
+            bench.check_row(firstRow + 1, 1, 1, 0, errors);
+            failures = failures + errors;
+        end
+
+        if (failures == 0)
+            $display("PASS: latch gap and dead time as expected");
+        else
+            $display("FAIL: %0d errors", failures);
+        $finish;
+    end
+endmodule
@@ -0,0 +1,144 @@
+`include "cypress.v"
+
+// The line at a bus clock of CLK_KHZ (run.sh runs 24, 48 and 64 MHz).
+//
+// Rows of LEDs fed by the ISRs a couple of microseconds after each
+//  interrupt must decode exactly, with WS2812 datasheet timing, a reset gap
+//  between rows and no low in a row long enough that some parts would latch
+//  on it. Then the FIFO interrupt is answered later and later, to find how
+//  late it can be before the FIFO runs dry mid-row; and a row starved that
+//  way must show on the line as an early latch, and in the firmware's
+//  underrun count, or a starved display would go unnoticed.
+module ws2811_timing_tb;
+    parameter CLK_KHZ = 24000;
+
+    localparam LEDS = 10;
+    localparam ROWS = 3;
+    localparam CLOCKS_PER_US = CLK_KHZ / 1000;
+    localparam STEP = CLOCKS_PER_US / 2;
+
+    // WS2812: T0H 350 ns, T1H 700 ns, each +/-150 ns; 1250 ns a bit,
+    //  +/-600 ns; reset over 50 us
+    localparam T0H_MIN   = 200000;
+    localparam T0H_MAX   = 500000;
+    localparam T1H_MIN   = 550000;
+    localparam T1H_MAX   = 850000;
+    localparam BIT_MIN   = 650000;
+    localparam BIT_MAX   = 1850000;
+    localparam RESET_MIN = 50000000;
+
+    ws2811_bench #(.CLK_KHZ(CLK_KHZ)) bench ();
+
+    integer failures;
+    integer errors;
+    integer firstRow;
+    integer row;
+    integer start;
+    integer length;
+    integer early;
+    integer latency;
+    integer starved;
+    integer partial;
+
+    initial
+    begin
+        #(64'd200_000_000_000);
+        $display("FAIL: timed out");
+        $finish;
+    end
+
+    // Sends rows at the given ISR latency, with the monitor's timing
+    //  cleared first. The rows the monitor saw start at firstRow; early
+    //  counts those that latched short.
+    task send;
+        input integer rowCount;
+        input integer isrLatency;
+        begin
+            firstRow = bench.mon.rows;
+            partial = bench.mon.partialBytes;
+            bench.mon.clear_stats;
+            bench.isrLatency = isrLatency;
+            bench.start(0, bench.LATCH_BITS);
+            bench.send_rows(rowCount, LEDS);
+            bench.settle;
+            early = 0;
+            for (row = firstRow; row < bench.mon.rows; row = row + 1)
+            begin
+                bench.mon.row_bytes(row, start, length);
+                if (length < 3 * LEDS)
+                    early = early + 1;
+            end
+        end
+    endtask
+
+    initial
+    begin
+        failures = 0;
+        bench.load_pattern;
+        $display("%0d kHz bus clock, %0d clocks a bit", CLK_KHZ, bench.PERIOD);
+
+        send(ROWS, 2 * CLOCKS_PER_US);
+        for (row = 0; row < ROWS; row = row + 1)
+        begin
+            bench.check_row(firstRow + row, row * LEDS, LEDS, 0, errors);
+            failures = failures + errors;
+        end
+        $display("%0d rows of %0d LEDs, ISRs 2 us late: %0d rows latched, %0d bytes wrong",
+            ROWS, LEDS, bench.mon.rows - firstRow, failures);
+        bench.mon.report;
+        if ((bench.mon.minT0H < T0H_MIN) || (bench.mon.maxT0H > T0H_MAX) ||
+            (bench.mon.minT1H < T1H_MIN) || (bench.mon.maxT1H > T1H_MAX))
+        begin
+            $display("  T0H or T1H outside the datasheet");
+            failures = failures + 1;
+        end
+        if ((bench.mon.minBit < BIT_MIN) || (bench.mon.maxBit > BIT_MAX) ||
+            (bench.mon.minByte < BIT_MIN) || (bench.mon.maxByte > BIT_MAX))
+        begin
+            $display("  bit period outside the datasheet");
+            failures = failures + 1;
+        end
+        if (bench.mon.minReset < RESET_MIN)
+        begin
+            $display("  reset gap too short to latch");
+            failures = failures + 1;
+        end
+        if ((bench.mon.longLows != 0) || (bench.underruns != 0) || (early != 0) ||
+            (bench.mon.rows - firstRow != ROWS))
+        begin
+            $display("  starved: %0d long lows, %0d underruns, %0d rows short",
+                bench.mon.longLows, bench.underruns, early);
+            failures = failures + 1;
+        end
+
+        // How late can the FIFO interrupt be answered? The first latency
+        //  that starves a row is the starved case.
+        latency = CLOCKS_PER_US;
+        starved = 0;
+        while (!starved && (latency <= 20 * CLOCKS_PER_US))
+        begin
+            send(1, latency);
+            if ((bench.underruns == 0) && (early == 0) && (bench.mon.rows - firstRow == 1))
+                latency = latency + STEP;
+            else
+                starved = 1;
+        end
+        $display("ISRs up to %0d.%0d us late keep the FIFO fed",
+            (latency - STEP) / CLOCKS_PER_US, ((latency - STEP) % CLOCKS_PER_US) * 10 / CLOCKS_PER_US);
+        $display("starved, ISRs %0d.%0d us late: %0d underruns, %0d of %0d rows latched short, %0d with a byte cut",
+            latency / CLOCKS_PER_US, (latency % CLOCKS_PER_US) * 10 / CLOCKS_PER_US,
+            bench.underruns, early, bench.mon.rows - firstRow, bench.mon.partialBytes - partial);
+        bench.mon.report;
+        if (!starved || (bench.underruns == 0))
+        begin
+            $display("  starvation not flagged");
+            failures = failures + 1;
+        end
+
+        if (failures == 0)
+            $display("PASS: timing within the datasheet, starvation flagged");
+        else
+            $display("FAIL: %0d errors", failures);
+        $finish;
+    end
+endmodule
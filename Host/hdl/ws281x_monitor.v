@@ -0,0 +1,207 @@
+`include "cypress.v"
+
+// A WS281x string's view of a data line. Each rising edge starts a bit,
+//  which is a one if the line stays high longer than THRESHOLD_PS; bits go
+//  into bytes MSB first. The line low for RESET_PS or more is a latch: the
+//  string shows what it's been sent and the next bit starts a new row. Low
+//  for longer than LONG_LOW_PS but not RESET_PS is counted too, as some
+//  parts latch on much shorter gaps than the datasheet reset time.
+//
+// Everything decoded is kept for the testbench to check, with the timing
+//  since clear_stats(). The last row ends with finish(), once the line has
+//  been low for a latch. Times are in ps.
+module ws281x_monitor (
+    input sout
+);
+    parameter THRESHOLD_PS = 458000;    // Between T0H and T1H
+    parameter RESET_PS     = 50000000;  // WS2812 reset time
+    parameter LONG_LOW_PS  = 5000000;
+    parameter MAX_BYTES    = 1024;
+    parameter MAX_ROWS     = 64;
+
+    reg [7:0] bytes [0:MAX_BYTES-1];   // Every byte, in order
+    integer   byteCount;
+    integer   rowEnd [0:MAX_ROWS-1];   // byteCount at each latch
+    integer   rows;
+    integer   partialBytes;            // Latches with a byte part sent
+    integer   longLows;
+
+    time minT0H, maxT0H;
+    time minT1H, maxT1H;
+    time minBit, maxBit;               // Rise to rise, within a byte
+    time minByte, maxByte;             // Last bit of a byte to the next byte
+    time minReset, maxReset;           // Low at a latch, to the next row
+    time maxLow;                       // Longest low that wasn't a latch
+
+    // High time by bit position in the byte and value, {position, bit}:
+    //  the first bit of a byte needn't match the rest, but each position
+    //  should always be the same.
+    time minHigh [0:15];
+    time maxHigh [0:15];
+
+    time    lastRise;
+    time    lastFall;
+    reg     started;
+    reg [7:0] shifter;
+    integer bitCount;
+    time    high;
+    time    low;
+    integer place;
+
+    initial
+    begin
+        byteCount = 0;
+        rows = 0;
+        partialBytes = 0;
+        started = 1'b0;
+        bitCount = 0;
+        lastRise = 0;
+        lastFall = 0;
+        clear_stats;
+    end
+
+    task clear_stats;
+        integer i;
+        begin
+            for (i = 0; i < 16; i = i + 1)
+            begin
+                minHigh[i] = ~64'd0;
+                maxHigh[i] = 0;
+            end
+            minT0H = ~64'd0;
+            maxT0H = 0;
+            minT1H = ~64'd0;
+            maxT1H = 0;
+            minBit = ~64'd0;
+            maxBit = 0;
+            minByte = ~64'd0;
+            maxByte = 0;
+            minReset = ~64'd0;
+            maxReset = 0;
+            maxLow = 0;
+            longLows = 0;
+        end
+    endtask
+
+    task end_row;
+        begin
+            if (bitCount != 0)
+                partialBytes = partialBytes + 1;
+            bitCount = 0;
+            if (rows < MAX_ROWS)
+                rowEnd[rows] = byteCount;
+            rows = rows + 1;
+        end
+    endtask
+
+    // Call with the line low, at least RESET_PS after the last bit.
+    task finish;
+        begin
+            if (started && !sout && ($time - lastFall >= RESET_PS))
+            begin
+                end_row;
+                started = 1'b0;
+            end
+        end
+    endtask
+
+    always @(posedge sout)
+    begin
+        if (started)
+        begin
+            low = $time - lastFall;
+            if (low >= RESET_PS)
+            begin
+                end_row;
+                if (low < minReset) minReset = low;
+                if (low > maxReset) maxReset = low;
+            end
+            else
+            begin
+                if (low > maxLow) maxLow = low;
+                if (low > LONG_LOW_PS)
+                    longLows = longLows + 1;
+                if (bitCount == 0)
+                begin
+                    if ($time - lastRise < minByte) minByte = $time - lastRise;
+                    if ($time - lastRise > maxByte) maxByte = $time - lastRise;
+                end
+                else
+                begin
+                    if ($time - lastRise < minBit) minBit = $time - lastRise;
+                    if ($time - lastRise > maxBit) maxBit = $time - lastRise;
+                end
+            end
+        end
+        started = 1'b1;
+        lastRise = $time;
+    end
+
+    always @(negedge sout)
+    begin
+        lastFall = $time;
+        high = $time - lastRise;
+        place = 2 * bitCount + (high > THRESHOLD_PS);
+        if (high < minHigh[place]) minHigh[place] = high;
+        if (high > maxHigh[place]) maxHigh[place] = high;
+        if (high > THRESHOLD_PS)
+        begin
+            if (high < minT1H) minT1H = high;
+            if (high > maxT1H) maxT1H = high;
+            shifter = {shifter[6:0], 1'b1};
+        end
+        else
+        begin
+            if (high < minT0H) minT0H = high;
+            if (high > maxT0H) maxT0H = high;
+            shifter = {shifter[6:0], 1'b0};
+        end
+        bitCount = bitCount + 1;
+        if (bitCount == 8)
+        begin
+            if (byteCount < MAX_BYTES)
+                bytes[byteCount] = shifter;
+            byteCount = byteCount + 1;
+            bitCount = 0;
+        end
+    end
+
+    // Where row's bytes are in bytes[].
+    task row_bytes;
+        input  integer row;
+        output integer first;
+        output integer count;
+        begin
+            first = (row == 0) ? 0 : rowEnd[row - 1];
+            count = rowEnd[row] - first;
+        end
+    endtask
+
+    // A time in ps as ns, to 0.1 ns.
+    task show;
+        input [8*14-1:0] label;
+        input time minimum;
+        input time maximum;
+        begin
+            if (maximum == 0)
+                $display("  %0s  -", label);
+            else
+                $display("  %0s %0d.%0d - %0d.%0d ns", label,
+                    (minimum + 50) / 1000, ((minimum + 50) % 1000) / 100,
+                    (maximum + 50) / 1000, ((maximum + 50) % 1000) / 100);
+        end
+    endtask
+
+    task report;
+        begin
+            show("T0H          ", minT0H, maxT0H);
+            show("T1H          ", minT1H, maxT1H);
+            show("bit period   ", minBit, maxBit);
+            show("byte to byte ", minByte, maxByte);
+            show("reset gap    ", minReset, maxReset);
+            $display("  longest low %0d.%0d ns, %0d over %0d ns short of a latch",
+                (maxLow + 50) / 1000, ((maxLow + 50) % 1000) / 100,
+                longLows, LONG_LOW_PS / 1000);
+        end
+    endtask
+endmodule
@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Stack and RAM budget report for the GPS clock firmware.
+
+Run it on a PSoC Creator build directory after a build, e.g.
+
+    python3 ram_budget.py ../GPS_Clock.cydsn/CortexM3/ARM_GCC_493/Debug
+
+It needs the .su files that -fstack-usage leaves next to each object (the
+ARM GCC build settings in GPS_Clock.cyprj turn that on), the .map file, and
+the .elf, which it disassembles with arm-none-eabi-objdump to find out who
+calls whom.
+
+The report gives:
+  - the worst-case stack for main() and for each interrupt handler, with the
+    call chain that gets there,
+  - the worst case overall: main's chain, plus the deepest handler on top of
+    it (or every handler stacked up, with --nested),
+  - RAM use by section, from the map file.
+
+It exits non-zero if the worst-case stack doesn't fit the stack the linker
+reserved (or --stack), if there's no stack budget to check against at all,
+or if RAM use is over --ram. GPS_Clock.cyprj runs it as the post-build
+command, so a build that breaks the budget fails; arm-none-eabi-objdump has
+to be on the PATH for that (it's in PSoC Creator's import/gnu/arm/*/bin).
+"""
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+# PSoC 5LP SRAM straddles 0x20000000; on the CY8C5888 it's 64K from here.
+RAM_START = 0x1FFF8000
+RAM_SIZE = 0x10000
+
+# What the core pushes on exception entry, on top of the handler's own frame.
+EXCEPTION_FRAME = 32
+
+ISR_NAME = re.compile(r'(ISR|Isr|_Handler|Interrupt)$')
+
+
+def read_stack_usage(build_dir):
+    """function name -> (bytes, qualifier) from every .su file."""
+    usage = {}
+    for path in glob.glob(os.path.join(build_dir, '**', '*.su'),
+                          recursive=True):
+        with open(path) as su:
+            for line in su:
+                fields = line.rstrip('\n').split('\t')
+                if len(fields) != 3:
+                    continue
+                name = fields[0].rsplit(':', 1)[-1]
+                usage[name] = (int(fields[1]), fields[2])
+    return usage
+
+
+def read_call_graph(elf, objdump):
+    """function name -> set of functions it calls (bl/blx, and b.w tail
+    calls to other functions)."""
+    listing = subprocess.run([objdump, '-d', '--no-show-raw-insn', elf],
+                             check=True, capture_output=True,
+                             text=True).stdout
+    calls = {}
+    current = None
+    header = re.compile(r'^[0-9a-f]+ <([^>]+)>:$')
+    branch = re.compile(r'\s(bl|blx|b\.w|b)\s+[0-9a-f]+ <([^>+]+)>')
+    for line in listing.splitlines():
+        match = header.match(line)
+        if match:
+            current = match.group(1)
+            calls.setdefault(current, set())
+            continue
+        match = branch.search(line)
+        if match and current and match.group(2) != current:
+            calls[current].add(match.group(2))
+    return calls
+
+
+def worst_chain(root, calls, usage, unknown, recursive):
+    """(bytes, [functions]) for the deepest path from root."""
+    memo = {}
+
+    def walk(function, path):
+        if function in path:
+            recursive.add(function)
+            return 0, [function + ' (recursion!)']
+        if function in memo:
+            return memo[function]
+        own, qualifier = usage.get(function, (0, 'unknown'))
+        if function not in usage:
+            unknown.add(function)
+        elif qualifier != 'static':
+            unknown.add(function + ' (' + qualifier + ')')
+        deepest, chain = 0, []
+        for callee in sorted(calls.get(function, ())):
+            depth, sub = walk(callee, path | {function})
+            if depth > deepest or not chain:
+                deepest, chain = depth, sub
+        memo[function] = (own + deepest, [function] + chain)
+        return memo[function]
+
+    return walk(root, frozenset())
+
+
+def read_ram_sections(map_file):
+    """[(section, address, size)] for every output section in RAM."""
+    sections = []
+    line_re = re.compile(r'^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)')
+    pending = None
+    with open(map_file) as mapped:
+        for line in mapped:
+            # Long section names put the address on the following line.
+            if pending and line.startswith(' '):
+                line = pending + line
+            pending = None
+            match = line_re.match(line)
+            if not match:
+                if re.match(r'^\.\S+\s*$', line):
+                    pending = line.rstrip('\n')
+                continue
+            name = match.group(1)
+            address = int(match.group(2), 16)
+            size = int(match.group(3), 16)
+            if size and RAM_START <= address < RAM_START + RAM_SIZE:
+                sections.append((name, address, size))
+    return sections
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('build_dir')
+    parser.add_argument('--objdump', default='arm-none-eabi-objdump')
+    parser.add_argument('--stack', type=int,
+                        help='stack budget in bytes (default: the .stack '
+                             'section from the map file)')
+    parser.add_argument('--ram', type=int, default=RAM_SIZE,
+                        help='RAM budget in bytes (default: %(default)s)')
+    parser.add_argument('--nested', action='store_true',
+                        help='assume every interrupt can nest on top of '
+                             'every other one')
+    args = parser.parse_args()
+
+    elves = glob.glob(os.path.join(args.build_dir, '*.elf'))
+    maps = glob.glob(os.path.join(args.build_dir, '*.map'))
+    if not elves or not maps:
+        sys.exit('no .elf/.map in %s; build first' % args.build_dir)
+
+    usage = read_stack_usage(args.build_dir)
+    if not usage:
+        sys.exit('no .su files in %s; is -fstack-usage on?' % args.build_dir)
+    calls = read_call_graph(elves[0], args.objdump)
+    sections = read_ram_sections(maps[0])
+
+    unknown, recursive = set(), set()
+    roots = ['main'] + sorted(f for f in calls if ISR_NAME.search(f))
+    chains = {root: worst_chain(root, calls, usage, unknown, recursive)
+              for root in roots if root in calls}
+
+    print('Worst-case stack, by entry point:')
+    for root, (depth, chain) in sorted(chains.items(),
+                                       key=lambda item: -item[1][0]):
+        print('  %6d  %s' % (depth, root))
+        print('          ' + ' -> '.join(chain))
+
+    main_depth = chains.get('main', (0, []))[0]
+    isr_depths = [depth + EXCEPTION_FRAME
+                  for root, (depth, _) in chains.items() if root != 'main']
+    if args.nested:
+        worst = main_depth + sum(isr_depths)
+    else:
+        worst = main_depth + max(isr_depths, default=0)
+
+    stack_budget = args.stack
+    if stack_budget is None:
+        stack_budget = sum(size for name, _, size in sections
+                           if name == '.stack')
+    ram_used = sum(size for _, _, size in sections)
+
+    print('\nRAM, by section:')
+    for name, address, size in sections:
+        print('  %6d  %-16s at 0x%08x' % (size, name, address))
+    print('  %6d  total, of %d' % (ram_used, args.ram))
+
+    if unknown:
+        print('\nNo static stack figure for (counted as 0): '
+              + ', '.join(sorted(unknown)))
+
+    print('\nWorst-case stack: %d bytes (main %d + interrupts%s), of %d'
+          % (worst, main_depth, ' nested' if args.nested else '',
+             stack_budget))
+
+    failed = False
+    if recursive:
+        print('FAIL: recursion through ' + ', '.join(sorted(recursive)))
+        failed = True
+    if not stack_budget:
+        print('FAIL: no stack budget; no .stack section in the map file, '
+              'and no --stack')
+        failed = True
+    elif worst > stack_budget:
+        print('FAIL: stack over budget by %d bytes' % (worst - stack_budget))
+        failed = True
+    if ram_used > args.ram:
+        print('FAIL: RAM over budget by %d bytes' % (ram_used - args.ram))
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,115 @@
+#!/bin/sh
+# Builds the clock firmware as a Linux program, gps_clock_sim, against the
+#  simulated hardware in sim.c, and the display code on its own into
+#  render_bench, the sunrise and sunset times into solar_check, and the warm
+#  start records into persist_check. See the top of each for how to run them.
+#
+#   ./build.sh [output directory]      (default: ./build)
+#
+# PSoC Creator makes the StripLights API from the templates in
+#  StripLights_v2_2/API by substituting the instance's parameters; the sed
+#  below does the same, with the parameters as set in TopDesign. Change them
+#  here if they change there.
+#
+# The firmware's own sources build unchanged, with two renames: main()
+#  becomes firmwareMain(), so the simulator can start first, and the
+#  firmware's calls to StripLights_Ready() go through simStripReady(), so
+#  that spinning on it lets simulated time pass.
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+FIRMWARE=$HERE/../../GPS_Clock.cydsn
+OUT=${1:-$HERE/build}
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O2 -g}
+
+# StripLights instance parameters (TopDesign): 84 LEDs on one channel,
+#  800kHz, interrupt transfer, LUT display memory, WS2812.
+LEDS_PER_STRIP=84
+CHANNELS=1
+SPEED=1
+CLOCK_SPEED_KHZ=800
+TRANSFER_METHOD=1
+DISPLAY_MEMORY=${DISPLAY_MEMORY:-1}
+WS281X_TYPE=2
+
+# DISPLAY_MEMORY=0 builds with RGB display memory instead of the LUT, to
+#  compare the two (render_bench -c, and the golden frames, which match in
+#  both).
+
+# The simulator has the ambient light sensor fitted; AMBIENT_SENSOR=0 builds
+#  the clock as it is without one, to compare.
+AMBIENT_SENSOR=${AMBIENT_SENSOR:-1}
+
+# TIMESYNC_MODE=1 builds a master clock, sending time frames out of the UART
+#  (see -o), and 2 a slave, taking them in instead of NMEA (see -u); see
+#  timesync.h. timesync_check.py runs one of each against the other.
+TIMESYNC_MODE=${TIMESYNC_MODE:-0}
+
+mkdir -p "$OUT"
+for template in "$FIRMWARE"/StripLights_v2_2/API/*; do
+  name=$(basename "$template")
+  case $name in
+    SLights.*) generated=StripLights.${name#SLights.} ;;
+    *)         generated=StripLights_$name ;;
+  esac
+  sed -e 's/`$INSTANCE_NAME`/StripLights/g' \
+      -e "s/\`\$LEDs_per_Strip\`/$LEDS_PER_STRIP/g" \
+      -e "s/\`\$Channels\`/$CHANNELS/g" \
+      -e "s/\`\$SPEED\`/$SPEED/g" \
+      -e "s/\`\$ClockSpeedKhz\`/$CLOCK_SPEED_KHZ/g" \
+      -e "s/\`\$Transfer_Method\`/$TRANSFER_METHOD/g" \
+      -e "s/\`\$Display_Memory\`/$DISPLAY_MEMORY/g" \
+      -e "s/\`\$WS281x_Type\`/$WS281X_TYPE/g" \
+      -e 's/\r$//' "$template" > "$OUT/$generated"
+done
+
+INCLUDES="-I$HERE -I$OUT -I$FIRMWARE"
+
+# The component is vendor code; keep its old warnings out of the way.
+for source in "$OUT"/StripLights*.c; do
+  $CC -std=gnu99 $CFLAGS -w $INCLUDES -c "$source" \
+    -o "$OUT/$(basename "$source" .c).o"
+done
+for source in "$FIRMWARE"/*.c; do
+  $CC -std=gnu99 $CFLAGS -Wall $INCLUDES -Dmain=firmwareMain \
+    -DStripLights_Ready=simStripReady -DAMBIENT_SENSOR=$AMBIENT_SENSOR \
+    -DTIMESYNC_MODE=$TIMESYNC_MODE -c "$source" -o "$OUT/fw_$(basename "$source" .c).o"
+done
+$CC -std=gnu99 $CFLAGS -Wall $INCLUDES -c "$HERE/sim.c" -o "$OUT/sim.o"
+$CC $CFLAGS -o "$OUT/gps_clock_sim" "$OUT"/*.o -lm
+echo "$OUT/gps_clock_sim"
+
+# The bench takes the display code and the component, with the edges of the
+#  render path renamed to its own stand-ins.
+mkdir -p "$OUT/bench"
+$CC -std=gnu99 $CFLAGS -Wall $INCLUDES -DStripLights_Trigger=benchTrigger \
+  -DStripLights_Ready=benchReady -DStripLights_FillRow=benchFillRow \
+  -DStripLights_Pixel=benchPixel -DframestreamCapture=benchCapture \
+  -DStripLights_SetPalette=benchSetPalette \
+  -c "$FIRMWARE/ws281x_7seg.c" \
+  -o "$OUT/bench/ws281x_7seg.o"
+$CC -std=gnu99 $CFLAGS -Wall $INCLUDES -c "$HERE/render_bench.c" \
+  -o "$OUT/bench/render_bench.o"
+$CC $CFLAGS -o "$OUT/render_bench" "$OUT"/bench/*.o "$OUT"/StripLights*.o \
+  "$OUT/fw_date_time.o" "$OUT/fw_brightness.o" "$OUT/fw_power.o" \
+  "$OUT/fw_effects.o" "$OUT/fw_trig.o" "$OUT/fw_profile.o" -lm
+echo "$OUT/render_bench"
+
+# The solar times on their own, against solar_reference.txt.
+mkdir -p "$OUT/solar"
+$CC -std=gnu99 $CFLAGS -Wall $INCLUDES -c "$HERE/solar_check.c" \
+  -o "$OUT/solar/solar_check.o"
+$CC $CFLAGS -o "$OUT/solar_check" "$OUT/solar/solar_check.o" \
+  "$OUT/fw_solar.o" "$OUT/fw_trig.o" "$OUT/fw_date_time.o" \
+  "$OUT/fw_profile.o" -lm
+echo "$OUT/solar_check"
+
+# The warm start records, against an EEPROM of its own.
+mkdir -p "$OUT/persist"
+$CC -std=gnu99 $CFLAGS -Wall $INCLUDES -c "$HERE/persist_check.c" \
+  -o "$OUT/persist/persist_check.o"
+$CC $CFLAGS -o "$OUT/persist_check" "$OUT/persist/persist_check.o" \
+  "$OUT/fw_persist.o"
+echo "$OUT/persist_check"
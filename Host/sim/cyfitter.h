@@ -0,0 +1,35 @@
+/******************************************************************************
+*  Stand-in for the cyfitter.h PSoC Creator generates for this design. The
+*   StripLights registers live in the simulated B_WS2811 datapath in sim.c.
+*
+*  The FIFO is the odd one out: every write to it has to be seen, so its
+*   "address" is a call that hands back a fresh slot in the FIFO each time.
+*   The component only ever writes it, which is all that works.
+******************************************************************************/
+
+#ifndef __sim_cyfitter_h__
+#define __sim_cyfitter_h__
+
+#include "cytypes.h"
+#include "sim.h"
+
+// Only feeds the PWM period registers, which the simulation doesn't look
+//  at; bit timing comes from StripLights_BIT_TIME_NS.
+#define BCLK__BUS_CLK__KHZ  24000
+
+#define StripLights_B_WS2811_dshifter_u0__F0_REG         (simStripFifo())
+#define StripLights_B_WS2811_ctrl__CONTROL_REG           (&simStripRegs.control)
+#define StripLights_B_WS2811_StatusReg__STATUS_REG       (&simStripRegs.status)
+#define StripLights_B_WS2811_dimCtrl__CONTROL_REG        (&simStripRegs.dim)
+#define StripLights_B_WS2811_latchCtrl__CONTROL_REG      (&simStripRegs.latch)
+#define StripLights_B_WS2811_pwm8_u0__F0_REG             (&simStripRegs.period)
+#define StripLights_B_WS2811_pwm8_u0__F1_REG             (&simStripRegs.period2)
+#define StripLights_B_WS2811_pwm8_u0__D0_REG             (&simStripRegs.compare0)
+#define StripLights_B_WS2811_pwm8_u0__D1_REG             (&simStripRegs.compare1)
+#define StripLights_B_WS2811_pwm8_u0__DP_AUX_CTL_REG     (&simStripRegs.auxControl)
+#define StripLights_StringSel_Sync_ctrl_reg__CONTROL_REG (&simStripRegs.stringSel)
+
+#define StripLights_CIRQ__INTC_NUMBER  0
+#define StripLights_FIRQ__INTC_NUMBER  1
+
+#endif
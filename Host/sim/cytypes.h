@@ -0,0 +1,33 @@
+/******************************************************************************
+*  Stand-in for PSoC Creator's cytypes.h, for building the clock firmware on
+*   Linux (see build.sh). Just the types and macros the firmware and the
+*   StripLights component use.
+******************************************************************************/
+
+#ifndef __sim_cytypes_h__
+#define __sim_cytypes_h__
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t   int8;
+typedef int16_t  int16;
+typedef int32_t  int32;
+typedef char     char8;
+
+typedef volatile uint8  reg8;
+typedef volatile uint16 reg16;
+typedef volatile uint32 reg32;
+
+#define CY_PSOC3    0
+#define CY_PSOC4    0
+#define CY_PSOC5LP  1
+
+#define CY_ISR(name)        void name(void)
+#define CY_ISR_PROTO(name)  void name(void)
+typedef void (*cyisraddress)(void);
+
+#endif
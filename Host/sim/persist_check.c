@@ -0,0 +1,325 @@
+/******************************************************************************
+*  persist_check - checks the warm start records (persist.c) against an
+*   EEPROM in memory: the row layout, that a bad CRC is never loaded, that
+*   saves go round the slots and the newest good one wins, and how often
+*   each row gets written.
+*
+*  Build:  ./build.sh            (leaves build/persist_check)
+*  Usage:  persist_check
+*
+*  The record is written to the EEPROM as it sits in memory, so its layout
+*   is the PSoC's; the layout check is there to catch a field added in a way
+*   that moves the others, which would lose every clock's saved time on the
+*   next firmware update.
+*
+*  Every single bit flip in the newest row, and a row written only partway,
+*   must leave the row before it to be loaded. The wear figures run a month
+*   of one update a second, as the GPS gives, with the brightness steady and
+*   then changing every few minutes, as the light sensor might.
+******************************************************************************/
+
+#include "persist.h"
+#include "project.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DAYS              30
+#define SECONDS_PER_DAY   86400
+#define RATED_WRITES      1000000.0
+#define BRIGHTNESS_MINUTES 5
+
+/*****************************************************************************
+*  The EEPROM, as the firmware sees it.
+*****************************************************************************/
+
+uint8 simEeprom[CY_EEPROM_SIZE];
+static uint32_t rowWrites[CY_EEPROM_SIZE / CY_EEPROM_SIZEOF_ROW];
+static int lastRow = -1;
+
+void CyEEPROM_Start(void)
+{
+}
+
+uint8 CySetTemp(void)
+{
+  return CYRET_SUCCESS;
+}
+
+uint8 CyWriteRowData(uint8 arrayId, uint16 rowAddress, const uint8* rowData)
+{
+  (void)arrayId;
+  if ((uint32_t)(rowAddress + 1) * CY_EEPROM_SIZEOF_ROW > CY_EEPROM_SIZE)
+  {
+    return CYRET_UNKNOWN;
+  }
+  memcpy(&simEeprom[rowAddress * CY_EEPROM_SIZEOF_ROW], rowData,
+    CY_EEPROM_SIZEOF_ROW);
+  rowWrites[rowAddress]++;
+  lastRow = rowAddress;
+  return CYRET_SUCCESS;
+}
+
+static void eraseEeprom(uint8_t value)
+{
+  memset(simEeprom, value, sizeof(simEeprom));
+  memset(rowWrites, 0, sizeof(rowWrites));
+  lastRow = -1;
+}
+
+static uint8_t* row(uint8_t slot)
+{
+  return &simEeprom[(PERSIST_ROW + slot) * CY_EEPROM_SIZEOF_ROW];
+}
+
+/*****************************************************************************
+*  The checks.
+*****************************************************************************/
+
+static unsigned failures;
+
+static void check(bool good, const char* what)
+{
+  if (!good)
+  {
+    printf("  FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// What timeArrived() offers persistUpdate().
+static persistRecord offer(uint32_t epoch, int8_t zone, uint8_t brightness)
+{
+  persistRecord record;
+  memset(&record, 0xA5, sizeof(record));
+  record.epoch = epoch;
+  record.tickRate = 25600000;
+  record.zone = zone;
+  record.brightness = brightness;
+  return record;
+}
+
+// Plants a good record straight into a slot, as an older firmware might
+//  have left it.
+static void plant(uint8_t slot, uint32_t epoch, uint16_t seq)
+{
+  persistRecord record = offer(epoch, -7, 128);
+  record.seq = seq;
+  record.spare = 0;
+  record.dim = 0;
+  record.crc = persistCRC((const uint8_t*)&record,
+    PERSIST_RECORD_SIZE - sizeof(record.crc));
+  memcpy(row(slot), &record, sizeof(record));
+}
+
+// The epoch a fresh boot would start from, or 0 if it finds nothing.
+static uint32_t bootEpoch(void)
+{
+  persistRecord record;
+  return persistLoad(&record) ? record.epoch : 0;
+}
+
+static void checkLayout(void)
+{
+  static const uint8_t digits[] = "123456789";
+  persistRecord record;
+
+  printf("layout: %u bytes, CRC of \"123456789\" %04X\n",
+    (unsigned)sizeof(persistRecord), persistCRC(digits, 9));
+  check(sizeof(persistRecord) == PERSIST_RECORD_SIZE, "record size");
+  check(PERSIST_RECORD_SIZE == CY_EEPROM_SIZEOF_ROW, "record isn't a row");
+  check(offsetof(persistRecord, epoch) == 0, "epoch moved");
+  check(offsetof(persistRecord, tickRate) == 4, "tickRate moved");
+  check(offsetof(persistRecord, seq) == 8, "seq moved");
+  check(offsetof(persistRecord, zone) == 10, "zone moved");
+  check(offsetof(persistRecord, spare) == 11, "spare moved");
+  check(offsetof(persistRecord, dim) == 12, "dim moved");
+  check(offsetof(persistRecord, brightness) == 13, "brightness moved");
+  check(offsetof(persistRecord, crc) == 14, "crc moved");
+  // CRC-16/CCITT-FALSE's check value
+  check(persistCRC(digits, 9) == 0x29B1, "not CRC-16/CCITT");
+
+  // Blank and erased EEPROM hold nothing
+  eraseEeprom(0x00);
+  check(!persistLoad(&record), "loaded from a blank EEPROM");
+  eraseEeprom(0xFF);
+  check(!persistLoad(&record), "loaded from an erased EEPROM");
+
+  // What's written is the record, CRC last, low byte first
+  record = offer(1000000, -7, 200);
+  persistUpdate(&record);
+  check(lastRow == PERSIST_ROW, "first save not in the first slot");
+  check(memcmp(row(0), &record, sizeof(record)) == 0, "row isn't the record");
+  check((row(0)[14] | (row(0)[15] << 8)) == persistCRC(row(0), 14),
+    "CRC not over the first 14 bytes");
+  check((row(0)[11] == 0) && (row(0)[12] == 0), "spare and dim not 0");
+}
+
+static void checkRotation(void)
+{
+  persistRecord record;
+  uint32_t epoch = 1000000;
+  unsigned save;
+  unsigned wrongSlot = 0;
+  unsigned wrongLoad = 0;
+
+  eraseEeprom(0xFF);
+  persistLoad(&record);
+  for (save = 0; save < 3 * PERSIST_SLOTS; save++)
+  {
+    record = offer(epoch, -7, 200);
+    persistUpdate(&record);
+    wrongSlot += (lastRow != (int)(PERSIST_ROW + (save % PERSIST_SLOTS)));
+    wrongLoad += (bootEpoch() != epoch);
+    epoch += PERSIST_INTERVAL;
+  }
+  printf("rotation: %u saves, %u in the wrong slot, %u not loaded back\n",
+    save, wrongSlot, wrongLoad);
+  check((wrongSlot == 0) && (wrongLoad == 0), "saves don't rotate");
+
+  // Too soon to save again, unless the zone or brightness changes
+  epoch -= PERSIST_INTERVAL;
+  lastRow = -1;
+  record = offer(epoch + PERSIST_INTERVAL - 1, -7, 200);
+  persistUpdate(&record);
+  check(lastRow == -1, "saved within the interval");
+  record = offer(epoch + 1, -8, 200);
+  persistUpdate(&record);
+  check(lastRow != -1, "zone change not saved");
+  lastRow = -1;
+  record = offer(epoch + 2, -8, 100);
+  persistUpdate(&record);
+  check(lastRow != -1, "brightness change not saved");
+
+  // Sequence numbers wrap; 0 comes after 0xFFFF
+  eraseEeprom(0xFF);
+  plant(3, 2000, 0xFFFE);
+  plant(4, 3000, 0xFFFF);
+  plant(5, 4000, 0x0000);
+  plant(6, 1000, 0xFFFD);
+  check(bootEpoch() == 4000, "newest record lost across the wrap");
+  record = offer(4000 + PERSIST_INTERVAL, -7, 128);
+  persistUpdate(&record);
+  check((lastRow == PERSIST_ROW + 6) && (record.seq == 1),
+    "save after the wrap not in the next slot");
+  check(bootEpoch() == 4000 + PERSIST_INTERVAL,
+    "save after the wrap not loaded back");
+}
+
+static void checkCorruption(void)
+{
+  persistRecord record;
+  uint8_t saved[PERSIST_RECORD_SIZE];
+  unsigned bit;
+  unsigned loaded = 0;
+  uint32_t epoch = 1000000;
+  uint8_t save;
+
+  eraseEeprom(0xFF);
+  persistLoad(&record);
+  for (save = 0; save < PERSIST_SLOTS + 2; save++)
+  {
+    record = offer(epoch, -7, 200);
+    persistUpdate(&record);
+    epoch += PERSIST_INTERVAL;
+  }
+  epoch -= PERSIST_INTERVAL;
+  uint8_t newest = lastRow - PERSIST_ROW;
+  memcpy(saved, row(newest), sizeof(saved));
+
+  // Every single bit flip in the newest row
+  for (bit = 0; bit < 8 * PERSIST_RECORD_SIZE; bit++)
+  {
+    row(newest)[bit / 8] ^= 1 << (bit % 8);
+    loaded += (bootEpoch() == epoch);
+    check(bootEpoch() == epoch - PERSIST_INTERVAL,
+      "row before a bad one not loaded");
+    memcpy(row(newest), saved, sizeof(saved));
+  }
+  printf("corruption: %u single bit flips, %u loaded\n", bit, loaded);
+  check(loaded == 0, "bad CRC loaded");
+
+  // A save cut short, after a clean boot: the new record's first half over
+  //  what its slot held
+  uint8_t old[PERSIST_RECORD_SIZE];
+  uint8_t cut = (newest + 1) % PERSIST_SLOTS;
+  bootEpoch();
+  memcpy(old, row(cut), sizeof(old));
+  record = offer(epoch + PERSIST_INTERVAL, -7, 200);
+  persistUpdate(&record);
+  check(lastRow == PERSIST_ROW + cut, "save not in the next slot");
+  memcpy(row(cut) + PERSIST_RECORD_SIZE / 2, old + PERSIST_RECORD_SIZE / 2,
+    PERSIST_RECORD_SIZE / 2);
+  printf("torn write: %s\n", (bootEpoch() == epoch) ? "previous row loaded" :
+    "wrong row loaded");
+  check(bootEpoch() == epoch, "half written row loaded");
+}
+
+// A month of one update a second. The brightness steps between two levels
+//  every changeMinutes, or never at 0.
+static void runWear(unsigned changeMinutes)
+{
+  persistRecord record;
+  uint32_t epoch = 1000000;
+  uint32_t second;
+  uint32_t most = 0;
+  uint32_t least = ~0u;
+  uint32_t total = 0;
+  uint8_t brightness = 200;
+  uint8_t slot;
+
+  eraseEeprom(0xFF);
+  persistLoad(&record);
+  for (second = 0; second < DAYS * SECONDS_PER_DAY; second++)
+  {
+    if (changeMinutes && (second % (changeMinutes * 60) == 0))
+    {
+      brightness = (brightness == 200) ? 100 : 200;
+    }
+    record = offer(epoch + second, -7, brightness);
+    persistUpdate(&record);
+  }
+  for (slot = 0; slot < PERSIST_SLOTS; slot++)
+  {
+    total += rowWrites[PERSIST_ROW + slot];
+    most = (rowWrites[PERSIST_ROW + slot] > most) ?
+      rowWrites[PERSIST_ROW + slot] : most;
+    least = (rowWrites[PERSIST_ROW + slot] < least) ?
+      rowWrites[PERSIST_ROW + slot] : least;
+  }
+  double perDay = (double)most / DAYS;
+  if (changeMinutes)
+  {
+    printf("wear, brightness changing every %u minutes:", changeMinutes);
+  }
+  else
+  {
+    printf("wear, brightness steady:");
+  }
+  printf(" %u writes in %u days, at most %.1f a row a day, %.0f years to "
+    "%.0fk\n", total, DAYS, perDay, RATED_WRITES / (perDay * 365.25),
+    RATED_WRITES / 1000);
+  check(most - least <= 1, "writes not spread over the rows");
+  if (!changeMinutes)
+  {
+    check(most <= (DAYS * SECONDS_PER_DAY / PERSIST_INTERVAL +
+      PERSIST_SLOTS - 1) / PERSIST_SLOTS, "saved more often than the interval");
+  }
+}
+
+int main(void)
+{
+  checkLayout();
+  checkRotation();
+  checkCorruption();
+  runWear(0);
+  runWear(BRIGHTNESS_MINUTES);
+  if (failures)
+  {
+    printf("%u checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks pass\n");
+  return 0;
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+*  Stand-in for the project.h PSoC Creator generates for this design: the
+*   APIs of every component the firmware uses, implemented by the simulated
+*   hardware in sim.c. Signatures follow the generated code, so the firmware
+*   builds against this unchanged.
+******************************************************************************/
+
+#ifndef __sim_project_h__
+#define __sim_project_h__
+
+#include "cytypes.h"
+#include "cyfitter.h"
+#include "sim.h"
+#include "StripLights.h"
+#include "StripLights_fonts.h"
+#include <string.h>  // CyLib.h brings this in on the target
+
+// CyLib
+#define CyGlobalIntEnable  do { } while (0)
+#define CY_PM_WFI          simSleep()
+void CyDelay(uint32 milliseconds);
+void CyDelayUs(uint16 microseconds);
+void CyIntEnable(uint8 number);
+void CyIntDisable(uint8 number);
+uint8 CyEnterCriticalSection(void);
+void CyExitCriticalSection(uint8 savedIntrStatus);
+
+// SysTick
+#define CY_SYS_SYST_CSR_CLK_SRC_SYSCLK  1u
+#define CY_SYS_SYST_CSR_CLK_SRC_LFCLK   0u
+void CySysTickSetClockSource(uint32 clockSource);
+void CySysTickSetReload(uint32 value);
+void CySysTickClear(void);
+void CySysTickEnable(void);
+void CySysTickDisableInterrupt(void);
+uint32 CySysTickGetValue(void);
+
+// Cortex-M3 debug block, for the cycle counter. profile.h counts host time
+//  itself under __linux__, so these only have to be somewhere to write.
+typedef struct { volatile uint32 CTRL; volatile uint32 CYCCNT; } DWT_Type;
+typedef struct { volatile uint32 DEMCR; } CoreDebug_Type;
+extern DWT_Type simDWT;
+extern CoreDebug_Type simCoreDebug;
+#define DWT                         (&simDWT)
+#define CoreDebug                   (&simCoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk      (1u << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1u << 24)
+
+// EEPROM: the CY8C5888's 2K, in 16-byte rows.
+#define CY_EEPROM_SIZE          2048u
+#define CY_EEPROM_SIZEOF_ROW    16u
+#define CY_EEPROM_BASE_ARRAY    0x40u
+#define CY_EEPROM_BASE          ((uintptr_t)simEeprom)
+#define CYRET_SUCCESS           0x00u
+#define CYRET_UNKNOWN           0x03u
+extern uint8 simEeprom[CY_EEPROM_SIZE];
+void CyEEPROM_Start(void);
+uint8 CySetTemp(void);
+uint8 CyWriteRowData(uint8 arrayId, uint16 rowAddress, const uint8* rowData);
+
+// UART (the GPS, or the master clock's time frames)
+void UART_Start(void);
+uint8 UART_ReadRxData(void);
+uint16 UART_GetRxBufferSize(void);
+void UART_ClearRxBuffer(void);
+void UART_PutArray(const uint8 string[], uint8 byteCount);
+
+// ClockTick timer, and its interrupt
+void ClockTick_Start(void);
+void ClockTick_WritePeriod(uint16 period);
+uint16 ClockTick_ReadPeriod(void);
+uint16 ClockTick_ReadCounter(void);
+void ClockTick_WriteCounter(uint16 counter);
+void ClockTickInt_StartEx(cyisraddress address);
+
+// The external string mux
+void StripChannelSelect_Write(uint8 value);
+
+// LightSensor, an ADC_SAR on the ambient light sensor (see ambient.h)
+void LightSensor_Start(void);
+void LightSensor_StartConvert(void);
+int16 LightSensor_GetResult16(void);
+
+// StripLights' own interrupts
+void StripLights_cisr_StartEx(cyisraddress address);
+void StripLights_fisr_StartEx(cyisraddress address);
+
+// USBUART
+#define USBUART_3V_OPERATION  0x00u
+#define USBUART_5V_OPERATION  0x01u
+void USBUART_Start(uint8 device, uint8 mode);
+uint8 USBUART_GetConfiguration(void);
+uint8 USBUART_IsConfigurationChanged(void);
+uint8 USBUART_CheckActivity(void);
+void USBUART_CDC_Init(void);
+uint8 USBUART_CDCIsReady(void);
+uint8 USBUART_DataIsReady(void);
+uint16 USBUART_GetAll(uint8* pData);
+void USBUART_PutData(const uint8* pData, uint16 length);
+void USBUART_PutString(const char8* string);
+
+#endif
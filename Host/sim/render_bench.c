@@ -0,0 +1,1086 @@
+/******************************************************************************
+*  render_bench - renders every second of some whole days through the
+*   firmware's display code, checks each frame against a golden set, and
+*   times it.
+*
+*  Build:  ./build.sh            (leaves build/render_bench)
+*  Usage:  render_bench [-w] [-r repeats] golden.txt
+*          render_bench -d
+*          render_bench -e
+*          render_bench -c
+*          render_bench -s
+*    -w           Write the golden set instead of checking against it
+*    -r repeats   Render the days this many times over, for steadier timings
+*    -d           Sweep the brightness levels and measure the dithering
+*    -e           Time each of the effects (effects.c)
+*    -c           Measure what a change of digit color costs
+*    -s           Time the span fills against the pixel at a time drawing
+*
+*  The render path is the one the clock runs: writeTime() (DST bump, 12 or
+*   24 hour), then queueDisplay() and serviceDisplay() for all six digits
+*   and the colons, into StripLights' LED memory. The component's own
+*   FillRow() and friends do the drawing; only the edges are stood in for.
+*   Trigger() captures the row as the string would get it (colors, after the
+*   palette in LUT mode), Ready() is always true, and the pixel writes are
+*   counted on the way in.
+*
+*  The days are chosen to take in standard time, DST, and both changeover
+*   days, so the DST hour bump and its wrap past midnight both get drawn.
+*   Each frame is hashed (FNV-1a, 64 bit), and the golden file holds one
+*   hash per hour of frames per mode, so a mismatch says where to look.
+*   Refactor the render path, run this, and it's pixel-identical if it says
+*   so. The days are drawn at full brightness, where every dither shade is
+*   the same color, so the golden set holds whatever DITHER_SHADES is.
+*
+*  Each frame's strings are also checked against StripLights' running drive
+*   (StripLights_RowDrive()), which should always equal the sum of the bytes
+*   the row goes out with; one that doesn't fails the run, as a frame would.
+*   What keeping it costs a pixel write is timed against plain stores. The
+*   power limit is off here; the simulator exercises it.
+*
+*  -d draws all eights at every brightness level, over enough sends for the
+*   LEDs to go round all the shades, and averages the drive the digits'
+*   LEDs get: the light the eye sees, once the sends blur together. Next to
+*   it goes the drive with no dithering (brightnessApply()), and the exact
+*   drive the level asks for. As the phase moves on with every send, it
+*   also checks that a new time only sends the digits that changed
+*   (queueChangedDigits()), and fails if not. Build with -DDITHER_SHADES=1
+*   to time the render path without it.
+*
+*  -e draws all eights, every segment lit, in each effect, a frame at a time
+*   with the effect moved on 16 ms each frame, and gives the lit pixels drawn
+*   a second and the mean and worst time a frame (all six digits). The
+*   frames are all drawn EFFECT_PASSES times over and each one's quickest
+*   taken, so the worst is the effect's and not the host's; the digits over
+*   budget come from that one too, and are in ns here, as cycleCount() is
+*   on a host build.
+*   The strings aren't hashed. LUT display memory draws palette indices and
+*   rewrites the effect's palette entries each frame; RGB works out every LED.
+*
+*  -c gives the display memory the build has, and times a change of digit
+*   color the way the clock makes one (a theme change, or a brightness step):
+*   setDigitColor(), then all six digits drawn and sent again. It counts the
+*   stores each part makes too, which unlike host nanoseconds carry over to
+*   the PSoC. In LUT display memory the LEDs take the new color from the
+*   palette writes alone, and the redraw is only the one the clock does
+*   every second anyway; in RGB it's the redraw that changes the color.
+*   Build once each way (see build.sh) to compare.
+*
+*  -s times clearing LED memory, filling a rectangle and sending the six
+*   digits, with StripLights as it is and as it was before FillRow() and
+*   the other span fills: MemClear() storing every pixel twice, DrawRect()
+*   filling a column at a time through DrawLine() and Pixel(), and the
+*   digits drawn a Pixel() call per LED, as the old updateDisplay() did.
+*   The old component's functions are copied in here. The digits go through
+*   the clock's render path either way, with each FillRow() made a Pixel()
+*   call per LED for the old. The old MemClear() and DrawRect() keep no
+*   running drive, so build with -DStripLights_TRACK_DRIVE=0 to compare
+*   those like with like.
+******************************************************************************/
+
+#include "project.h"
+#include "ambient.h"
+#include "brightness.h"
+#include "date_time.h"
+#include "effects.h"
+#include "power.h"
+#include "scheduler.h"
+#include "ws281x_7seg.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The renames build.sh gives ws281x_7seg.c for this program.
+void benchFillRow(int32 x0, int32 x1, int32 y, uint32 color);
+void benchPixel(int32 x, int32 y, uint32 color);
+void benchTrigger(uint32 blank);
+uint32 benchReady(void);
+void benchCapture(uint8_t stringIndex);
+void benchSetPalette(uint32 index, uint32 color);
+
+#define FNV_OFFSET  14695981039346656037ULL
+#define FNV_PRIME   1099511628211ULL
+
+// The digits' color, as opposed to what their pixels hold.
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  #define DIGIT_WHITE  StripLights_CLUT[StripLights_WHITE]
+#else
+  #define DIGIT_WHITE  StripLights_WHITE
+#endif
+
+#define HOURS_PER_DAY     24
+#define SECONDS_PER_DAY   86400
+
+static const struct { int8_t year; int8_t month; int8_t day; } days[] =
+{
+  { 24,  1, 15 },   // Standard time
+  { 24,  3, 10 },   // DST starts at 0200
+  { 24,  7,  4 },   // DST all day
+  { 24, 11,  3 },   // DST ends at 0200
+};
+#define NUM_DAYS (sizeof(days) / sizeof(days[0]))
+
+static const bool modes[] = { true, false }; // 24 hour, then 12
+#define NUM_MODES (sizeof(modes) / sizeof(modes[0]))
+
+static uint64_t hourHashes[NUM_MODES][NUM_DAYS][HOURS_PER_DAY];
+
+// What the render path has done this frame.
+static uint64_t frameHash;
+static uint32_t pixelWrites;
+static uint32_t paletteWrites;
+static uint32_t strings;
+static uint8_t channel;
+
+// Rows whose running drive didn't match the bytes they went out with.
+static uint32_t driveChecks;
+static uint32_t driveMismatches;
+
+// Strings go out uncaptured while timing.
+static bool timing;
+
+// Fill a pixel at a time, as StripLights did before it had span fills (-s).
+static bool pixelAtATime;
+
+// The digits' drive, summed over the frames, when measuring the dither.
+static bool measuring;
+static uint64_t driveSum;
+static uint32_t driveCount;
+
+/*****************************************************************************
+*  The edges of the render path.
+*****************************************************************************/
+
+void benchFillRow(int32 x0, int32 x1, int32 y, uint32 color)
+{
+  pixelWrites += (x1 >= x0) ? (uint32_t)(x1 - x0 + 1) : 0;
+  if (pixelAtATime)
+  {
+    for ( ; x0 <= x1; x0++)
+    {
+      StripLights_Pixel(x0, y, color);
+    }
+    return;
+  }
+  StripLights_FillRow(x0, x1, y, color);
+}
+
+void benchPixel(int32 x, int32 y, uint32 color)
+{
+  pixelWrites++;
+  StripLights_Pixel(x, y, color);
+}
+
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+void benchSetPalette(uint32 index, uint32 color)
+{
+  paletteWrites++;
+  StripLights_SetPalette(index, color);
+}
+#endif
+
+void StripChannelSelect_Write(uint8 value)
+{
+  channel = value;
+}
+
+// The row goes out to whichever string the mux has selected; fold the
+//  string number and its colors into the frame's hash.
+void benchTrigger(uint32 blank)
+{
+  uint16_t led;
+  uint32_t drive = 0;
+  (void)blank;
+
+  strings++;
+  if (timing)
+  {
+    return;
+  }
+  frameHash = (frameHash ^ channel) * FNV_PRIME;
+  for (led = 0; led < StripLights_COLUMNS; led++)
+  {
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    uint32_t color = StripLights_palette[StripLights_ledArray[0][led]];
+#else
+    uint32_t color = StripLights_ledArray[0][led];
+#endif
+    frameHash = (frameHash ^ (uint8_t)color) * FNV_PRIME;
+    frameHash = (frameHash ^ (uint8_t)(color >> 8)) * FNV_PRIME;
+    frameHash = (frameHash ^ (uint8_t)(color >> 16)) * FNV_PRIME;
+    drive += StripLights_ColorDrive(color);
+    // White, so any one byte will do.
+    if (measuring && (channel < NUM_DIGITS) && (led < LEDS_PER_DIGIT))
+    {
+      driveSum += (uint8_t)color;
+      driveCount++;
+    }
+  }
+  driveChecks++;
+  driveMismatches += (drive != StripLights_RowDrive(0));
+}
+
+uint32 benchReady(void)
+{
+  return 1;
+}
+
+// Every transfer is done at once, so none ever times out.
+uint32_t schedulerUptime(void)
+{
+  return 0;
+}
+
+// Nobody's watching over USB here.
+void benchCapture(uint8_t stringIndex)
+{
+  (void)stringIndex;
+}
+
+// The rest of what the component links against; nothing here starts it.
+simStripRegisters simStripRegs;
+static uint8_t fifoSink;
+
+volatile uint8_t* simStripFifo(void)
+{
+  return &fifoSink;
+}
+
+void StripLights_cisr_StartEx(cyisraddress address)
+{
+  (void)address;
+}
+
+void StripLights_fisr_StartEx(cyisraddress address)
+{
+  (void)address;
+}
+
+// profile.c's, in a PROFILING=1 build. No interrupts here to keep out.
+uint8 CyEnterCriticalSection(void)
+{
+  return 0;
+}
+
+void CyExitCriticalSection(uint8 savedIntrStatus)
+{
+  (void)savedIntrStatus;
+}
+
+/*****************************************************************************
+*  The days.
+*****************************************************************************/
+
+static double secondsSince(const struct timespec* start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) +
+    ((double)(end.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+// Renders every second of every day in one mode, and returns the seconds it
+//  took; the pixel writes and strings sent go on the running totals.
+static double renderMode(uint8_t mode, uint64_t* totalPixels,
+  uint64_t* totalStrings)
+{
+  static bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT];
+  uint32_t digitColors[NUM_DIGITS];
+  struct timespec start;
+  uint8_t dayIndex;
+  uint8_t digit;
+
+  for (digit = 0; digit < NUM_DIGITS; digit++)
+  {
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    digitColors[digit] = DIGIT_PALETTE_INDEX;
+#else
+    digitColors[digit] = StripLights_WHITE;
+#endif
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (dayIndex = 0; dayIndex < NUM_DAYS; dayIndex++)
+  {
+    date_time midnight;
+    uint32_t second;
+    uint64_t hourHash = FNV_OFFSET;
+
+    memset(&midnight, 0, sizeof(midnight));
+    midnight.year = days[dayIndex].year;
+    midnight.month = days[dayIndex].month;
+    midnight.day = days[dayIndex].day;
+    uint32_t epoch = dateTimeToEpoch(&midnight);
+
+    for (second = 0; second < SECONDS_PER_DAY; second++)
+    {
+      date_time local;
+      epochToDateTime(epoch + second, &local);
+
+      frameHash = FNV_OFFSET;
+      pixelWrites = 0;
+      strings = 0;
+      writeTime(segmentValues, &local, dstCheck(&local), modes[mode]);
+      queueDisplay(DIGIT_STRINGS | COLON_STRINGS);
+      while (serviceDisplay(digitColors, segmentValues, (second & 1) == 0))
+      {
+        displayTransferDone();
+      }
+      *totalPixels += pixelWrites;
+      *totalStrings += strings;
+
+      hourHash = (hourHash ^ frameHash) * FNV_PRIME;
+      if ((second % 3600) == 3599)
+      {
+        hourHashes[mode][dayIndex][second / 3600] = hourHash;
+        hourHash = FNV_OFFSET;
+      }
+    }
+  }
+  return secondsSince(&start);
+}
+
+/*****************************************************************************
+*  The dithering.
+*****************************************************************************/
+
+// Sends enough to get every digit LED round every shade, for any
+//  DITHER_SHADES up to 8.
+#define DITHER_FRAMES 8
+
+// Sends every digit that's queued, as the clock's display task would.
+static void sendDigits(const uint32_t* digitColors,
+  bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT])
+{
+  queueDisplay(DIGIT_STRINGS);
+  while (serviceDisplay(digitColors, segmentValues, true))
+  {
+    displayTransferDone();
+  }
+}
+
+// The average drive of a lit digit LED at this level, over DITHER_FRAMES.
+static double ditheredDrive(uint8_t level, const uint32_t* digitColors,
+  bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT])
+{
+  uint8_t frame;
+
+  brightnessSet(level);
+  setDigitColor(DIGIT_WHITE);
+  driveSum = 0;
+  driveCount = 0;
+  for (frame = 0; frame < DITHER_FRAMES; frame++)
+  {
+    sendDigits(digitColors, segmentValues);
+  }
+  return (double)driveSum / driveCount;
+}
+
+// The strings a new time sends, once the digits have gone out: none when
+//  nothing has changed, and one when a digit has.
+static bool changedDigitsOnly(const uint32_t* digitColors,
+  bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT])
+{
+  uint32_t unchanged;
+  uint32_t oneChanged;
+
+  strings = 0;
+  queueChangedDigits(segmentValues);
+  while (serviceDisplay(digitColors, segmentValues, true))
+  {
+    displayTransferDone();
+  }
+  unchanged = strings;
+  writeDigit(segmentValues[0], 7);
+  strings = 0;
+  queueChangedDigits(segmentValues);
+  while (serviceDisplay(digitColors, segmentValues, true))
+  {
+    displayTransferDone();
+  }
+  oneChanged = strings;
+  writeDigit(segmentValues[0], 8);
+  sendDigits(digitColors, segmentValues);
+  printf("a new time sends %u strings with no digit changed, %u with one\n",
+    unchanged, oneChanged);
+  return (unchanged == 0) && (oneChanged == 1);
+}
+
+// Prints how the dithered and plain drives track the exact one: how many
+//  different levels of light come out, the biggest jump between one level
+//  and the next as a share of the light, and how many levels look the same
+//  as the one below. Over every level down to the old dimmest setting
+//  (below that a lot of them round to nothing either way), and over the
+//  night ones the ambient light sensor uses.
+static int measureDither(void)
+{
+  static bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT];
+  uint32_t digitColors[NUM_DIGITS];
+  double dithered[BRIGHTNESS_MAX + 1];
+  double plain[BRIGHTNESS_MAX + 1];
+  double exact[BRIGHTNESS_MAX + 1];
+  struct timespec start;
+  uint8_t digit;
+  int level;
+  int range;
+
+  for (digit = 0; digit < NUM_DIGITS; digit++)
+  {
+    writeDigit(segmentValues[digit], 8);
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    digitColors[digit] = DIGIT_PALETTE_INDEX;
+#else
+    digitColors[digit] = StripLights_WHITE;
+#endif
+  }
+
+  measuring = true;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (level = 0; level <= BRIGHTNESS_MAX; level++)
+  {
+    dithered[level] = ditheredDrive(level, digitColors, segmentValues);
+  }
+  double took = secondsSince(&start);
+  measuring = false;
+  for (level = 0; level <= BRIGHTNESS_MAX; level++)
+  {
+    brightnessSet(level);
+    plain[level] = (uint8_t)brightnessApply(DIGIT_WHITE);
+    // What the tables are built from: 255 * (level / 255) ^ 2.2.
+    exact[level] = 255.0 * pow(level / 255.0, 2.2);
+  }
+
+  printf("%d dither shades, %d sends a level, %.2f us a digit sent\n",
+    DITHER_SHADES, DITHER_FRAMES,
+    (took * 1e6) / ((BRIGHTNESS_MAX + 1.0) * DITHER_FRAMES * NUM_DIGITS));
+  bool changedOnly = changedDigitsOnly(digitColors, segmentValues);
+  for (range = 0; range < 2; range++)
+  {
+    int low = (range == 0) ? brightnessFromDim(7) : AMBIENT_MIN_BRIGHTNESS;
+    int high = (range == 0) ? BRIGHTNESS_MAX : 2 * AMBIENT_MIN_BRIGHTNESS;
+    const double* drives[2] = { plain, dithered };
+    const char* names[2] = { "plain", "dithered" };
+    int which;
+
+    printf("levels %d-%d:\n", low, high);
+    for (which = 0; which < 2; which++)
+    {
+      const double* drive = drives[which];
+      double worstStep = 0;
+      double worstError = 0;
+      int distinct = 1;
+      int stuck = 0;
+      for (level = low; level <= high; level++)
+      {
+        double error = fabs(drive[level] - exact[level]) / exact[level];
+        worstError = (error > worstError) ? error : worstError;
+        if (level == low)
+        {
+          continue;
+        }
+        if (drive[level] == drive[level - 1])
+        {
+          stuck++;
+        }
+        else
+        {
+          distinct++;
+        }
+        if (drive[level - 1] > 0)
+        {
+          double step = (drive[level] - drive[level - 1]) / drive[level - 1];
+          worstStep = (step > worstStep) ? step : worstStep;
+        }
+      }
+      printf("  %-9s %3d distinct, %3d same as the level below, biggest "
+        "step %5.1f%%, worst error %5.1f%%\n", names[which], distinct, stuck,
+        worstStep * 100, worstError * 100);
+    }
+  }
+  return changedOnly ? 0 : 1;
+}
+
+/*****************************************************************************
+*  The effects.
+*****************************************************************************/
+
+#define EFFECT_FRAMES     20000
+#define EFFECT_FRAME_MS   16
+#define EFFECT_PASSES     7
+
+static const char* const effectNames[EFFECT_COUNT] =
+  { "solid", "rainbow", "gradient", "breathing" };
+
+static void timeEffects(void)
+{
+  static bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT];
+  uint32_t digitColors[NUM_DIGITS];
+  uint8_t effect;
+  uint8_t digit;
+
+  for (digit = 0; digit < NUM_DIGITS; digit++)
+  {
+    writeDigit(segmentValues[digit], 8);
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    digitColors[digit] = DIGIT_PALETTE_INDEX;
+#else
+    digitColors[digit] = StripLights_WHITE;
+#endif
+  }
+
+  timing = true;
+  printf("%s display memory, %d LEDs lit a frame, effect budget %d cycles a "
+    "frame\n", (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) ? "LUT" :
+    "RGB", NUM_DIGITS * LEDS_PER_DIGIT, EFFECT_BUDGET_CYCLES);
+  for (effect = 0; effect < EFFECT_COUNT; effect++)
+  {
+    static double quickest[EFFECT_FRAMES];
+    static uint8_t quickestOverruns[EFFECT_FRAMES];
+    uint32_t overruns = 0;
+    uint64_t pixels = 0;
+    double total = 0;
+    double worst = 0;
+    uint32_t frame;
+    uint8_t pass;
+
+    if (!effectsSelect(effect))
+    {
+      printf("  %-9s no palette entries left for it\n", effectNames[effect]);
+      continue;
+    }
+    for (pass = 0; pass < EFFECT_PASSES; pass++)
+    {
+      for (frame = 0; frame < EFFECT_FRAMES; frame++)
+      {
+        uint32_t before = displayEffectOverruns();
+        struct timespec start;
+        pixelWrites = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        effectsFrame(frame * EFFECT_FRAME_MS);
+        queueDisplay(DIGIT_STRINGS);
+        while (serviceDisplay(digitColors, segmentValues, true))
+        {
+          displayTransferDone();
+        }
+        double took = secondsSince(&start);
+        if ((pass == 0) || (took < quickest[frame]))
+        {
+          quickest[frame] = took;
+          quickestOverruns[frame] = displayEffectOverruns() - before;
+        }
+        if (pass == 0)
+        {
+          pixels += pixelWrites;
+        }
+      }
+    }
+    for (frame = 0; frame < EFFECT_FRAMES; frame++)
+    {
+      total += quickest[frame];
+      worst = (quickest[frame] > worst) ? quickest[frame] : worst;
+      overruns += quickestOverruns[frame];
+    }
+    printf("  %-9s %6.1f M pixels/s, %6.2f us a frame, worst %6.2f us, "
+      "%u digits over budget\n", effectNames[effect], (pixels / total) / 1e6,
+      (total * 1e6) / EFFECT_FRAMES, worst * 1e6, overruns);
+  }
+  effectsSelect(EFFECT_SOLID);
+  timing = false;
+}
+
+/*****************************************************************************
+*  A change of color.
+*****************************************************************************/
+
+#define COLOR_CHANGES  200000
+
+// The digits show 12:34:56 and go back and forth between white and red.
+//  Each part's quickest run of COLOR_CHANGES is taken.
+static void timeColorChanges(void)
+{
+  static bool segmentValues[NUM_DIGITS][SEGMENTS_PER_DIGIT];
+  static const uint8_t shown[NUM_DIGITS] = { 6, 5, 4, 3, 2, 1 };
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  const uint32_t colors[2] = { StripLights_CLUT[StripLights_WHITE],
+    StripLights_CLUT[StripLights_RED] };
+  uint32_t memory = sizeof(StripLights_ledArray) +
+    (StripLights_PALETTE_SIZE * sizeof(StripLights_palette[0]));
+#else
+  const uint32_t colors[2] = { StripLights_WHITE, StripLights_RED };
+  uint32_t memory = sizeof(StripLights_ledArray);
+#endif
+  uint32_t digitColors[NUM_DIGITS];
+  double setTook = 0;
+  double drawTook = 0;
+  uint32_t change;
+  uint8_t digit;
+  uint8_t pass;
+
+  for (digit = 0; digit < NUM_DIGITS; digit++)
+  {
+    writeDigit(segmentValues[digit], shown[digit]);
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    digitColors[digit] = DIGIT_PALETTE_INDEX;
+#else
+    digitColors[digit] = StripLights_WHITE;
+#endif
+  }
+
+  timing = true;
+  for (pass = 0; pass < 2 * EFFECT_PASSES; pass++)
+  {
+    struct timespec start;
+    double took;
+
+    // RGB display memory takes the color from the caller, not the palette.
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (change = 0; change < COLOR_CHANGES; change++)
+    {
+      setDigitColor(colors[change & 1]);
+#if (StripLights_MEMORY_TYPE != StripLights_MEMORY_LUT)
+      for (digit = 0; digit < NUM_DIGITS; digit++)
+      {
+        digitColors[digit] = colors[change & 1];
+      }
+#endif
+    }
+    took = secondsSince(&start);
+    setTook = ((pass == 0) || (took < setTook)) ? took : setTook;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (change = 0; change < COLOR_CHANGES / 10; change++)
+    {
+      sendDigits(digitColors, segmentValues);
+    }
+    took = secondsSince(&start);
+    drawTook = ((pass == 0) || (took < drawTook)) ? took : drawTook;
+  }
+
+  paletteWrites = 0;
+  setDigitColor(colors[1]);
+  uint32_t setWrites = paletteWrites;
+  pixelWrites = 0;
+  paletteWrites = 0;
+  sendDigits(digitColors, segmentValues);
+  timing = false;
+
+  setTook = (setTook * 1e9) / COLOR_CHANGES;
+  drawTook = (drawTook * 1e9) / (COLOR_CHANGES / 10);
+  printf("%s display memory: %u bytes for %d LEDs (%u B a pixel", 
+    (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) ? "LUT" : "RGB",
+    memory, (int)StripLights_TOTAL_LEDS, (unsigned)sizeof(StripLights_PIXEL));
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  printf(", and a %d entry palette", (int)StripLights_PALETTE_SIZE);
+#endif
+  printf(")\n");
+  printf("  setDigitColor():     %8.1f ns, %3u palette writes\n", setTook,
+    setWrites);
+  printf("  six digits redrawn:  %8.1f ns, %3u pixel writes, %u palette "
+    "writes\n", drawTook, pixelWrites, paletteWrites);
+  printf("  a color change:      %8.1f ns (%s)\n",
+    (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) ? setTook :
+    setTook + drawTook,
+    (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) ? 
+    "the palette writes alone" : "the redraw included");
+}
+
+/*****************************************************************************
+*  The span fills, against StripLights as it was.
+*****************************************************************************/
+
+#define SPAN_REPEATS  200000
+
+// The old drawing was out of line in the component, so it stays so here.
+#define NOINLINE __attribute__((noinline))
+
+static NOINLINE void oldPixel(int32 x, int32 y, uint32 color)
+{
+  if ((x >= StripLights_MIN_X) && (y >= StripLights_MIN_Y) &&
+    (x <= StripLights_MAX_X) && (y <= StripLights_MAX_Y))
+  {
+    StripLights_ledArray[y][x] = (StripLights_PIXEL)color;
+  }
+}
+
+static NOINLINE void oldMemClear(uint32 color)
+{
+  uint32 row, col;
+
+  for (row = 0; row < StripLights_ARRAY_ROWS; row++)
+  {
+    for (col = 0; col < StripLights_ARRAY_COLS; col++)
+    {
+      StripLights_ledArray[row][col] = (StripLights_PIXEL)color;
+      *(volatile StripLights_PIXEL*)&StripLights_ledArray[row][col] =
+        (StripLights_PIXEL)color;
+    }
+  }
+}
+
+static NOINLINE void oldDrawLine(int32 x0, int32 y0, int32 x1, int32 y1, uint32 color)
+{
+  int32 dy = y1 - y0;
+  int32 dx = x1 - x0;
+  int32 stepx, stepy;
+
+  stepy = (dy < 0) ? -1 : 1;
+  dy = (dy < 0) ? -dy : dy;
+  stepx = (dx < 0) ? -1 : 1;
+  dx = (dx < 0) ? -dx : dx;
+  dy <<= 1;
+  dx <<= 1;
+  oldPixel(x0, y0, color);
+  if (dx > dy)
+  {
+    int fraction = dy - (dx >> 1);
+    while (x0 != x1)
+    {
+      if (fraction >= 0)
+      {
+        y0 += stepy;
+        fraction -= dx;
+      }
+      x0 += stepx;
+      fraction += dy;
+      oldPixel(x0, y0, color);
+    }
+  }
+  else
+  {
+    int fraction = dx - (dy >> 1);
+    while (y0 != y1)
+    {
+      if (fraction >= 0)
+      {
+        x0 += stepx;
+        fraction -= dy;
+      }
+      y0 += stepy;
+      fraction += dx;
+      oldPixel(x0, y0, color);
+    }
+  }
+}
+
+static NOINLINE void oldFillRect(int32 x0, int32 y0, int32 x1, int32 y1, uint32 color)
+{
+  int xDiff = (x0 > x1) ? (x0 - x1) : (x1 - x0);
+
+  while (xDiff >= 0)
+  {
+    oldDrawLine(x0, y0, x0, y1, color);
+    x0 += (x0 > x1) ? -1 : 1;
+    xDiff--;
+  }
+}
+
+// ns a call, old and new, the quickest of EFFECT_PASSES runs of
+//  SPAN_REPEATS; the digits show every number in turn.
+static void timeSpans(void)
+{
+  static bool segmentValues[10][NUM_DIGITS][SEGMENTS_PER_DIGIT];
+  uint32_t digitColors[NUM_DIGITS];
+  static const char* const names[3] =
+    { "clear", "rectangle fill", "six digits sent" };
+  double took[3][2];
+  uint8_t digit;
+  uint8_t test;
+  uint8_t which;
+  uint8_t pass;
+  uint32_t i;
+
+  for (i = 0; i < 10; i++)
+  {
+    for (digit = 0; digit < NUM_DIGITS; digit++)
+    {
+      writeDigit(segmentValues[i][digit], (i + digit) % 10);
+    }
+  }
+  for (digit = 0; digit < NUM_DIGITS; digit++)
+  {
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    digitColors[digit] = DIGIT_PALETTE_INDEX;
+#else
+    digitColors[digit] = StripLights_WHITE;
+#endif
+  }
+
+  timing = true;
+  for (pass = 0; pass < EFFECT_PASSES; pass++)
+  {
+    for (test = 0; test < 3; test++)
+    {
+      for (which = 0; which < 2; which++)
+      {
+        uint32_t repeats = (test == 2) ? SPAN_REPEATS / 10 : SPAN_REPEATS;
+        struct timespec start;
+        double seconds;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < repeats; i++)
+        {
+          uint32 color = (i & 1) ? StripLights_WHITE : StripLights_BLACK;
+          switch ((test << 1) | which)
+          {
+            case 0: oldMemClear(color); break;
+            case 1: StripLights_MemClear(color); break;
+            case 2: oldFillRect(3, 0, 80, 0, color); break;
+            case 3: StripLights_DrawRect(3, 0, 80, 0, 1, color); break;
+            default:
+              pixelAtATime = (which == 0);
+              sendDigits(digitColors, segmentValues[i % 10]);
+              pixelAtATime = false;
+              break;
+          }
+        }
+        seconds = (secondsSince(&start) * 1e9) / repeats;
+        took[test][which] = ((pass == 0) || (seconds < took[test][which])) ?
+          seconds : took[test][which];
+      }
+    }
+  }
+  timing = false;
+
+  printf("%s display memory, %d LEDs, ns a call:\n",
+    (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT) ? "LUT" : "RGB",
+    (int)StripLights_TOTAL_LEDS);
+  for (test = 0; test < 3; test++)
+  {
+    printf("  %-15s old %8.1f  new %8.1f  (%.1fx)\n", names[test],
+      took[test][0], took[test][1], took[test][0] / took[test][1]);
+  }
+  StripLights_MemClear(StripLights_BLACK);
+}
+
+/*****************************************************************************
+*  What the running drive costs a pixel write.
+*****************************************************************************/
+
+#define TIMED_WRITES  50000000
+
+// ns a pixel write, through StripLights_PixelUnchecked(), and as the plain
+//  store it was before the drive was kept; the colors cycle through black,
+//  white and a few palette entries so the old value is always different.
+static void timePixelWrites(void)
+{
+  static const uint32_t colors[4] =
+  {
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+    0, 1, 2, 3
+#else
+    0x000000, 0xFFFFFF, 0x00FF00, 0x7F7F7F
+#endif
+  };
+  struct timespec start;
+  uint32_t i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < TIMED_WRITES; i++)
+  {
+    StripLights_PixelUnchecked(i % StripLights_COLUMNS, 0, colors[i & 3]);
+  }
+  double tracked = secondsSince(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < TIMED_WRITES; i++)
+  {
+    *(volatile StripLights_PIXEL*)&StripLights_ledArray[0][i %
+      StripLights_COLUMNS] = (StripLights_PIXEL)colors[i & 3];
+  }
+  double plain = secondsSince(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < TIMED_WRITES / StripLights_COLUMNS; i++)
+  {
+    StripLights_FillRow(0, StripLights_COLUMNS - 1, 0, colors[i & 3]);
+  }
+  double spans = secondsSince(&start);
+
+  printf("drive tracking: %.2f ns a pixel write (%.2f ns as a plain store), "
+    "%.2f ns a pixel in a span fill\n", (tracked * 1e9) / TIMED_WRITES,
+    (plain * 1e9) / TIMED_WRITES, (spans * 1e9) / TIMED_WRITES);
+  printf("                %u rows sent, %u with a running drive that didn't "
+    "match a full scan\n", driveChecks, driveMismatches);
+  StripLights_MemClear(StripLights_BLACK);
+}
+
+static void writeGolden(const char* path)
+{
+  FILE* out = fopen(path, "w");
+  uint8_t mode;
+  uint8_t day;
+  uint8_t hour;
+
+  if (!out)
+  {
+    perror(path);
+    exit(1);
+  }
+  fprintf(out, "# render_bench golden frames: mode, local date, hour, and "
+    "the hash of that hour's frames\n");
+  for (mode = 0; mode < NUM_MODES; mode++)
+  {
+    for (day = 0; day < NUM_DAYS; day++)
+    {
+      for (hour = 0; hour < HOURS_PER_DAY; hour++)
+      {
+        fprintf(out, "%s 20%02d-%02d-%02d %02d %016llx\n",
+          modes[mode] ? "24h" : "12h", days[day].year, days[day].month,
+          days[day].day, hour,
+          (unsigned long long)hourHashes[mode][day][hour]);
+      }
+    }
+  }
+  fclose(out);
+}
+
+// Returns the number of hours that don't match.
+static unsigned checkGolden(const char* path)
+{
+  FILE* in = fopen(path, "r");
+  char line[128];
+  unsigned checked = 0;
+  unsigned mismatched = 0;
+  uint8_t mode;
+  uint8_t day;
+  uint8_t hour;
+
+  if (!in)
+  {
+    perror(path);
+    exit(1);
+  }
+  for (mode = 0; mode < NUM_MODES; mode++)
+  {
+    for (day = 0; day < NUM_DAYS; day++)
+    {
+      for (hour = 0; hour < HOURS_PER_DAY; hour++)
+      {
+        unsigned long long golden;
+        do
+        {
+          if (!fgets(line, sizeof(line), in))
+          {
+            fprintf(stderr, "%s: ends early; rewrite it with -w\n", path);
+            exit(1);
+          }
+        } while (line[0] == '#');
+        if (sscanf(line, "%*s %*s %*s %llx", &golden) != 1)
+        {
+          fprintf(stderr, "%s: bad line: %s", path, line);
+          exit(1);
+        }
+        checked++;
+        if (golden != hourHashes[mode][day][hour])
+        {
+          if (mismatched++ < 10)
+          {
+            printf("MISMATCH %s 20%02d-%02d-%02d hour %02d\n",
+              modes[mode] ? "24h" : "12h", days[day].year, days[day].month,
+              days[day].day, hour);
+          }
+        }
+      }
+    }
+  }
+  fclose(in);
+  printf("%u of %u hours match the golden frames\n", checked - mismatched,
+    checked);
+  return mismatched;
+}
+
+int main(int argc, char* argv[])
+{
+  bool write = false;
+  bool dither = false;
+  bool effects = false;
+  bool colorChange = false;
+  bool spans = false;
+  int repeats = 1;
+  int opt;
+  int pass;
+  uint8_t mode;
+
+  while ((opt = getopt(argc, argv, "wr:decs")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': write = true; break;
+      case 'd': dither = true; break;
+      case 'e': effects = true; break;
+      case 'c': colorChange = true; break;
+      case 's': spans = true; break;
+      case 'r': repeats = atoi(optarg); break;
+      default:  optind = argc + 1; break;
+    }
+  }
+  if ((optind != argc - ((dither || effects || colorChange || spans) ? 0 : 1))
+    || (repeats < 1))
+  {
+    fprintf(stderr, "usage: %s [-w] [-r repeats] golden.txt\n"
+      "       %s -d\n       %s -e\n       %s -c\n       %s -s\n",
+      argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+  }
+
+  // As main() sets the display up, but at full brightness, where the colors
+  //  come through the brightness tables unchanged.
+  StripLights_MemClear(StripLights_BLACK);
+  brightnessSet(BRIGHTNESS_MAX);
+  powerBudget(POWER_NO_BUDGET);
+#if (StripLights_MEMORY_TYPE == StripLights_MEMORY_LUT)
+  StripLights_ResetPalette();
+#endif
+  setDigitColor(DIGIT_WHITE);
+  if (dither)
+  {
+    return measureDither();
+  }
+  if (effects)
+  {
+    timeEffects();
+    return 0;
+  }
+  if (colorChange)
+  {
+    timeColorChanges();
+    return 0;
+  }
+  if (spans)
+  {
+    timeSpans();
+    return 0;
+  }
+
+  for (mode = 0; mode < NUM_MODES; mode++)
+  {
+    uint64_t pixels = 0;
+    uint64_t sent = 0;
+    double best = 0;
+    for (pass = 0; pass < repeats; pass++)
+    {
+      double took = renderMode(mode, &pixels, &sent);
+      best = ((pass == 0) || (took < best)) ? took : best;
+    }
+    double frames = (double)NUM_DAYS * SECONDS_PER_DAY;
+    printf("%s: %.0f frames in %.3f s (best of %d): %.0f frames/s, "
+      "%.3f us a frame, %.1f pixel writes and %.1f strings a frame\n",
+      modes[mode] ? "24h" : "12h", frames, best, repeats, frames / best,
+      (best * 1e6) / frames, (double)pixels / (frames * repeats),
+      (double)sent / (frames * repeats));
+  }
+
+  timePixelWrites();
+
+  if (write)
+  {
+    writeGolden(argv[optind]);
+    printf("wrote %s\n", argv[optind]);
+    return (driveMismatches == 0) ? 0 : 1;
+  }
+  return ((checkGolden(argv[optind]) == 0) && (driveMismatches == 0)) ? 0 : 1;
+}
@@ -0,0 +1,1786 @@
+/******************************************************************************
+*  gps_clock_sim - runs the clock firmware on Linux, against simulated
+*   hardware, so it can be watched, tested and timed off-target.
+*
+*  Build:  ./build.sh            (leaves build/gps_clock_sim)
+*  Usage:  gps_clock_sim [options]
+*    -d seconds   How long to run, in simulated time (default a day; 0 runs
+*                  until interrupted)
+*    -r           Real time: simulated time keeps pace with the wall clock.
+*                  The default is fast-forward, where nothing ever waits and
+*                  a CyDelay() takes no time at all.
+*    -u path      GPS data from a file, or from a pipe or pseudo-terminal
+*                  (which implies -r), instead of the built-in generator
+*    -s time      Generator start time, "YYYY-MM-DD HH:MM:SS" UTC
+*    -n           No GPS at all; the clock free-runs, or sits at 88:88:88
+*    -o path      Where the UART's TX goes (time frames, in master mode)
+*    -e path      EEPROM image, loaded at the start and saved at the end
+*    -U           Plug in USB: the CDC port shows up as a pseudo-terminal
+*    -t           Draw the display on the terminal whenever it changes
+*    -p prefix    Write the display to prefixNNNNNN.ppm whenever it changes
+*    -i seconds   At most one frame dump per this many simulated seconds
+*    -l path      Ambient light from a trace, "seconds lux" a line, in
+*                  straight lines between points (default: a steady 200 lux)
+*    -j ms        Jitter on when the GPS starts each second's sentences: a
+*                  normal spread with this standard deviation (default 0;
+*                  real modules run to a few ms, cheap ones tens)
+*    -c ppm       How far ClockTick's clock is off nominal, as the IMO may
+*                  be by up to 1% (default 0)
+*    -m path      Log when the seconds digit changes, a line each: the
+*                  host's CLOCK_MONOTONIC in seconds, and 1 if ClockTick was
+*                  locked; with -r, clocks run side by side can be compared
+*                  (see timesync_check.py)
+*
+*  The firmware takes no simulated time to run; time only passes when it
+*   sleeps (WFI), waits (CyDelay()) or spins on StripLights_Ready(). The
+*   hardware then runs on to its next event and raises whatever interrupts
+*   that brings. So the LED bus, the UART and the ClockTick keep faithful
+*   time, but the CPU's own time isn't modelled; the profiling hooks on the
+*   target are the place for that.
+*
+*  The StripLights datapath follows B_WS2811_v1_3.v: a 4-byte FIFO feeding
+*   the shifter a byte at a time, the FIFO interrupt whenever the FIFO is
+*   empty and it's enabled, the latch gap once the data runs out, and then
+*   transfer complete. Each byte is captured as it's shifted out (after the
+*   hardware dim shift), and when a string latches, that's what the LEDs on
+*   the string the mux has selected now show.
+*
+*  The report's LED power comes from what the strings are showing over time:
+*   LED_CHANNEL_MA at full drive for each color, in proportion to its byte,
+*   and LED_IDLE_MA per LED regardless. That's worked out here from scratch
+*   from each string's bytes as it latches, and the firmware's own running
+*   estimate (power.c) is checked against it at every latch. The LEDs
+*   should never draw more than POWER_BUDGET_MA; if they ever did, the
+*   report says FAIL and the simulator exits 1.
+*
+*  The scheduler's idle ratio is the share of simulated time spent in WFI.
+*   As the firmware takes no simulated time, that only falls short of all of
+*   it where the firmware waits some other way; the report has it next to
+*   the scheduler's own busy figure, which should agree, and the host time
+*   the firmware spent awake, a wake at a time, to scale to the target by.
+*   Along with them go the scheduler's task run counts and how many wakes
+*   found nothing to do.
+*
+*  With the GPS from the generator or a file, the top of each second is
+*   known exactly, so the report also says how close the ClockTick edges
+*   keep to where ticklock.c means them to be once it says it's locked, and
+*   when the seconds digit changes on the LEDs, before and after.
+******************************************************************************/
+
+#define _GNU_SOURCE
+#include "project.h"
+#include "power.h"
+#include "scheduler.h"
+#include "ticklock.h"
+#include "ws281x_7seg.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+int firmwareMain();  // The firmware's main(); build.sh renames it.
+
+#define NS_PER_US   1000ULL
+#define NS_PER_MS   1000000ULL
+#define NS_PER_S    1000000000ULL
+#define NEVER       UINT64_MAX
+
+// The ClockTick timer's period as TopDesign starts it: half a second, at
+//  CLOCKTICK_HZ (ticklock.h).
+#define CLOCKTICK_PERIOD  (CLOCKTICK_COUNTS - 1)
+
+// The SysTick runs off the 100kHz ILO.
+#define SYSTICK_NS      (NS_PER_S / 100000)
+
+// The GPS UART: 9600 8N1, into the component's software RX buffer.
+#define UART_BAUD       9600
+#define UART_BYTE_NS    ((10 * NS_PER_S) / UART_BAUD)
+#define UART_RX_SIZE    255
+#define UART_LINE_SIZE  256
+
+// How long after the top of each second the GPS starts talking, give or
+//  take the -j jitter, which is kept within GPS_LAG_MAX_NS.
+#define GPS_LAG_NS      (50 * NS_PER_MS)
+#define GPS_LAG_MAX_NS  (900 * NS_PER_MS)
+
+// The B_WS2811 datapath.
+#define STRIP_FIFO_SIZE 4
+#define STRIP_BYTE_NS   (StripLights_BYTE_TIME_US * NS_PER_US)
+#define MUX_CHANNELS    8
+#define STRING_BYTES    (StripLights_COLUMNS * 3)
+
+// The ambient light sensor: the ADC's counts per lux, and its full scale.
+#define ADC_COUNTS_PER_LUX  4
+#define ADC_MAX_COUNTS      4095
+#define DEFAULT_LUX         200.0
+
+// WS2812 supply current, and the supply.
+#define LED_CHANNEL_MA  20.0
+#define LED_IDLE_MA     1.0
+#define LED_VOLTS       5.0
+
+// Frame dumps: pixels per LED, and the LED positions in each digit.
+#define PPM_SCALE       4
+#define DIGIT_W         (LEDS_PER_SEGMENT + 2)
+#define DIGIT_H         ((2 * LEDS_PER_SEGMENT) + 3)
+#define COLON_W         2
+#define GAP_W           2
+
+/*****************************************************************************
+*  Simulated time, and the options that steer it.
+*****************************************************************************/
+
+static uint64_t now;                     // Since reset
+static uint64_t endAt = 86400 * NS_PER_S;
+static bool realTime;
+static struct timespec wallStart;
+static volatile sig_atomic_t interrupted;
+
+static const char* eepromPath;
+static const char* ppmPrefix;
+static FILE* digitLog;
+static bool terminalDump;
+static uint64_t dumpInterval;
+
+static void finish(void);
+
+/*****************************************************************************
+*  Interrupt controller and CPU bits.
+*****************************************************************************/
+
+DWT_Type simDWT;
+CoreDebug_Type simCoreDebug;
+
+// Nothing runs behind the firmware's back (interrupts only ever fire from
+//  inside simSleep() and friends), so there's nothing to mask.
+uint8 CyEnterCriticalSection(void)
+{
+  return 0;
+}
+
+void CyExitCriticalSection(uint8 savedIntrStatus)
+{
+  (void)savedIntrStatus;
+}
+
+void CyIntEnable(uint8 number)
+{
+  (void)number;
+}
+
+void CyIntDisable(uint8 number)
+{
+  (void)number;
+}
+
+/*****************************************************************************
+*  SysTick. Only the LFCLK source is modelled, which is all the scheduler
+*   uses.
+*****************************************************************************/
+
+static uint64_t sysTickStart;
+static uint32_t sysTickReload = 0x00FFFFFF;
+
+void CySysTickSetClockSource(uint32 clockSource)
+{
+  (void)clockSource;
+}
+
+void CySysTickSetReload(uint32 value)
+{
+  sysTickReload = value & 0x00FFFFFF;
+}
+
+void CySysTickClear(void)
+{
+  sysTickStart = now;
+}
+
+void CySysTickEnable(void)
+{
+}
+
+void CySysTickDisableInterrupt(void)
+{
+}
+
+// Counts down from the reload value, and wraps.
+uint32 CySysTickGetValue(void)
+{
+  uint64_t ticks = (now - sysTickStart) / SYSTICK_NS;
+  return sysTickReload - (uint32_t)(ticks % ((uint64_t)sysTickReload + 1));
+}
+
+/*****************************************************************************
+*  EEPROM.
+*****************************************************************************/
+
+uint8 simEeprom[CY_EEPROM_SIZE];
+static uint32_t eepromWrites;
+
+void CyEEPROM_Start(void)
+{
+}
+
+uint8 CySetTemp(void)
+{
+  return CYRET_SUCCESS;
+}
+
+uint8 CyWriteRowData(uint8 arrayId, uint16 rowAddress, const uint8* rowData)
+{
+  (void)arrayId;
+  if ((uint32_t)(rowAddress + 1) * CY_EEPROM_SIZEOF_ROW > CY_EEPROM_SIZE)
+  {
+    return CYRET_UNKNOWN;
+  }
+  memcpy(&simEeprom[rowAddress * CY_EEPROM_SIZEOF_ROW], rowData,
+    CY_EEPROM_SIZEOF_ROW);
+  eepromWrites++;
+  return CYRET_SUCCESS;
+}
+
+static void loadEeprom(void)
+{
+  FILE* image = fopen(eepromPath, "rb");
+  if (image)
+  {
+    if (fread(simEeprom, 1, sizeof(simEeprom), image) != sizeof(simEeprom))
+    {
+      fprintf(stderr, "%s: short EEPROM image; the rest reads as erased\n",
+        eepromPath);
+    }
+    fclose(image);
+  }
+}
+
+static void saveEeprom(void)
+{
+  FILE* image = fopen(eepromPath, "wb");
+  if (!image || (fwrite(simEeprom, 1, sizeof(simEeprom), image) !=
+    sizeof(simEeprom)))
+  {
+    fprintf(stderr, "%s: %s\n", eepromPath, strerror(errno));
+  }
+  if (image)
+  {
+    fclose(image);
+  }
+}
+
+/*****************************************************************************
+*  ClockTick: a down counter that reloads from its period register at
+*   terminal count, which is also when its interrupt fires, so a tick is
+*   period + 1 counts. Its clock is -c ppm off CLOCKTICK_HZ.
+*****************************************************************************/
+
+static cyisraddress clockTickIsr;
+static uint64_t nextTick = NEVER;
+
+static struct
+{
+  double ppm;
+  uint16_t period;
+  uint16_t counts;    // In the tick under way
+  double start;       // When it started, to the fraction of a ns
+} clockTick;
+
+static double clockTickCountNs(void)
+{
+  return (double)NS_PER_S / (CLOCKTICK_HZ * (1.0 + (clockTick.ppm / 1e6)));
+}
+
+// A tick of counts starts at the given time.
+static void clockTickRun(double start, uint16_t counts)
+{
+  clockTick.start = start;
+  clockTick.counts = counts;
+  nextTick = (uint64_t)llround(start + (counts * clockTickCountNs()));
+}
+
+void ClockTick_Start(void)
+{
+  clockTick.period = CLOCKTICK_PERIOD;
+  clockTickRun((double)now, clockTick.period + 1);
+}
+
+void ClockTick_WritePeriod(uint16 period)
+{
+  clockTick.period = period;
+}
+
+uint16 ClockTick_ReadPeriod(void)
+{
+  return clockTick.period;
+}
+
+uint16 ClockTick_ReadCounter(void)
+{
+  double elapsed = floor(((double)now - clockTick.start) / clockTickCountNs());
+  if (elapsed < 0)
+  {
+    elapsed = 0;
+  }
+  if (elapsed > clockTick.counts - 1)
+  {
+    elapsed = clockTick.counts - 1;
+  }
+  return (uint16)(clockTick.counts - 1 - (uint16_t)elapsed);
+}
+
+// Carries on counting down from the new value.
+void ClockTick_WriteCounter(uint16 counter)
+{
+  clockTickRun((double)now, counter + 1);
+}
+
+void ClockTickInt_StartEx(cyisraddress address)
+{
+  clockTickIsr = address;
+}
+
+/*****************************************************************************
+*  The UART, and the GPS on the other end of it: the built-in generator, a
+*   file (paced out a sentence burst per second, as a GPS would), or a live
+*   stream from a pipe or pty.
+*****************************************************************************/
+
+typedef enum { GPS_GENERATOR, GPS_FILE, GPS_STREAM, GPS_NONE } gpsSource;
+
+static struct
+{
+  bool started;
+  uint8_t rx[UART_RX_SIZE];
+  uint16_t rxHead;
+  uint16_t rxCount;
+  uint32_t overruns;
+  uint64_t rxBytes;
+  uint64_t txBytes;
+  FILE* tx;
+
+  gpsSource source;
+  FILE* file;
+  int fd;
+  char line[UART_LINE_SIZE];
+  size_t lineLength;
+  size_t linePosition;
+  uint64_t nextAt;        // When the next byte arrives
+  time_t generatorStart;  // UTC at simulated time zero
+  uint64_t generatorSecond;
+} uart;
+
+void UART_Start(void)
+{
+  uart.started = true;
+}
+
+uint8 UART_ReadRxData(void)
+{
+  uint8_t byte = 0;
+  if (uart.rxCount > 0)
+  {
+    byte = uart.rx[uart.rxHead];
+    uart.rxHead = (uart.rxHead + 1) % UART_RX_SIZE;
+    uart.rxCount--;
+  }
+  return byte;
+}
+
+uint16 UART_GetRxBufferSize(void)
+{
+  return uart.rxCount;
+}
+
+void UART_ClearRxBuffer(void)
+{
+  uart.rxCount = 0;
+}
+
+void UART_PutArray(const uint8 string[], uint8 byteCount)
+{
+  uart.txBytes += byteCount;
+  if (uart.tx)
+  {
+    fwrite(string, 1, byteCount, uart.tx);
+    fflush(uart.tx);
+  }
+}
+
+static void nmeaChecksum(char* sentence)
+{
+  uint8_t sum = 0;
+  const char* c;
+  for (c = sentence + 1; *c; c++)
+  {
+    sum ^= (uint8_t)*c;
+  }
+  sprintf(sentence + strlen(sentence), "*%02X\r\n", sum);
+}
+
+// How long after the top of the second this one's sentences start.
+static double gpsJitterMs;
+
+static uint64_t gpsLag(void)
+{
+  double lag = (double)GPS_LAG_NS;
+  if (gpsJitterMs > 0)
+  {
+    // Box-Muller, from a fixed seed so runs repeat.
+    double u = drand48();
+    double v = drand48();
+    lag += gpsJitterMs * NS_PER_MS * sqrt(-2.0 * log(1.0 - u)) *
+      cos(2.0 * M_PI * v);
+  }
+  lag = (lag < 0) ? 0 : lag;
+  return (lag > GPS_LAG_MAX_NS) ? GPS_LAG_MAX_NS : (uint64_t)lag;
+}
+
+// One second's worth from the generator: RMC, then a GGA for the parser to
+//  throw away, as most modules send.
+static void generateSecond(void)
+{
+  time_t utc = uart.generatorStart + (time_t)uart.generatorSecond;
+  struct tm t;
+  char rmc[96];
+  char gga[96];
+
+  gmtime_r(&utc, &t);
+  sprintf(rmc, "$GPRMC,%02d%02d%02d.00,A,4043.5000,N,11151.5000,W,0.0,0.0,"
+    "%02d%02d%02d,,,A", t.tm_hour, t.tm_min, t.tm_sec, t.tm_mday,
+    t.tm_mon + 1, t.tm_year % 100);
+  nmeaChecksum(rmc);
+  sprintf(gga, "$GPGGA,%02d%02d%02d.00,4043.5000,N,11151.5000,W,1,08,1.0,"
+    "1300.0,M,-17.0,M,,", t.tm_hour, t.tm_min, t.tm_sec);
+  nmeaChecksum(gga);
+  uart.lineLength = (size_t)snprintf(uart.line, sizeof(uart.line), "%s%s",
+    rmc, gga);
+  uart.linePosition = 0;
+  uart.nextAt = (uart.generatorSecond * NS_PER_S) + gpsLag();
+  uart.generatorSecond++;
+}
+
+// The start of the next second after now, when the GPS would speak next.
+static uint64_t nextSecond(void)
+{
+  return (((now + NS_PER_S - 1) / NS_PER_S) * NS_PER_S) + gpsLag();
+}
+
+// Lines from a file go out back to back, except that an RMC (which starts
+//  each second's burst) waits for the next second.
+static void readFileLine(void)
+{
+  if (!fgets(uart.line, sizeof(uart.line), uart.file))
+  {
+    uart.nextAt = NEVER;
+    return;
+  }
+  uart.lineLength = strlen(uart.line);
+  uart.linePosition = 0;
+  if ((strncmp(uart.line, "$G", 2) == 0) &&
+    (strncmp(uart.line + 3, "RMC", 3) == 0))
+  {
+    uart.nextAt = nextSecond();
+  }
+  else
+  {
+    uart.nextAt = now;
+  }
+}
+
+static void uartRefill(void)
+{
+  switch (uart.source)
+  {
+    case GPS_GENERATOR:
+      generateSecond();
+      break;
+    case GPS_FILE:
+      readFileLine();
+      break;
+    default:
+      uart.nextAt = NEVER; // Streams refill as data turns up.
+      break;
+  }
+}
+
+// A byte has finished arriving.
+static void uartEvent(void)
+{
+  uint8_t byte = (uint8_t)uart.line[uart.linePosition++];
+
+  if (uart.started)
+  {
+    if (uart.rxCount < UART_RX_SIZE)
+    {
+      uart.rx[(uart.rxHead + uart.rxCount) % UART_RX_SIZE] = byte;
+      uart.rxCount++;
+      uart.rxBytes++;
+    }
+    else
+    {
+      uart.overruns++;
+    }
+  }
+  if (uart.linePosition < uart.lineLength)
+  {
+    uart.nextAt += UART_BYTE_NS;
+  }
+  else
+  {
+    uartRefill();
+  }
+}
+
+// Real time only: whatever a stream has for us starts arriving now.
+static void readStream(void)
+{
+  if (uart.linePosition < uart.lineLength)
+  {
+    return; // Still sending the last lot.
+  }
+  ssize_t got = read(uart.fd, uart.line, sizeof(uart.line));
+  if (got > 0)
+  {
+    uart.lineLength = (size_t)got;
+    uart.linePosition = 0;
+    uart.nextAt = now + UART_BYTE_NS;
+  }
+}
+
+/*****************************************************************************
+*  How the ticks and the seconds digit keep to the GPS's seconds, which
+*   start on each whole second of simulated time.
+*****************************************************************************/
+
+typedef struct
+{
+  uint32_t count;
+  double sum;         // All in ns
+  double squares;
+  double worst;
+} phaseStats;
+
+static phaseStats tickPhase;
+static phaseStats digitFreePhase;   // Before the ticks lock, or without
+static phaseStats digitLockedPhase;
+static uint64_t lockedAt = NEVER;
+static bool secondsLit[LEDS_PER_DIGIT];
+
+static bool phaseKnown(void)
+{
+  return (uart.source == GPS_GENERATOR) || (uart.source == GPS_FILE);
+}
+
+// How far time is from the nearest multiple of span, either way.
+static double phaseOf(double time, double span)
+{
+  double phase = fmod(time, span);
+  return (phase >= span / 2) ? phase - span : phase;
+}
+
+static void phaseNote(phaseStats* stats, double error)
+{
+  stats->count++;
+  stats->sum += error;
+  stats->squares += error * error;
+  stats->worst = (fabs(error) > stats->worst) ? fabs(error) : stats->worst;
+}
+
+// A ClockTick edge, against half seconds less the firmware's lead.
+static void phaseTick(void)
+{
+  if (!phaseKnown() || !ticklockLocked())
+  {
+    return;
+  }
+  if (lockedAt == NEVER)
+  {
+    lockedAt = now;
+  }
+  phaseNote(&tickPhase, phaseOf((double)now + (TICKLOCK_LEAD_MS * NS_PER_MS),
+    NS_PER_S / 2));
+}
+
+// The seconds digit's string has latched; if a different set of its LEDs
+//  is lit, the digit has changed.
+static void phaseSecondsDigit(const uint8_t* row, uint16_t length)
+{
+  bool changed = false;
+  uint16_t led;
+
+  for (led = 0; (led < LEDS_PER_DIGIT) && ((led * 3) + 2 < length); led++)
+  {
+    bool lit = (row[led * 3] | row[(led * 3) + 1] | row[(led * 3) + 2]) != 0;
+    changed = changed || (lit != secondsLit[led]);
+    secondsLit[led] = lit;
+  }
+  if (changed && digitLog)
+  {
+    fprintf(digitLog, "%.6f %d\n", (double)wallStart.tv_sec +
+      ((double)wallStart.tv_nsec / 1e9) + ((double)now / 1e9),
+      ticklockLocked() ? 1 : 0);
+    fflush(digitLog);
+  }
+  if (changed && phaseKnown())
+  {
+    phaseNote(((lockedAt < now) && ticklockLocked()) ? &digitLockedPhase :
+      &digitFreePhase,
+      phaseOf((double)now, NS_PER_S));
+  }
+}
+
+static void phaseReport(const char* what, const phaseStats* stats)
+{
+  double mean = stats->count ? stats->sum / stats->count : 0;
+  double rms = stats->count ? sqrt(stats->squares / stats->count) : 0;
+  printf("       %s: %u, mean %+.3f ms, rms %.3f ms, worst %.3f ms\n", what,
+    stats->count, mean / NS_PER_MS, rms / NS_PER_MS,
+    stats->worst / NS_PER_MS);
+}
+
+/*****************************************************************************
+*  USB. Unplugged unless -U; then the host end is a pseudo-terminal. The
+*   CDC endpoint takes one packet at a time, and is free again once the host
+*   has collected it; that's taken to be the next 1 ms frame, the least a
+*   host polling it gives, and the interrupt then wakes the firmware.
+*****************************************************************************/
+
+#define USB_FRAME_NS  NS_PER_MS
+
+static struct
+{
+  int fd;
+  bool configChanged;
+  uint8_t rx[64];
+  uint16_t rxLength;
+  uint64_t txBytes;
+  uint64_t txPackets;
+  uint64_t readyAt;
+} usb = { -1, false, {0}, 0, 0, 0, 0 };
+
+// Bytes through a terminal go as they are, not a line at a time with
+//  newlines turned into CR LF. Anything else is left alone.
+static void makeRaw(int fd)
+{
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+}
+
+static void openUsb(void)
+{
+  usb.fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if ((usb.fd < 0) || (grantpt(usb.fd) != 0) || (unlockpt(usb.fd) != 0))
+  {
+    fprintf(stderr, "USB: can't make a pseudo-terminal: %s\n",
+      strerror(errno));
+    exit(1);
+  }
+  makeRaw(usb.fd);
+  fprintf(stderr, "USB CDC port: %s\n", ptsname(usb.fd));
+}
+
+void USBUART_Start(uint8 device, uint8 mode)
+{
+  (void)device;
+  (void)mode;
+  usb.configChanged = (usb.fd >= 0);
+}
+
+uint8 USBUART_GetConfiguration(void)
+{
+  return (usb.fd >= 0) ? 1 : 0;
+}
+
+uint8 USBUART_IsConfigurationChanged(void)
+{
+  bool changed = usb.configChanged;
+  usb.configChanged = false;
+  return changed ? 1 : 0;
+}
+
+uint8 USBUART_CheckActivity(void)
+{
+  return (usb.fd >= 0) ? 1 : 0;
+}
+
+void USBUART_CDC_Init(void)
+{
+}
+
+uint8 USBUART_CDCIsReady(void)
+{
+  return ((usb.fd >= 0) && (now >= usb.readyAt)) ? 1 : 0;
+}
+
+uint8 USBUART_DataIsReady(void)
+{
+  if ((usb.fd >= 0) && (usb.rxLength == 0))
+  {
+    ssize_t got = read(usb.fd, usb.rx, sizeof(usb.rx));
+    usb.rxLength = (got > 0) ? (uint16_t)got : 0;
+  }
+  return (usb.rxLength > 0) ? 1 : 0;
+}
+
+uint16 USBUART_GetAll(uint8* pData)
+{
+  uint16_t length = usb.rxLength;
+  memcpy(pData, usb.rx, length);
+  usb.rxLength = 0;
+  return length;
+}
+
+// Dropped, as on the real link, if the host isn't keeping up.
+void USBUART_PutData(const uint8* pData, uint16 length)
+{
+  if ((usb.fd >= 0) && (write(usb.fd, pData, length) > 0))
+  {
+    usb.txBytes += length;
+    usb.txPackets++;
+  }
+  usb.readyAt = now + USB_FRAME_NS;
+}
+
+void USBUART_PutString(const char8* string)
+{
+  USBUART_PutData((const uint8*)string, (uint16)strlen(string));
+}
+
+/*****************************************************************************
+*  The ambient light sensor: a phototransistor, linear up to the ADC's full
+*   scale, read by a free-running ADC_SAR. A little noise keeps the filter
+*   and hysteresis honest.
+*****************************************************************************/
+
+static struct
+{
+  double* seconds;
+  double* lux;
+  size_t points;
+  uint32_t noise;
+} light;
+
+static void loadLightTrace(const char* path)
+{
+  FILE* in = fopen(path, "r");
+  char line[128];
+  size_t allocated = 0;
+
+  if (!in)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), in))
+  {
+    double seconds;
+    double lux;
+    if ((line[0] == '#') || (sscanf(line, "%lf %lf", &seconds, &lux) != 2))
+    {
+      continue;
+    }
+    if (light.points == allocated)
+    {
+      allocated = allocated ? allocated * 2 : 256;
+      light.seconds = realloc(light.seconds, allocated * sizeof(double));
+      light.lux = realloc(light.lux, allocated * sizeof(double));
+    }
+    light.seconds[light.points] = seconds;
+    light.lux[light.points++] = lux;
+  }
+  fclose(in);
+  if (light.points == 0)
+  {
+    fprintf(stderr, "%s: no \"seconds lux\" lines\n", path);
+    exit(1);
+  }
+}
+
+static double luxNow(void)
+{
+  double t = (double)now / NS_PER_S;
+  size_t i;
+
+  if (light.points == 0)
+  {
+    return DEFAULT_LUX;
+  }
+  if (t <= light.seconds[0])
+  {
+    return light.lux[0];
+  }
+  for (i = 1; i < light.points; i++)
+  {
+    if (t < light.seconds[i])
+    {
+      double span = light.seconds[i] - light.seconds[i - 1];
+      double along = (span > 0) ? (t - light.seconds[i - 1]) / span : 1;
+      return light.lux[i - 1] + (along * (light.lux[i] - light.lux[i - 1]));
+    }
+  }
+  return light.lux[light.points - 1];
+}
+
+void LightSensor_Start(void)
+{
+}
+
+void LightSensor_StartConvert(void)
+{
+}
+
+// The latest conversion: the light, give or take 1% and a count.
+int16 LightSensor_GetResult16(void)
+{
+  light.noise = (light.noise * 1103515245u) + 12345u;
+  double wobble = ((double)((light.noise >> 16) & 0xFF) / 128.0) - 1.0;
+  double counts = (luxNow() * ADC_COUNTS_PER_LUX * (1.0 + (0.01 * wobble))) +
+    wobble;
+  if (counts < 0)
+  {
+    counts = 0;
+  }
+  return (int16)((counts > ADC_MAX_COUNTS) ? ADC_MAX_COUNTS : counts + 0.5);
+}
+
+/*****************************************************************************
+*  StripLights: the B_WS2811 datapath, the string mux, and what the strings
+*   are showing.
+*****************************************************************************/
+
+typedef enum { STRIP_IDLE, STRIP_SHIFT, STRIP_DONE } stripState;
+
+simStripRegisters simStripRegs;
+
+static struct
+{
+  cyisraddress fisr;
+  cyisraddress cisr;
+  uint8_t fifo[STRIP_FIFO_SIZE];
+  uint8_t fifoCount;
+  uint8_t spill;          // Where writes to a full FIFO go
+  stripState state;
+  bool xferCmpt;
+  uint64_t shiftEnd;
+  uint64_t latchEnd;
+  uint64_t rowStart;
+  uint8_t row[STRING_BYTES];
+  uint16_t rowLength;
+  uint8_t rowChannel;
+
+  uint64_t busyNs;
+  uint64_t bytes;
+  uint32_t overflows;
+  uint32_t latches[MUX_CHANNELS];
+  uint32_t spins;         // StripLights_Ready() polls since time last moved
+} strip;
+
+static uint8_t muxChannel;
+
+// What each string's LEDs are showing: the bytes as they went out.
+static uint8_t strings[MUX_CHANNELS][STRING_BYTES];
+static uint16_t stringLength[MUX_CHANNELS];
+static bool displayChanged;
+static uint32_t frames;
+static uint64_t nextDumpAt;
+
+// LED drive current, by string, and its running total over time.
+static double stringMa[MUX_CHANNELS];
+static double chargeMaNs;
+static uint64_t chargedTo;
+
+// The whole supply current at its highest, the time spent over the
+//  firmware's budget, and how far the firmware's estimate strays from ours.
+static double peakMa;
+static uint64_t overBudgetNs;
+static double estimateWorstMa;
+static double estimateErrorSum;
+static uint32_t estimateChecks;
+
+void StripLights_cisr_StartEx(cyisraddress address)
+{
+  strip.cisr = address;
+}
+
+void StripLights_fisr_StartEx(cyisraddress address)
+{
+  strip.fisr = address;
+}
+
+void StripChannelSelect_Write(uint8 value)
+{
+  muxChannel = value % MUX_CHANNELS;
+}
+
+volatile uint8_t* simStripFifo(void)
+{
+  if (strip.fifoCount < STRIP_FIFO_SIZE)
+  {
+    return &strip.fifo[strip.fifoCount++];
+  }
+  strip.overflows++;
+  return &strip.spill;
+}
+
+// The shifter takes the next byte from the FIFO, dimmed on the way out.
+static void shiftByte(void)
+{
+  uint8_t byte = strip.fifo[0] >> (simStripRegs.dim & 0x07);
+  memmove(strip.fifo, strip.fifo + 1, --strip.fifoCount);
+  if (strip.rowLength < STRING_BYTES)
+  {
+    strip.row[strip.rowLength++] = byte;
+  }
+  strip.bytes++;
+  strip.shiftEnd = now + STRIP_BYTE_NS;
+  strip.state = STRIP_SHIFT;
+}
+
+// All the LEDs there are, lit or not.
+static double idleMa(void)
+{
+  return ((NUM_DIGITS * LEDS_PER_DIGIT) + (2 * COLON_LEDS)) * LED_IDLE_MA;
+}
+
+static double totalDriveMa(void)
+{
+  double totalMa = 0;
+  int channel;
+  for (channel = 0; channel < MUX_CHANNELS; channel++)
+  {
+    totalMa += stringMa[channel];
+  }
+  return totalMa;
+}
+
+// Brings the LED charge up to now, at the current draw.
+static void chargeLeds(void)
+{
+  double totalMa = totalDriveMa();
+  chargeMaNs += totalMa * (double)(now - chargedTo);
+  if (totalMa + idleMa() > POWER_BUDGET_MA)
+  {
+    overBudgetNs += now - chargedTo;
+  }
+  chargedTo = now;
+}
+
+// The drive current of the LEDs actually on a string: a digit, or the two
+//  colon strings wired in parallel.
+static double driveMa(uint8_t channel)
+{
+  uint16_t leds = (channel == COLON_STRING) ? COLON_LEDS : LEDS_PER_DIGIT;
+  uint16_t bytes = (uint16_t)(leds * 3);
+  uint32_t sum = 0;
+  uint16_t i;
+
+  if (channel > COLON_STRING)
+  {
+    return 0;
+  }
+  for (i = 0; (i < bytes) && (i < stringLength[channel]); i++)
+  {
+    sum += strings[channel][i];
+  }
+  return ((channel == COLON_STRING) ? 2 : 1) * (LED_CHANNEL_MA * sum) / 255.0;
+}
+
+// The latch gap is over; the string shows what it was sent.
+static void latchRow(void)
+{
+  uint8_t channel = strip.rowChannel;
+  strip.busyNs += now - strip.rowStart;
+  strip.latches[channel]++;
+  if (channel == 0)
+  {
+    phaseSecondsDigit(strip.row, strip.rowLength);
+  }
+  if ((strip.rowLength != stringLength[channel]) ||
+    (memcmp(strings[channel], strip.row, strip.rowLength) != 0))
+  {
+    memcpy(strings[channel], strip.row, strip.rowLength);
+    stringLength[channel] = strip.rowLength;
+    displayChanged = true;
+    chargeLeds();
+    stringMa[channel] = driveMa(channel);
+  }
+
+  double supplyMa = totalDriveMa() + idleMa();
+  double error = fabs((double)powerEstimateMa() - supplyMa);
+  peakMa = (supplyMa > peakMa) ? supplyMa : peakMa;
+  estimateWorstMa = (error > estimateWorstMa) ? error : estimateWorstMa;
+  estimateErrorSum += error;
+  estimateChecks++;
+}
+
+static uint64_t stripNextEvent(void)
+{
+  if (strip.state == STRIP_SHIFT)
+  {
+    return strip.shiftEnd;
+  }
+  if ((strip.state == STRIP_DONE) && !strip.xferCmpt)
+  {
+    return strip.latchEnd;
+  }
+  return NEVER;
+}
+
+static void stripEvent(void)
+{
+  bool enable = (simStripRegs.control & StripLights_ENABLE) != 0;
+
+  if (strip.state == STRIP_SHIFT)
+  {
+    if (enable && (strip.fifoCount > 0))
+    {
+      shiftByte();
+    }
+    else
+    {
+      strip.state = STRIP_DONE;
+      strip.latchEnd = now +
+        ((uint64_t)simStripRegs.latch * StripLights_BIT_TIME_NS);
+    }
+  }
+  else if (strip.state == STRIP_DONE)
+  {
+    strip.xferCmpt = true;
+    latchRow();
+  }
+}
+
+// Brings the datapath up to date with whatever the firmware has just done
+//  to it, and raises any interrupts that are due. The interrupts are level
+//  triggered, as in the hardware, so keep going until nothing changes.
+static void stripSettle(void)
+{
+  int passes;
+
+  for (passes = 0; passes < 16; passes++)
+  {
+    uint8_t control = simStripRegs.control;
+    bool enable = (control & StripLights_ENABLE) != 0;
+
+    if (enable && (strip.fifoCount == 0) &&
+      (control & StripLights_FIFO_IRQ_EN) && strip.fisr)
+    {
+      strip.fisr();
+      if ((strip.fifoCount == 0) && (simStripRegs.control == control))
+      {
+        break; // Nothing to give; it'll fire again when something changes.
+      }
+    }
+    else if (enable && strip.xferCmpt &&
+      (control & StripLights_XFRCMPT_IRQ_EN) && strip.cisr)
+    {
+      strip.cisr();
+    }
+    else if ((strip.state == STRIP_DONE) && strip.xferCmpt &&
+      (control & StripLights_NEXT_ROW))
+    {
+      strip.state = STRIP_IDLE;
+      strip.xferCmpt = false;
+    }
+    else if (enable && (strip.fifoCount > 0) &&
+      ((strip.state == STRIP_IDLE) ||
+      ((strip.state == STRIP_DONE) && strip.xferCmpt &&
+      (simStripRegs.latch != 0))))
+    {
+      strip.xferCmpt = false;
+      strip.rowStart = now;
+      strip.rowLength = 0;
+      strip.rowChannel = muxChannel;
+      shiftByte();
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  simStripRegs.status =
+    ((strip.fifoCount == 0) ? StripLights_FIFO_EMPTY : 0) |
+    ((strip.fifoCount < STRIP_FIFO_SIZE) ? StripLights_FIFO_NOT_FULL : 0) |
+    (strip.xferCmpt ? StripLights_STATUS_XFER_CMPT : 0) |
+    ((simStripRegs.control & StripLights_ENABLE) ?
+      StripLights_STATUS_ENABLE : 0);
+}
+
+/*****************************************************************************
+*  Frame dumps.
+*****************************************************************************/
+
+// The color of one LED, whatever order the chip takes its bytes in.
+static void ledColor(uint8_t channel, uint16_t led, uint8_t rgb[3])
+{
+  const uint8_t* bytes = &strings[channel][led * 3];
+  if ((uint16_t)((led + 1) * 3) > stringLength[channel])
+  {
+    rgb[0] = rgb[1] = rgb[2] = 0;
+    return;
+  }
+#if (StripLights_CHIP == StripLights_CHIP_WS2812)
+  rgb[0] = bytes[1];
+  rgb[1] = bytes[0];
+#else
+  rgb[0] = bytes[0];
+  rgb[1] = bytes[1];
+#endif
+  rgb[2] = bytes[2];
+}
+
+// A segment's color: the average of its lit LEDs. False if none are lit.
+static bool segmentColor(uint8_t channel, uint8_t first, uint8_t count,
+  uint8_t rgb[3])
+{
+  unsigned sum[3] = {0, 0, 0};
+  unsigned lit = 0;
+  uint8_t led;
+  uint8_t c;
+
+  for (led = first; led < first + count; led++)
+  {
+    uint8_t color[3];
+    ledColor(channel, led, color);
+    if (color[0] | color[1] | color[2])
+    {
+      lit++;
+      for (c = 0; c < 3; c++)
+      {
+        sum[c] += color[c];
+      }
+    }
+  }
+  for (c = 0; c < 3; c++)
+  {
+    rgb[c] = lit ? (uint8_t)(sum[c] / lit) : 0;
+  }
+  return lit > 0;
+}
+
+// One character of a digit, drawn in its segment's color if it's lit.
+static void drawSegment(uint8_t channel, int segment, const char* glyph)
+{
+  uint8_t rgb[3];
+  if (segmentColor(channel, segment * LEDS_PER_SEGMENT, LEDS_PER_SEGMENT,
+    rgb))
+  {
+    // Dimmed colors can be too dark to see; scale them up for the screen.
+    unsigned peak = rgb[0];
+    peak = (rgb[1] > peak) ? rgb[1] : peak;
+    peak = (rgb[2] > peak) ? rgb[2] : peak;
+    printf("\x1b[38;2;%u;%u;%um%s\x1b[0m", (rgb[0] * 255) / peak,
+      (rgb[1] * 255) / peak, (rgb[2] * 255) / peak, glyph);
+  }
+  else
+  {
+    printf(" ");
+  }
+}
+
+static void drawColon(int line)
+{
+  uint8_t rgb[3];
+  bool lit = segmentColor(COLON_STRING, (line == 1) ? 0 : COLON_LEDS / 2,
+    COLON_LEDS / 2, rgb);
+  printf(lit && (line > 0) ? "." : " ");
+}
+
+// The six digits, most significant first, with the colons between pairs.
+static void drawTerminal(void)
+{
+  static bool drawn;
+  int line;
+  int digit;
+
+  if (drawn && isatty(STDOUT_FILENO))
+  {
+    printf("\x1b[3A"); // Draw over the last one.
+  }
+  drawn = true;
+  for (line = 0; line < 3; line++)
+  {
+    for (digit = NUM_DIGITS - 1; digit >= 0; digit--)
+    {
+      switch (line)
+      {
+        case 0:
+          printf(" ");
+          drawSegment(digit, A, "_");
+          printf(" ");
+          break;
+        case 1:
+          drawSegment(digit, F, "|");
+          drawSegment(digit, G, "_");
+          drawSegment(digit, B, "|");
+          break;
+        default:
+          drawSegment(digit, E, "|");
+          drawSegment(digit, D, "_");
+          drawSegment(digit, C, "|");
+          break;
+      }
+      if ((digit == 4) || (digit == 2))
+      {
+        drawColon(line);
+      }
+    }
+    if (line == 0)
+    {
+      printf("   t = %.3f s", (double)now / NS_PER_S);
+    }
+    printf("\x1b[K\n");
+  }
+  fflush(stdout);
+}
+
+static void plot(uint8_t* image, int width, int x, int y,
+  const uint8_t rgb[3])
+{
+  int dx;
+  int dy;
+  for (dy = 0; dy < PPM_SCALE - 1; dy++)
+  {
+    for (dx = 0; dx < PPM_SCALE - 1; dx++)
+    {
+      uint8_t* pixel = &image[(((y * PPM_SCALE) + dy) * width +
+        (x * PPM_SCALE) + dx) * 3];
+      memcpy(pixel, rgb, 3);
+    }
+  }
+}
+
+// An LED's spot on the picture: lit LEDs in their own color, dark ones a
+//  faint grey so the shape of the display shows.
+static void plotLed(uint8_t* image, int width, int x, int y,
+  uint8_t channel, uint16_t led)
+{
+  static const uint8_t dark[3] = {24, 24, 24};
+  uint8_t rgb[3];
+  ledColor(channel, led, rgb);
+  plot(image, width, x, y, (rgb[0] | rgb[1] | rgb[2]) ? rgb : dark);
+}
+
+// Lays a segment's LEDs out along its bar, from (x, y), across or down.
+static void plotSegment(uint8_t* image, int width, int x, int y, bool down,
+  uint8_t channel, int segment)
+{
+  int i;
+  for (i = 0; i < LEDS_PER_SEGMENT; i++)
+  {
+    plotLed(image, width, down ? x : x + i, down ? y + i : y, channel,
+      (segment * LEDS_PER_SEGMENT) + i);
+  }
+}
+
+static void writePpm(void)
+{
+  const int columns = (NUM_DIGITS * DIGIT_W) + (2 * COLON_W) +
+    ((NUM_DIGITS + 1) * GAP_W);
+  const int width = columns * PPM_SCALE;
+  const int height = (DIGIT_H + 2) * PPM_SCALE;
+  uint8_t* image = calloc((size_t)width * height, 3);
+  char path[4096];
+  int x = GAP_W;
+  int digit;
+  int i;
+
+  for (digit = NUM_DIGITS - 1; digit >= 0; digit--)
+  {
+    const int L = LEDS_PER_SEGMENT;
+    plotSegment(image, width, x + 1, 1, false, digit, A);
+    plotSegment(image, width, x + 1, L + 2, false, digit, G);
+    plotSegment(image, width, x + 1, (2 * L) + 3, false, digit, D);
+    plotSegment(image, width, x, 2, true, digit, F);
+    plotSegment(image, width, x + L + 1, 2, true, digit, B);
+    plotSegment(image, width, x, L + 3, true, digit, E);
+    plotSegment(image, width, x + L + 1, L + 3, true, digit, C);
+    x += DIGIT_W + GAP_W;
+    if ((digit == 4) || (digit == 2))
+    {
+      // Each colon string is two dots of four LEDs, one above the other.
+      for (i = 0; i < COLON_LEDS; i++)
+      {
+        int dot = i / (COLON_LEDS / 2);
+        plotLed(image, width, x - (GAP_W / 2) + (i % 2),
+          (dot ? (DIGIT_H * 2) / 3 : DIGIT_H / 3) + ((i / 2) % 2),
+          COLON_STRING, i);
+      }
+      x += COLON_W;
+    }
+  }
+
+  snprintf(path, sizeof(path), "%s%06u.ppm", ppmPrefix, frames);
+  FILE* out = fopen(path, "wb");
+  if (!out)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  fprintf(out, "P6\n# t = %.6f s\n%d %d\n255\n", (double)now / NS_PER_S,
+    width, height);
+  fwrite(image, 3, (size_t)width * height, out);
+  fclose(out);
+  free(image);
+}
+
+static void dumpFrame(void)
+{
+  if (!displayChanged || (now < nextDumpAt))
+  {
+    return;
+  }
+  displayChanged = false;
+  nextDumpAt = now + dumpInterval;
+  frames++;
+  if (terminalDump)
+  {
+    drawTerminal();
+  }
+  if (ppmPrefix)
+  {
+    writePpm();
+  }
+}
+
+/*****************************************************************************
+*  Running the hardware forward.
+*****************************************************************************/
+
+static uint64_t wallNow(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)(ts.tv_sec - wallStart.tv_sec) * NS_PER_S) +
+    (uint64_t)(ts.tv_nsec - wallStart.tv_nsec);
+}
+
+static uint64_t nextEvent(void)
+{
+  uint64_t next = endAt ? endAt : NEVER;
+  uint64_t strips = stripNextEvent();
+  next = (nextTick < next) ? nextTick : next;
+  next = (uart.nextAt < next) ? uart.nextAt : next;
+  next = (strips < next) ? strips : next;
+  if ((usb.fd >= 0) && (usb.readyAt > now) && (usb.readyAt < next))
+  {
+    next = usb.readyAt;
+  }
+  return next;
+}
+
+// Real time only: waits for the wall clock to reach the event at time, or
+//  for input to arrive first. Returns how far it got.
+static uint64_t waitFor(uint64_t time)
+{
+  for (;;)
+  {
+    uint64_t wall = wallNow();
+    struct pollfd fds[2];
+    int count = 0;
+
+    if (interrupted)
+    {
+      finish();
+    }
+    if (wall >= time)
+    {
+      return time;
+    }
+    if (uart.source == GPS_STREAM)
+    {
+      fds[count].fd = uart.fd;
+      fds[count++].events = POLLIN;
+    }
+    if (usb.fd >= 0)
+    {
+      fds[count].fd = usb.fd;
+      fds[count++].events = POLLIN;
+    }
+    uint64_t wait = (time - wall) / NS_PER_MS;
+    if (poll(fds, count, (wait > 1000) ? 1000 : (int)wait + 1) > 0)
+    {
+      return wallNow();
+    }
+  }
+}
+
+// Moves time on to the given point, and sees to everything that's due.
+static void advanceTo(uint64_t time)
+{
+  if (realTime)
+  {
+    time = waitFor(time);
+  }
+  else if (time == NEVER)
+  {
+    fprintf(stderr, "simulation stuck: the firmware is waiting on hardware "
+      "with nothing to come\n");
+    exit(1);
+  }
+  if (time > now)
+  {
+    now = time;
+    strip.spins = 0;
+  }
+  if (interrupted || (endAt && (now >= endAt)))
+  {
+    finish();
+  }
+  if (realTime && (uart.source == GPS_STREAM))
+  {
+    readStream();
+  }
+  if (nextTick <= now)
+  {
+    clockTickRun(clockTick.start + (clockTick.counts * clockTickCountNs()),
+      clockTick.period + 1);
+    phaseTick();
+    if (clockTickIsr)
+    {
+      clockTickIsr();
+    }
+  }
+  while (uart.nextAt <= now)
+  {
+    uartEvent();
+  }
+  if (stripNextEvent() <= now)
+  {
+    stripEvent();
+  }
+  stripSettle();
+  dumpFrame();
+}
+
+// Runs the hardware on to its next event.
+static void idle(void)
+{
+  stripSettle();
+  advanceTo(nextEvent());
+}
+
+// How the CPU spent its time: asleep in simulated time, and awake in host
+//  time, between one WFI and the next.
+static struct
+{
+  uint64_t asleepNs;
+  struct timespec awakeSince;
+  double awakeHostNs;
+  double maxAwakeHostNs;
+} cpu;
+
+static double hostNsSince(const struct timespec* start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return ((double)(end.tv_sec - start->tv_sec) * 1e9) +
+    (double)(end.tv_nsec - start->tv_nsec);
+}
+
+void simSleep(void)
+{
+  uint64_t sleepStart = now;
+  double awake = hostNsSince(&cpu.awakeSince);
+
+  cpu.awakeHostNs += awake;
+  cpu.maxAwakeHostNs = (awake > cpu.maxAwakeHostNs) ? awake :
+    cpu.maxAwakeHostNs;
+  idle();
+  cpu.asleepNs += now - sleepStart;
+  clock_gettime(CLOCK_MONOTONIC, &cpu.awakeSince);
+}
+
+static void runFor(uint64_t duration)
+{
+  uint64_t until = now + duration;
+  stripSettle();
+  while (now < until)
+  {
+    uint64_t next = nextEvent();
+    advanceTo((next < until) ? next : until);
+  }
+}
+
+void CyDelay(uint32 milliseconds)
+{
+  runFor(milliseconds * NS_PER_MS);
+}
+
+void CyDelayUs(uint16 microseconds)
+{
+  runFor(microseconds * NS_PER_US);
+}
+
+// Polling once is fine; polling again without time having moved is a spin,
+//  and the hardware gets to run while the firmware waits.
+uint32_t simStripReady(void)
+{
+  stripSettle();
+  if (StripLights_Ready())
+  {
+    return 1;
+  }
+  if (++strip.spins > 1)
+  {
+    idle();   // Spinning, so awake all the while
+  }
+  return StripLights_Ready();
+}
+
+/*****************************************************************************
+*  Setup and the report.
+*****************************************************************************/
+
+static struct timespec hostStart;
+
+// The event each task is there for; a task with more than one is named for
+//  the first.
+static const char* taskName(uint32_t events)
+{
+  static const char* const names[] = { "gps", "tick", "time", "display",
+    "usb" };
+  uint8_t bit;
+
+  for (bit = 0; bit < sizeof(names) / sizeof(names[0]); bit++)
+  {
+    if (events & (1u << bit))
+    {
+      return names[bit];
+    }
+  }
+  return "?";
+}
+
+static void schedulerReport(double simulated)
+{
+  schedStats stats;
+  const schedTask* tasks;
+  uint8_t numTasks;
+  uint8_t i;
+
+  schedulerStats(&stats);
+  tasks = schedulerTasks(&numTasks);
+  printf("Scheduler: %u passes, %u sleeps (%.1f a second), %u woke to "
+    "nothing\n           runs:", stats.passes, stats.sleeps,
+    simulated ? stats.sleeps / simulated : 0, stats.emptyWakes);
+  for (i = 0; i < numTasks; i++)
+  {
+    printf(" %s %u", taskName(tasks[i].events), tasks[i].runCount);
+  }
+  printf("\n           idle %.3f%% of simulated time, busy %u%% by the "
+    "firmware's own count\n", now ? (100.0 * cpu.asleepNs) / now : 0,
+    cpuBusyPercent());
+  printf("           awake %.1f us of host time a sleep (longest %.1f us), "
+    "%.3f s in all\n",
+    stats.sleeps ? (cpu.awakeHostNs / stats.sleeps) / 1e3 : 0,
+    cpu.maxAwakeHostNs / 1e3, cpu.awakeHostNs / 1e9);
+}
+
+static void report(void)
+{
+  struct timespec hostEnd;
+  uint32_t latches = 0;
+  int channel;
+
+  clock_gettime(CLOCK_MONOTONIC, &hostEnd);
+  double host = (double)(hostEnd.tv_sec - hostStart.tv_sec) +
+    ((double)(hostEnd.tv_nsec - hostStart.tv_nsec) / 1e9);
+  double simulated = (double)now / NS_PER_S;
+
+  for (channel = 0; channel < MUX_CHANNELS; channel++)
+  {
+    latches += strip.latches[channel];
+  }
+  printf("\nSimulated %.3f s in %.3f s of host time (%.0fx)\n", simulated,
+    host, (host > 0) ? simulated / host : 0);
+  printf("LED bus: busy %.3f s (%.3f%%), %u strings latched, %llu bytes, "
+    "%.1f us a string\n", (double)strip.busyNs / NS_PER_S,
+    simulated ? (100.0 * strip.busyNs) / now : 0, latches,
+    (unsigned long long)strip.bytes,
+    latches ? ((double)strip.busyNs / latches) / NS_PER_US : 0);
+  printf("         latches by string:");
+  for (channel = 0; channel < MUX_CHANNELS; channel++)
+  {
+    printf(" %u", strip.latches[channel]);
+  }
+  printf("\n         %u underruns, %u FIFO overflows, %u strings timed out\n",
+    (unsigned)StripLights_Underruns(), strip.overflows,
+    (unsigned)displayTransferTimeouts());
+  printf("UART: %llu bytes in, %u overruns, %llu bytes out\n",
+    (unsigned long long)uart.rxBytes, uart.overruns,
+    (unsigned long long)uart.txBytes);
+  printf("USB: %llu bytes out in %llu packets\n",
+    (unsigned long long)usb.txBytes, (unsigned long long)usb.txPackets);
+  printf("EEPROM: %u row writes\n", eepromWrites);
+  chargeLeds();
+  double averageMa = now ? chargeMaNs / (double)now : 0;
+  printf("LED power: %.3f W average driving the LEDs, plus %.3f W idle, at "
+    "%.0f V\n", (averageMa * LED_VOLTS) / 1000.0,
+    (idleMa() * LED_VOLTS) / 1000.0, LED_VOLTS);
+  printf("           peak %.0f mA, %.3f s over the %u mA budget; firmware "
+    "estimate within %.1f mA (mean %.2f) of a full scan at %u latches\n",
+    peakMa, (double)overBudgetNs / NS_PER_S, POWER_BUDGET_MA,
+    estimateWorstMa, estimateChecks ? estimateErrorSum / estimateChecks : 0,
+    estimateChecks);
+  if (peakMa > POWER_BUDGET_MA)
+  {
+    printf("           FAIL: the LEDs went over the budget\n");
+  }
+  if (phaseKnown())
+  {
+    if (lockedAt == NEVER)
+    {
+      printf("Phase: ClockTick never locked to the GPS\n");
+    }
+    else
+    {
+      printf("Phase: ClockTick locked at %.1f s; edges from %d ms before "
+        "each half second, and seconds digit changes from the top of the "
+        "second\n", (double)lockedAt / NS_PER_S, TICKLOCK_LEAD_MS);
+      phaseReport("edges, locked", &tickPhase);
+    }
+    phaseReport("digit changes, free", &digitFreePhase);
+    phaseReport("digit changes, locked", &digitLockedPhase);
+  }
+  schedulerReport(simulated);
+  printf("Display: %u frames dumped\n", frames);
+  terminalDump = true;
+  drawTerminal();
+}
+
+static void finish(void)
+{
+  report();
+  if (eepromPath)
+  {
+    saveEeprom();
+  }
+  exit((peakMa > POWER_BUDGET_MA) ? 1 : 0);
+}
+
+static void onSignal(int signal)
+{
+  (void)signal;
+  interrupted = 1;
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-d seconds] [-r] [-u gps data] [-s "
+    "\"YYYY-MM-DD HH:MM:SS\"] [-n] [-o uart tx] [-e eeprom] [-U] [-t] "
+    "[-p ppm prefix] [-i seconds] [-l light trace] [-j ms] [-c ppm] "
+    "[-m digit log]\n",
+    name);
+  exit(2);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* gpsPath = NULL;
+  const char* startTime = "2024-01-01 00:00:00";
+  struct stat info;
+  struct tm start;
+  int opt;
+
+  uart.source = GPS_GENERATOR;
+  while ((opt = getopt(argc, argv, "d:ru:s:no:e:Utp:i:l:j:c:m:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'd': endAt = (uint64_t)(atof(optarg) * NS_PER_S); break;
+      case 'r': realTime = true; break;
+      case 'u': gpsPath = optarg; break;
+      case 's': startTime = optarg; break;
+      case 'n': uart.source = GPS_NONE; break;
+      case 'o':
+        uart.tx = fopen(optarg, "wb");
+        if (!uart.tx)
+        {
+          fprintf(stderr, "%s: %s\n", optarg, strerror(errno));
+          return 1;
+        }
+        makeRaw(fileno(uart.tx));
+        break;
+      case 'e': eepromPath = optarg; break;
+      case 'U': openUsb(); break;
+      case 't': terminalDump = true; break;
+      case 'p': ppmPrefix = optarg; break;
+      case 'i': dumpInterval = (uint64_t)(atof(optarg) * NS_PER_S); break;
+      case 'l': loadLightTrace(optarg); break;
+      case 'j': gpsJitterMs = atof(optarg); break;
+      case 'c': clockTick.ppm = atof(optarg); break;
+      case 'm':
+        digitLog = fopen(optarg, "w");
+        if (!digitLog)
+        {
+          fprintf(stderr, "%s: %s\n", optarg, strerror(errno));
+          return 1;
+        }
+        break;
+      default: usage(argv[0]); break;
+    }
+  }
+  if (optind != argc)
+  {
+    usage(argv[0]);
+  }
+
+  memset(&start, 0, sizeof(start));
+  if (!strptime(startTime, "%Y-%m-%d %H:%M:%S", &start))
+  {
+    usage(argv[0]);
+  }
+  uart.generatorStart = timegm(&start);
+
+  if (gpsPath)
+  {
+    uart.fd = open(gpsPath, O_RDONLY | O_NOCTTY);
+    if ((uart.fd < 0) || (fstat(uart.fd, &info) != 0))
+    {
+      fprintf(stderr, "%s: %s\n", gpsPath, strerror(errno));
+      return 1;
+    }
+    if (S_ISREG(info.st_mode))
+    {
+      uart.source = GPS_FILE;
+      uart.file = fdopen(uart.fd, "r");
+    }
+    else
+    {
+      // Live data can only come in as fast as it comes.
+      uart.source = GPS_STREAM;
+      realTime = true;
+      fcntl(uart.fd, F_SETFL, O_NONBLOCK);
+      makeRaw(uart.fd);
+    }
+  }
+  uart.nextAt = NEVER;
+  uartRefill();
+
+  if (eepromPath)
+  {
+    loadEeprom();
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  clock_gettime(CLOCK_MONOTONIC, &hostStart);
+  cpu.awakeSince = hostStart;
+  wallStart = hostStart;
+
+  return firmwareMain();
+}
@@ -0,0 +1,38 @@
+/******************************************************************************
+*  The simulated hardware's side of things: what the stand-in headers need
+*   from sim.c. Nothing in the firmware calls these directly.
+******************************************************************************/
+
+#ifndef __sim_h__
+#define __sim_h__
+
+#include <stdint.h>
+
+// The B_WS2811 datapath's registers, bar the FIFO.
+typedef struct
+{
+  volatile uint8_t control;
+  volatile uint8_t status;
+  volatile uint8_t dim;
+  volatile uint8_t latch;
+  volatile uint8_t period;
+  volatile uint8_t period2;
+  volatile uint8_t compare0;
+  volatile uint8_t compare1;
+  volatile uint8_t auxControl;
+  volatile uint8_t stringSel;
+} simStripRegisters;
+
+extern simStripRegisters simStripRegs;
+
+// The next free FIFO slot; see cyfitter.h.
+volatile uint8_t* simStripFifo(void);
+
+// WFI: runs the simulated hardware up to its next event, interrupts and all.
+void simSleep(void);
+
+// Stands in for StripLights_Ready() in the firmware (build.sh renames it),
+//  so that polling it lets simulated time go by.
+uint32_t simStripReady(void);
+
+#endif
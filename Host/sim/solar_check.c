@@ -0,0 +1,472 @@
+/******************************************************************************
+*  solar_check - checks the firmware's fixed-point sunrise, sunset and civil
+*   twilight times (solar.c) against a reference table, for places from the
+*   equator to inside the Arctic circle, every few days of a year, and times
+*   the calculation.
+*
+*  Build:  ./build.sh            (leaves build/solar_check)
+*  Usage:  solar_check [-w] reference.txt
+*    -w           Write the reference table instead of checking against it
+*
+*  The reference is the NOAA Solar Calculator's algorithm (Meeus' solar
+*   coordinates, with nutation and the obliquity's drift), worked in double
+*   precision, with each event found by working the sun's position out
+*   again at the time of the event itself until it settles, where the
+*   firmware takes one position for the whole day. It agrees with published
+*   almanac times to the minute.
+*
+*  Times in the table are UTC, in minutes past midnight; each day's are the
+*   ones either side of that day's local solar noon, so far east or west
+*   they can fall on the day before or after. "up" and "down" mark a day
+*   the sun doesn't cross that height at all. The firmware's times are
+*   compared the same way, a wrap past midnight allowed for. Past the polar
+*   circles the sun skims the horizon for days either side of the polar
+*   day and night, and the time it crosses swings a long way for a small
+*   change in its position; those days are counted, not held to the
+*   tolerance.
+******************************************************************************/
+
+#include "solar.h"
+#include "date_time.h"
+#include "project.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define YEAR            24      // 2024, a leap year
+#define DAY_STEP        5
+#define MINUTES_PER_DAY 1440.0
+#define TIMED_CALLS     1000000
+
+// Within this of the reference is a pass, away from the grazing days.
+#define TOLERANCE_MINUTES  1.0
+
+// The sun within this many degrees of the height all day is grazing.
+#define GRAZING_DEGREES    1.0
+
+#define NUM_EVENTS  4
+static const char* eventNames[NUM_EVENTS] =
+{
+  "sunrise", "sunset", "dawn", "dusk"
+};
+
+typedef struct
+{
+  const char* name;
+  double latitude;
+  double longitude;
+} place;
+
+static const place places[] =
+{
+  { "Gulf of Guinea",  0.0,       0.0       },
+  { "Singapore",       1.3521,    103.8198  },
+  { "Sydney",          -33.8688,  151.2093  },
+  { "Salt Lake City",  40.725,    -111.858333 },
+  { "London",          51.5074,   -0.1278   },
+  { "Ushuaia",         -54.8019,  -68.3030  },
+  { "Oslo",            59.9139,   10.7522   },
+  { "Fairbanks",       64.8378,   -147.7164 },
+  { "Tromso",          69.6492,   18.9553   },
+};
+#define NUM_PLACES (sizeof(places) / sizeof(places[0]))
+
+// What's in the table for one place and day: minutes past midnight UTC, or
+//  NAN with sky saying why.
+typedef struct
+{
+  double minutes[NUM_EVENTS];
+  uint8_t sky[NUM_EVENTS];
+  bool grazing[NUM_EVENTS];
+} dayTimes;
+
+static double radians(double degrees)
+{
+  return degrees * M_PI / 180.0;
+}
+
+static double degrees(double radians)
+{
+  return radians * 180.0 / M_PI;
+}
+
+// The sun's declination (degrees) and the equation of time (minutes) at a
+//  Julian day.
+static void sunAt(double julianDay, double* declination, double* equation)
+{
+  double t = (julianDay - 2451545.0) / 36525.0;
+  double meanLongitude = fmod(280.46646 + t * (36000.76983 + t * 0.0003032),
+    360.0);
+  double anomaly = 357.52911 + t * (35999.05029 - 0.0001537 * t);
+  double eccentricity = 0.016708634 - t * (0.000042037 + 0.0000001267 * t);
+  double center = sin(radians(anomaly)) *
+    (1.914602 - t * (0.004817 + 0.000014 * t)) +
+    sin(radians(2 * anomaly)) * (0.019993 - 0.000101 * t) +
+    sin(radians(3 * anomaly)) * 0.000289;
+  double omega = 125.04 - 1934.136 * t;
+  double apparent = meanLongitude + center - 0.00569 -
+    0.00478 * sin(radians(omega));
+  double obliquity = 23.0 + (26.0 + ((21.448 - t * (46.815 + t * (0.00059 -
+    t * 0.001813)))) / 60.0) / 60.0 + 0.00256 * cos(radians(omega));
+  double y = tan(radians(obliquity / 2));
+
+  y *= y;
+  *declination = degrees(asin(sin(radians(obliquity)) *
+    sin(radians(apparent))));
+  *equation = 4 * degrees(y * sin(2 * radians(meanLongitude)) -
+    2 * eccentricity * sin(radians(anomaly)) +
+    4 * eccentricity * y * sin(radians(anomaly)) *
+    cos(2 * radians(meanLongitude)) -
+    0.5 * y * y * sin(4 * radians(meanLongitude)) -
+    1.25 * eccentricity * eccentricity * sin(2 * radians(anomaly)));
+}
+
+// One crossing of height (degrees), rising or setting, on the day whose
+//  00:00 UTC is Julian day midnight. Minutes past that midnight, or NAN.
+static double crossing(const place* where, double midnight, double height,
+  bool rising, uint8_t* sky, bool* grazing)
+{
+  double minutes = 720.0 - 4.0 * where->longitude;
+  int pass;
+
+  *grazing = false;
+  for (pass = 0; pass < 10; pass++)
+  {
+    double declination;
+    double equation;
+    sunAt(midnight + minutes / MINUTES_PER_DAY, &declination, &equation);
+    double lat = radians(where->latitude);
+    double dec = radians(declination);
+    double cosHour = (sin(radians(height)) - sin(lat) * sin(dec)) /
+      (cos(lat) * cos(dec));
+    // Highest and lowest the sun gets, against the height.
+    double noonHeight = 90.0 - fabs(where->latitude - declination);
+    double midnightHeight = fabs(where->latitude + declination) - 90.0;
+    *grazing = (fabs(noonHeight - height) < GRAZING_DEGREES) ||
+      (fabs(midnightHeight - height) < GRAZING_DEGREES);
+    if (cosHour >= 1.0)
+    {
+      *sky = SOLAR_ALWAYS_DOWN;
+      return NAN;
+    }
+    if (cosHour <= -1.0)
+    {
+      *sky = SOLAR_ALWAYS_UP;
+      return NAN;
+    }
+    double hour = degrees(acos(cosHour));
+    double next = 720.0 - 4.0 * (where->longitude + (rising ? hour : -hour)) -
+      equation;
+    if (fabs(next - minutes) < 0.001)
+    {
+      minutes = next;
+      break;
+    }
+    minutes = next;
+  }
+  *sky = SOLAR_RISES_AND_SETS;
+  return fmod(fmod(minutes, MINUTES_PER_DAY) + MINUTES_PER_DAY,
+    MINUTES_PER_DAY);
+}
+
+static void reference(const place* where, int16_t day, dayTimes* times)
+{
+  // 1 January 2000 00:00 UTC is Julian day 2451544.5.
+  date_time first = { .month = 1, .day = 1, .year = YEAR };
+  double midnight = 2451544.5 + (dateTimeToEpoch(&first) / 86400) + day - 1;
+  uint8_t event;
+
+  for (event = 0; event < NUM_EVENTS; event++)
+  {
+    times->minutes[event] = crossing(where, midnight,
+      (event < 2) ? -0.833 : -6.0, (event % 2) == 0, &times->sky[event],
+      &times->grazing[event]);
+  }
+}
+
+// The firmware's times, in the same form.
+static void firmware(const place* where, int16_t day, dayTimes* times)
+{
+  solarTimes solar;
+  const solarEvent* events[2] = { &solar.sun, &solar.twilight };
+  uint8_t event;
+
+  date_time first = { .month = 1, .day = 1, .year = YEAR };
+
+  solarCalculate((int32_t)lround(where->latitude * 1e6),
+    (int32_t)lround(where->longitude * 1e6),
+    (uint16_t)((dateTimeToEpoch(&first) / 86400) + day - 1), 0, &solar);
+  for (event = 0; event < NUM_EVENTS; event++)
+  {
+    const solarEvent* crossing = events[event / 2];
+    times->sky[event] = crossing->sky;
+    times->grazing[event] = false;
+    times->minutes[event] = (crossing->sky != SOLAR_RISES_AND_SETS) ? NAN :
+      ((event % 2) ? crossing->set : crossing->rise) / 60.0;
+  }
+}
+
+static void printTime(FILE* out, double minutes, uint8_t sky)
+{
+  if (sky == SOLAR_RISES_AND_SETS)
+  {
+    fprintf(out, " %7.2f", minutes);
+  }
+  else
+  {
+    fprintf(out, " %7s", (sky == SOLAR_ALWAYS_UP) ? "up" : "down");
+  }
+}
+
+static void writeReference(const char* path)
+{
+  FILE* out = fopen(path, "w");
+  int16_t daysInYear = isLeapYear(2000 + YEAR) ? 366 : 365;
+  size_t p;
+  int16_t day;
+  uint8_t event;
+
+  if (!out)
+  {
+    perror(path);
+    exit(1);
+  }
+  fprintf(out, "# solar_check reference: latitude, longitude, day of 20%02d, "
+    "then sunrise, sunset,\n# civil dawn and dusk, minutes past midnight "
+    "UTC; a trailing g marks a grazing day\n", YEAR);
+  for (p = 0; p < NUM_PLACES; p++)
+  {
+    for (day = 1; day <= daysInYear; day += DAY_STEP)
+    {
+      dayTimes times;
+      bool grazing = false;
+      reference(&places[p], day, &times);
+      fprintf(out, "%10.6f %11.6f %3d", places[p].latitude,
+        places[p].longitude, day);
+      for (event = 0; event < NUM_EVENTS; event++)
+      {
+        printTime(out, times.minutes[event], times.sky[event]);
+        grazing = grazing || times.grazing[event];
+      }
+      fprintf(out, "%s\n", grazing ? " g" : "");
+    }
+  }
+  fclose(out);
+}
+
+// Reads one of the table's times back.
+static bool readTime(const char* field, double* minutes, uint8_t* sky)
+{
+  if (strcmp(field, "up") == 0)
+  {
+    *sky = SOLAR_ALWAYS_UP;
+    *minutes = NAN;
+    return true;
+  }
+  if (strcmp(field, "down") == 0)
+  {
+    *sky = SOLAR_ALWAYS_DOWN;
+    *minutes = NAN;
+    return true;
+  }
+  *sky = SOLAR_RISES_AND_SETS;
+  return sscanf(field, "%lf", minutes) == 1;
+}
+
+// Minutes from the reference to the firmware's time, the short way round.
+static double difference(double reference, double firmware)
+{
+  double apart = fmod(firmware - reference, MINUTES_PER_DAY);
+  if (apart > MINUTES_PER_DAY / 2)
+  {
+    apart -= MINUTES_PER_DAY;
+  }
+  if (apart < -MINUTES_PER_DAY / 2)
+  {
+    apart += MINUTES_PER_DAY;
+  }
+  return apart;
+}
+
+// Returns the number of times out of tolerance, or that disagree about
+//  whether the sun crosses at all, away from the grazing days.
+static unsigned checkReference(const char* path)
+{
+  FILE* in = fopen(path, "r");
+  char line[160];
+  unsigned failed = 0;
+  unsigned grazingDays[NUM_PLACES] = { 0 };
+  double worst[NUM_PLACES] = { 0 };
+  double sum[NUM_PLACES] = { 0 };
+  unsigned compared[NUM_PLACES] = { 0 };
+  size_t p;
+
+  if (!in)
+  {
+    perror(path);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), in))
+  {
+    char fields[NUM_EVENTS][16];
+    char grazingMark[4] = "";
+    double latitude;
+    double longitude;
+    int day;
+    dayTimes expected;
+    dayTimes got;
+    uint8_t event;
+
+    if (line[0] == '#')
+    {
+      continue;
+    }
+    if (sscanf(line, "%lf %lf %d %15s %15s %15s %15s %3s", &latitude,
+      &longitude, &day, fields[0], fields[1], fields[2], fields[3],
+      grazingMark) < 7)
+    {
+      fprintf(stderr, "%s: bad line: %s", path, line);
+      exit(1);
+    }
+    for (p = 0; p < NUM_PLACES; p++)
+    {
+      if ((fabs(places[p].latitude - latitude) < 1e-5) &&
+        (fabs(places[p].longitude - longitude) < 1e-5))
+      {
+        break;
+      }
+    }
+    if (p == NUM_PLACES)
+    {
+      fprintf(stderr, "%s: no such place; rewrite it with -w: %s", path,
+        line);
+      exit(1);
+    }
+    for (event = 0; event < NUM_EVENTS; event++)
+    {
+      if (!readTime(fields[event], &expected.minutes[event],
+        &expected.sky[event]))
+      {
+        fprintf(stderr, "%s: bad time: %s", path, line);
+        exit(1);
+      }
+    }
+    firmware(&places[p], (int16_t)day, &got);
+    if (grazingMark[0] == 'g')
+    {
+      grazingDays[p]++;
+      continue;
+    }
+    for (event = 0; event < NUM_EVENTS; event++)
+    {
+      double apart = 0;
+      if (expected.sky[event] != got.sky[event])
+      {
+        apart = INFINITY;
+      }
+      else if (expected.sky[event] == SOLAR_RISES_AND_SETS)
+      {
+        apart = fabs(difference(expected.minutes[event],
+          got.minutes[event]));
+        worst[p] = (apart > worst[p]) ? apart : worst[p];
+        sum[p] += apart;
+        compared[p]++;
+      }
+      if (apart > TOLERANCE_MINUTES)
+      {
+        if (failed++ < 10)
+        {
+          printf("OUT %s day %d %s: reference %s, firmware %.2f (%s)\n",
+            places[p].name, day, eventNames[event], fields[event],
+            got.minutes[event], (got.sky[event] == SOLAR_RISES_AND_SETS) ?
+            "crosses" : ((got.sky[event] == SOLAR_ALWAYS_UP) ? "up" :
+            "down"));
+        }
+      }
+    }
+  }
+  fclose(in);
+
+  printf("%-16s %9s %6s %9s %9s %8s\n", "place", "latitude", "times",
+    "mean min", "worst min", "grazing");
+  for (p = 0; p < NUM_PLACES; p++)
+  {
+    printf("%-16s %9.4f %6u %9.2f %9.2f %8u\n", places[p].name,
+      places[p].latitude, compared[p],
+      compared[p] ? (sum[p] / compared[p]) : 0.0, worst[p], grazingDays[p]);
+  }
+  printf("%u times out by more than %.1f minutes\n", failed,
+    TOLERANCE_MINUTES);
+  return failed;
+}
+
+static double secondsSince(const struct timespec* start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) +
+    ((double)(end.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+// What a day's times cost, the once a day the clock works them out.
+static void timeCalculation(void)
+{
+  volatile int32_t sink = 0;
+  struct timespec start;
+  solarTimes solar;
+  long i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < TIMED_CALLS; i++)
+  {
+    solarCalculate(SOLAR_LATITUDE + (int32_t)(i & 0xFFFF), SOLAR_LONGITUDE,
+      (uint16_t)(8766 + (i % 366)), 0, &solar);
+    sink += solar.sun.rise;
+  }
+  printf("solarCalculate: %.2f us a day's times\n",
+    (secondsSince(&start) * 1e6) / TIMED_CALLS);
+}
+
+// profile.c's, in a PROFILING=1 build. No interrupts here to keep out.
+uint8 CyEnterCriticalSection(void)
+{
+  return 0;
+}
+
+void CyExitCriticalSection(uint8 savedIntrStatus)
+{
+  (void)savedIntrStatus;
+}
+
+int main(int argc, char* argv[])
+{
+  bool write = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': write = true; break;
+      default:  optind = argc + 1; break;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    fprintf(stderr, "usage: %s [-w] reference.txt\n", argv[0]);
+    return 2;
+  }
+
+  if (write)
+  {
+    writeReference(argv[optind]);
+    printf("wrote %s\n", argv[optind]);
+    return 0;
+  }
+  timeCalculation();
+  return (checkReference(argv[optind]) == 0) ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""One master clock and a few slaves, run side by side in the simulator.
+
+Builds gps_clock_sim twice, as a master (TIMESYNC_MODE 1) and as a slave
+(TIMESYNC_MODE 2), then runs them in real time: the master on the built-in
+GPS generator, its UART TX out to a pseudo-terminal, and each slave with a
+pseudo-terminal of its own on its UART RX. The bytes from the master are
+copied out to every slave as they come, as the TX_Echo line would carry
+them.
+
+    ./timesync_check.py [-n slaves] [-d seconds] [--limit ms]
+
+Each clock logs when its seconds digit changes (gps_clock_sim -m), on the
+host's monotonic clock, so the logs compare directly. The report gives, for
+each slave, how far its changes fall from the master's: mean, rms and worst,
+and how many of the master's seconds it showed no change near. They're split
+by whether both clocks had ClockTick locked; until then the digits change
+whenever a time comes in, and that takes the master the best part of a
+minute, and each slave about as long again once it's heard from the master.
+
+The host's own scheduling is in the figures: a slave only sees a frame when
+this script and the simulator get to run, which is more than a clock would
+see on the wire. It exits non-zero if any slave never locked, or locked, was
+ever further out than --limit or missed a second.
+"""
+
+import argparse
+import math
+import os
+import select
+import signal
+import subprocess
+import sys
+import tty
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MODES = {'master': 1, 'slave': 2}
+
+
+def build(out):
+    """Builds a master and a slave gps_clock_sim; returns their paths."""
+    programs = {}
+    for name, mode in MODES.items():
+        directory = os.path.join(out, name)
+        env = dict(os.environ, TIMESYNC_MODE=str(mode))
+        subprocess.run([os.path.join(HERE, 'build.sh'), directory], env=env,
+                       check=True, stdout=subprocess.DEVNULL)
+        programs[name] = os.path.join(directory, 'gps_clock_sim')
+    return programs
+
+
+def open_pty():
+    """A raw pseudo-terminal: the fd to copy through, and the path to hand
+    the simulator."""
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    return master, slave, os.ttyname(slave)
+
+
+def read_log(path):
+    """(time, locked) for each digit change. The change that goes out as
+    ClockTick locks still went by the time coming in, so it counts as
+    free."""
+    changes = []
+    was_locked = False
+    with open(path) as log:
+        for line in log:
+            fields = line.split()
+            if fields:
+                locked = fields[1] == '1'
+                changes.append((float(fields[0]), locked and was_locked))
+                was_locked = locked
+    return changes
+
+
+def compare(master, slave):
+    """For each of the master's digit changes, the nearest of the slave's
+    within half a second. Returns, for free and locked in turn, the errors
+    in seconds and how many had none."""
+    errors = ([], [])
+    missed = [0, 0]
+    i = 0
+    for change, master_locked in master:
+        while (i + 1 < len(slave)) and (slave[i + 1][0] <= change):
+            i += 1
+        near = [s for s in slave[i:i + 2] if abs(s[0] - change) < 0.5]
+        if near:
+            time, locked = min(near, key=lambda s: abs(s[0] - change))
+            errors[master_locked and locked].append(time - change)
+        else:
+            # Counts as locked if the slave was, at its last change.
+            locked = bool(slave) and slave[i][1]
+            missed[master_locked and locked] += 1
+    return errors, missed
+
+
+def show(what, errors, missed):
+    """One line of the report; returns the worst error, in ms."""
+    if errors:
+        mean = sum(errors) / len(errors)
+        rms = math.sqrt(sum(e * e for e in errors) / len(errors))
+        worst = max(abs(e) for e in errors)
+    else:
+        mean = rms = worst = 0
+    print('    %s: %d, mean %+.3f ms, rms %.3f ms, worst %.3f ms, %d missed'
+          % (what, len(errors), mean * 1000, rms * 1000, worst * 1000,
+             missed))
+    return worst * 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-n', '--slaves', type=int, default=3)
+    parser.add_argument('-d', '--seconds', type=float, default=150)
+    parser.add_argument('--limit', type=float, default=10,
+                        help='worst slave error allowed, in ms')
+    parser.add_argument('--out', default=os.path.join(HERE, 'build',
+                                                      'timesync'))
+    args = parser.parse_args()
+
+    programs = build(args.out)
+
+    # Slaves first, so they're listening when the first frame goes out.
+    slaves = []
+    for n in range(args.slaves):
+        fd, held, path = open_pty()
+        log = os.path.join(args.out, 'slave%d.log' % n)
+        report = open(os.path.join(args.out, 'slave%d.txt' % n), 'w')
+        process = subprocess.Popen(
+            [programs['slave'], '-d', '0', '-u', path, '-m', log],
+            stdout=report, stderr=subprocess.STDOUT)
+        slaves.append({'fd': fd, 'held': held, 'log': log,
+                       'process': process, 'report': report})
+
+    tx, held, path = open_pty()
+    log = os.path.join(args.out, 'master.log')
+    report = open(os.path.join(args.out, 'master.txt'), 'w')
+    master = subprocess.Popen(
+        [programs['master'], '-r', '-d', str(args.seconds), '-o', path,
+         '-m', log], stdout=report, stderr=subprocess.STDOUT)
+
+    frames = 0
+    while master.poll() is None:
+        ready, _, _ = select.select([tx], [], [], 0.1)
+        if ready:
+            data = os.read(tx, 256)
+            frames += len(data)
+            for slave in slaves:
+                os.write(slave['fd'], data)
+    for slave in slaves:
+        slave['process'].send_signal(signal.SIGTERM)
+        slave['process'].wait()
+        slave['report'].close()
+        os.close(slave['fd'])
+        os.close(slave['held'])
+    report.close()
+    os.close(tx)
+    os.close(held)
+    if master.returncode != 0:
+        sys.exit('master failed; see %s' % report.name)
+
+    changes = read_log(log)
+    if not changes:
+        sys.exit('the master never showed a time')
+    print('%d slaves, %.0f s, %d bytes of time frames; slave seconds digit '
+          'changes from the master\'s' % (args.slaves, args.seconds, frames))
+
+    failures = 0
+    for n, slave in enumerate(slaves):
+        errors, missed = compare(changes, read_log(slave['log']))
+        print('  slave %d' % n)
+        show('free', errors[False], missed[False])
+        worst = show('locked', errors[True], missed[True])
+        if (worst > args.limit) or missed[True] or not errors[True]:
+            failures += 1
+    if failures:
+        print('FAIL: %d slaves out of step' % failures)
+        return 1
+    print('PASS')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
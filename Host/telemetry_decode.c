@@ -0,0 +1,169 @@
+/******************************************************************************
+*  telemetry_decode - prints the clock's binary telemetry records as text.
+*
+*  Build:  gcc -O2 -Wall -o telemetry_decode telemetry_decode.c
+*  Usage:  telemetry_decode [-p] /dev/ttyACM0   (or a file captured from it)
+*
+*  With -p, first asks the clock for its profile table (firmware built with
+*   PROFILING set in profile.h), which is printed as it comes in.
+*
+*  The record layout comes straight from the firmware's telemetry.h. Records
+*   can arrive split across USB packets, and the stream may be joined part
+*   way through one, so we hunt for the sync byte and only trust a record
+*   whose checksum matches.
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "../GPS_Clock.cydsn/profile.h"
+#include "../GPS_Clock.cydsn/telemetry.h"
+
+_Static_assert(sizeof(profileRecord) == PROFILE_RECORD_SIZE,
+  "profileRecord has picked up padding");
+_Static_assert(PROFILE_RECORD_SIZE <= TELEMETRY_RECORD_SIZE,
+  "the buffer below assumes telemetry records are the bigger ones");
+
+// In profileID order.
+static const char* profileNames[PROF_COUNT] =
+{
+  "NMEA parse", "UTC offset", "DST check", "writeDigit", "render string",
+  "StripLights FISR", "StripLights CISR", "USB task", "solar times"
+};
+
+_Static_assert(sizeof(telemetryRecord) == TELEMETRY_RECORD_SIZE,
+  "telemetryRecord has picked up padding");
+
+static int checksumOkay(const uint8_t* bytes, int size)
+{
+  uint8_t sum = 0;
+  int i;
+  for (i = 0; i < size - 1; i++)
+  {
+    sum ^= bytes[i];
+  }
+  return sum == bytes[size - 1];
+}
+
+static void printRecord(const telemetryRecord* rec, int* lastSeq)
+{
+  if ((*lastSeq >= 0) && (rec->seq != (uint8_t)(*lastSeq + 1)))
+  {
+    printf("# %u record(s) missing\n", (uint8_t)(rec->seq - *lastSeq - 1));
+  }
+  *lastSeq = rec->seq;
+
+  printf("seq %3u  %02u:%02u:%02u %02u-%02u-%02u  fix %c  busy %3u%%  "
+    "parse %6u cyc  render %6u cyc  uart %3u  line %3u  ring %2u  drop %u  "
+    "boot: frame %u ms, time %u ms\n",
+    rec->seq, rec->hrs, rec->min, rec->sec, rec->day, rec->month, rec->year,
+    rec->fix ? rec->fix : '-', rec->busy,
+    (unsigned)rec->parseCycles, (unsigned)rec->renderCycles,
+    rec->uartHighWater, rec->lineHighWater, rec->ringHighWater, rec->dropped,
+    (unsigned)rec->firstFrameMs, (unsigned)rec->firstTimeMs);
+  fflush(stdout);
+}
+
+static void printProfile(const profileRecord* rec)
+{
+  if (rec->id == 0)
+  {
+    printf("# profile: %-18s %10s %10s %10s %10s\n", "section", "calls",
+      "min", "mean", "max");
+  }
+  printf("# profile: %-18s %10u %10u %10u %10u\n",
+    (rec->id < PROF_COUNT) ? profileNames[rec->id] : "?",
+    (unsigned)rec->calls, (unsigned)rec->min, (unsigned)rec->mean,
+    (unsigned)rec->max);
+  fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+  uint8_t buffer[4 * TELEMETRY_RECORD_SIZE];
+  size_t used = 0;
+  int lastSeq = -1;
+  struct termios tio;
+  int fd;
+
+  int askProfile = (argc == 3) && (strcmp(argv[1], "-p") == 0);
+  const char* path = argv[argc - 1];
+
+  if ((argc != 2) && !askProfile)
+  {
+    fprintf(stderr, "usage: %s [-p] <tty or capture file>\n", argv[0]);
+    return 2;
+  }
+  fd = open(path, (askProfile ? O_RDWR : O_RDONLY) | O_NOCTTY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  // CDC ignores the baud rate, but the line discipline would still mangle
+  //  binary data unless the port is raw.
+  if (tcgetattr(fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  if (askProfile)
+  {
+    const char command = PROFILE_DUMP_CMD;
+    if (write(fd, &command, 1) != 1)
+    {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return 1;
+    }
+  }
+
+  for (;;)
+  {
+    ssize_t got = read(fd, buffer + used, sizeof(buffer) - used);
+    if (got <= 0)
+    {
+      break;
+    }
+    used += got;
+
+    // Peel off every whole, valid record; slide past anything else a byte at
+    //  a time until we're back in sync.
+    size_t start = 0;
+    while (used - start >= PROFILE_RECORD_SIZE)
+    {
+      if ((buffer[start] == TELEMETRY_SYNC) &&
+        (used - start < TELEMETRY_RECORD_SIZE))
+      {
+        break; // Could be the start of one; wait for the rest.
+      }
+      if ((buffer[start] == TELEMETRY_SYNC) &&
+        checksumOkay(buffer + start, TELEMETRY_RECORD_SIZE))
+      {
+        telemetryRecord rec;
+        memcpy(&rec, buffer + start, sizeof(rec));
+        printRecord(&rec, &lastSeq);
+        start += TELEMETRY_RECORD_SIZE;
+      }
+      else if ((buffer[start] == PROFILE_SYNC) &&
+        checksumOkay(buffer + start, PROFILE_RECORD_SIZE))
+      {
+        profileRecord rec;
+        memcpy(&rec, buffer + start, sizeof(rec));
+        printProfile(&rec);
+        start += PROFILE_RECORD_SIZE;
+      }
+      else
+      {
+        start++;
+      }
+    }
+    memmove(buffer, buffer + start, used - start);
+    used -= start;
+  }
+  close(fd);
+  return 0;
+}
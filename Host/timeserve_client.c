@@ -0,0 +1,276 @@
+/******************************************************************************
+*  timeserve_client - uses the clock as a time reference over USB, NTP style.
+*
+*  Build:  gcc -O2 -Wall -o timeserve_client timeserve_client.c -lm
+*  Usage:  timeserve_client [-n count] [-i ms] [-b ms] /dev/ttyACM0
+*
+*  Sends count queries (default 100), interval ms apart (default 200), and
+*   for each answer prints the clock's offset from this machine's clock and
+*   the round-trip delay, worked out the NTP way from the four timestamps:
+*
+*     t1  query sent (ours)         t2  query received (the clock's)
+*     t3  answer sent (the clock's)  t4  answer received (ours)
+*
+*     offset = ((t2 - t1) + (t3 - t4)) / 2
+*     delay  = (t4 - t1) - (t3 - t2)
+*
+*  then sums up the spread of the delay and of the whole round trip, and the
+*   offset from the quickest quarter of the answers, which are the ones the
+*   USB polling has least muddied.
+*
+*  The clock starts its second when the RMC sentence has all come in, which
+*   is some way after the real top of the second; -b takes that out (it's a
+*   property of the GPS module, so measure it once against a PPS).
+*
+*  The answer layout comes straight from the firmware's timeserve.h. Telemetry
+*   keeps arriving in between, so we hunt for the sync byte, and only take an
+*   answer whose checksum and origin match the query we sent.
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "../GPS_Clock.cydsn/timeserve.h"
+
+_Static_assert(sizeof(timeserveRecord) == TIMESERVE_RECORD_SIZE,
+  "timeserveRecord has picked up padding");
+
+// Seconds from the Unix epoch to the clock's, 2000-01-01.
+#define EPOCH_2000  946684800LL
+
+// How long to wait for an answer before giving up on it.
+#define ANSWER_TIMEOUT_MS  1000
+
+static int64_t nowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The clock's time, as Unix UTC in ns.
+static int64_t clockNs(uint32_t seconds, uint32_t micros, int8_t zone)
+{
+  int64_t utc = EPOCH_2000 + seconds - (int64_t)zone * 3600;
+  return utc * 1000000000 + (int64_t)micros * 1000;
+}
+
+static int checksumOkay(const uint8_t* bytes, int size)
+{
+  uint8_t sum = 0;
+  int i;
+  for (i = 0; i < size - 1; i++)
+  {
+    sum ^= bytes[i];
+  }
+  return sum == bytes[size - 1];
+}
+
+// Reads until an answer to the query with this origin turns up, or the time
+//  runs out. Returns 1 with the answer and t4 filled in, 0 on a timeout.
+static int awaitAnswer(int fd, uint64_t origin, timeserveRecord* answer,
+  int64_t* t4)
+{
+  static uint8_t buffer[4 * TIMESERVE_RECORD_SIZE];
+  static size_t used;
+  int64_t deadline = nowNs() + (int64_t)ANSWER_TIMEOUT_MS * 1000000;
+
+  for (;;)
+  {
+    size_t start = 0;
+    while (used - start >= TIMESERVE_RECORD_SIZE)
+    {
+      if ((buffer[start] == TIMESERVE_SYNC) &&
+        checksumOkay(buffer + start, TIMESERVE_RECORD_SIZE))
+      {
+        memcpy(answer, buffer + start, sizeof(*answer));
+        start += TIMESERVE_RECORD_SIZE;
+        if ((answer->originLo == (uint32_t)origin) &&
+          (answer->originHi == (uint32_t)(origin >> 32)))
+        {
+          memmove(buffer, buffer + start, used - start);
+          used -= start;
+          return 1;
+        }
+      }
+      else
+      {
+        start++;
+      }
+    }
+    memmove(buffer, buffer + start, used - start);
+    used -= start;
+
+    int64_t left = deadline - nowNs();
+    if (left <= 0)
+    {
+      return 0;
+    }
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, (int)(left / 1000000) + 1) <= 0)
+    {
+      continue;
+    }
+    ssize_t got = read(fd, buffer + used, sizeof(buffer) - used);
+    *t4 = nowNs();
+    if (got < 0)
+    {
+      fprintf(stderr, "read: %s\n", strerror(errno));
+      exit(1);
+    }
+    used += got;
+  }
+}
+
+static int compareDouble(const void* a, const void* b)
+{
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// The p'th percentile of sorted values.
+static double percentile(const double* sorted, int count, double p)
+{
+  int index = (int)((p / 100.0) * (count - 1) + 0.5);
+  return sorted[index];
+}
+
+static void printSpread(const char* name, double* values, int count)
+{
+  qsort(values, count, sizeof(double), compareDouble);
+  printf("%-12s min %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f us\n",
+    name, values[0], percentile(values, count, 50),
+    percentile(values, count, 90), percentile(values, count, 99),
+    values[count - 1]);
+}
+
+int main(int argc, char* argv[])
+{
+  int count = 100;
+  int intervalMs = 200;
+  double biasMs = 0;
+  struct termios tio;
+  int opt;
+  int fd;
+
+  while ((opt = getopt(argc, argv, "n:i:b:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': count = atoi(optarg); break;
+      case 'i': intervalMs = atoi(optarg); break;
+      case 'b': biasMs = atof(optarg); break;
+      default:  optind = argc + 1; break;
+    }
+  }
+  if ((optind != argc - 1) || (count < 1))
+  {
+    fprintf(stderr, "usage: %s [-n count] [-i ms] [-b ms] <tty>\n", argv[0]);
+    return 2;
+  }
+  const char* path = argv[optind];
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  // CDC ignores the baud rate, but the line discipline would still mangle
+  //  binary data unless the port is raw.
+  if (tcgetattr(fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+
+  double* offsets = calloc(count, sizeof(double));
+  double* delays = calloc(count, sizeof(double));
+  double* roundTrips = calloc(count, sizeof(double));
+  int answered = 0;
+  int lost = 0;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    uint8_t query[1 + TIMESERVE_ORIGIN_SIZE];
+    timeserveRecord answer;
+    int64_t t1 = nowNs();
+    int64_t t4 = t1;
+    uint64_t origin = (uint64_t)t1;
+
+    query[0] = TIMESERVE_QUERY_CMD;
+    memcpy(&query[1], &origin, TIMESERVE_ORIGIN_SIZE);
+    if (write(fd, query, sizeof(query)) != sizeof(query))
+    {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return 1;
+    }
+    if (!awaitAnswer(fd, origin, &answer, &t4))
+    {
+      printf("query %d: no answer\n", i);
+      lost++;
+      continue;
+    }
+
+    int64_t bias = (int64_t)(biasMs * 1000000);
+    int64_t t2 = clockNs(answer.rxSeconds, answer.rxMicros, answer.zone)
+      - bias;
+    int64_t t3 = clockNs(answer.txSeconds, answer.txMicros, answer.zone)
+      - bias;
+    double offset = (((t2 - t1) + (t3 - t4)) / 2) / 1000.0;
+    double delay = ((t4 - t1) - (t3 - t2)) / 1000.0;
+
+    printf("query %3d: offset %+12.1f us  delay %8.1f us  turnaround "
+      "%6.1f us%s%s\n", i, offset, delay, (t3 - t2) / 1000.0,
+      (answer.flags & TIMESERVE_SET) ? "" : "  (clock has no time)",
+      (answer.flags & TIMESERVE_SYNCED) ? "" : "  (clock free-running)");
+    fflush(stdout);
+
+    offsets[answered] = offset;
+    delays[answered] = delay;
+    roundTrips[answered] = (t4 - t1) / 1000.0;
+    answered++;
+    usleep(intervalMs * 1000);
+  }
+
+  printf("\n%d answered, %d lost\n", answered, lost);
+  if (answered > 0)
+  {
+    // Offsets from the quickest answers; sort them by delay first.
+    int quick = (answered + 3) / 4;
+    double sum = 0;
+    double sumSquares = 0;
+    int j;
+    for (i = 0; i < quick; i++)
+    {
+      int best = i;
+      for (j = i + 1; j < answered; j++)
+      {
+        if (delays[j] < delays[best])
+        {
+          best = j;
+        }
+      }
+      double swap = delays[i]; delays[i] = delays[best]; delays[best] = swap;
+      swap = offsets[i]; offsets[i] = offsets[best]; offsets[best] = swap;
+      sum += offsets[i];
+      sumSquares += offsets[i] * offsets[i];
+    }
+    double mean = sum / quick;
+    printSpread("delay", delays, answered);
+    printSpread("round trip", roundTrips, answered);
+    printf("offset       %+.1f us (+/- %.1f), from the quickest %d\n", mean,
+      sqrt(fmax(sumSquares / quick - mean * mean, 0)), quick);
+  }
+  close(fd);
+  return (answered > 0) ? 0 : 1;
+}